@@ -2,9 +2,24 @@
 
 #include "./batch.h"
 #include "./components.h"
+#include "./concurrent_resource.h"
+#include "./effects.h"
+#include "./gpu_batch.h"
+#include "./image.h"
+#include "./image_cache.h"
+#include "./image_format.h"
 #include "./input.h"
+#include "./loader.h"
+#include "./mapped_file.h"
 #include "./math.h"
 #include "./meta.h"
+#include "./name_index.h"
+#include "./pak.h"
+#include "./preload.h"
 #include "./resource.h"
+#include "./scheduler.h"
+#include "./stream_renderer.h"
+#include "./uploader.h"
 #include "./version.h"
+#include "./vfs.h"
 #include "./window.h"
\ No newline at end of file
@@ -1,7 +1,13 @@
 #pragma once
 
 #include <SFML/Graphics/Drawable.hpp>
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/Shape.hpp>
+#include <SFML/Graphics/View.hpp>
 
+#include "./components/trim.h"
+#include "./effects.h"
+#include "./shape_cache.h"
 #include "./window.h"
 
 #include <memory>
@@ -9,23 +15,110 @@
 namespace kat {
 
     using shared_drawable_t = std::shared_ptr<sf::Drawable>;
-    using Batch = std::vector<shared_drawable_t>;
     using ZAxis = int;
 
+    /**
+     * @brief How a drawable covers what is behind it, used by the depth sorting.
+     */
+    enum class Opacity {
+        Translucent, ///< Blended, drawn back to front after the opaque drawables.
+        Opaque,      ///< Every pixel is opaque.
+        AlphaTested  ///< Pixels are either opaque or discarded (alpha lower than one half).
+    };
+
+    /**
+     * @brief A drawable of a batch and its bounds, used to cull it per view.
+     */
+    struct BatchEntry {
+        shared_drawable_t drawable;  ///< The drawable.
+        FloatRect bounds;            ///< The global bounds of the drawable.
+        bool bounded = false;        ///< Whether the bounds are known, unbounded drawables are never culled.
+        const ShapeBatch* shapes = nullptr; ///< Set for runs of shapes, their bounds grow until drawn.
+        Opacity opacity = Opacity::Translucent; ///< How the drawable covers what is behind it.
+        const sf::Texture* texture = nullptr;   ///< The texture of the drawable, used to group opaque drawables.
+    };
+
+    using Batch = std::vector<BatchEntry>;
+
+    /**
+     * @brief A view.
+     */
+    using View = sf::View;
+
+    /**
+     * @brief A view and the target it is drawn to.
+     */
+    struct RenderView {
+        sf::RenderTarget* target; ///< The target to draw to.
+        View view;                ///< The view to draw with.
+    };
+
+    /**
+     * @brief A list of views and targets.
+     */
+    using RenderViewList = std::vector<RenderView>;
+
+    template<typename T>
+    concept KatBatchable = requires(const T& object) {
+        { object.as_drawable() } -> std::convertible_to<shared_drawable_t>;
+    };
+
+    template<typename T>
+    concept KatBounded = requires(const T& object) {
+        { object.getGlobalBounds() } -> std::convertible_to<FloatRect>;
+    };
+
+    template<typename T>
+    concept KatTextured = requires(const T& object) {
+        { object.getTexture().raw_handle() } -> std::convertible_to<const sf::Texture*>;
+    };
+
+    template<typename T>
+    concept KatEffected = requires(const T& object) {
+        { object.getEffect() } -> std::convertible_to<EffectParams>;
+        { object.getMesh() } -> std::convertible_to<const FrameHull*>;
+        { object.raw_handle() } -> std::convertible_to<const sf::Sprite*>;
+    };
+
+    /**
+     * @brief A shared pointer to a run of shapes.
+     */
+    using shared_shape_batch_t = std::shared_ptr<ShapeBatch>;
+
     class BatchRenderer {
     private:
         std::vector<
             std::pair<ZAxis, Batch>
         > m_batches;
 
-    public:
+        ShapeCache m_shape_cache;
+        std::vector<shared_shape_batch_t> m_shape_batches; ///< Pool of shape runs, reused every frame.
+        usize m_shape_batch_count = 0; ///< The number of runs of the pool in use.
+
         /**
-         * @brief Adds a drawable to the batch.
+         * @brief An opaque drawable and the depth it is drawn at.
+         */
+        struct DepthEntry {
+            const BatchEntry* entry;
+            float depth;
+        };
+
+        bool m_depth_sorting = false; ///< Whether opaque drawables are ordered by the depth buffer.
+        bool m_depth_from_y = false;  ///< Whether the y-axis orders the drawables of a layer.
+        std::vector<DepthEntry> m_opaque; ///< Opaque drawables grouped by texture, built by prepare().
+        std::vector<float> m_translucent_depth; ///< Depth of the translucent drawables, in draw order.
+
+        bool m_uber = false; ///< Whether sprites are drawn as runs with the uber shader.
+        bool m_streaming = false; ///< Whether runs are drawn by the stream renderer of the window.
+        std::vector<Vector2f> m_sprite_triangles; ///< Scratch triangles of the sprite being added.
+
+        /**
+         * @brief Gets the batch of a z-axis, creates it if needed.
          * 
-         * @param drawable The drawable to add.
-         * @param z The z-axis of the drawable.
+         * @param z The z-axis.
+         * @return Batch& The batch.
          */
-        void add(const shared_drawable_t& drawable, ZAxis z = 0)
+        Batch& layer(ZAxis z)
         {
             // dicotomy search as m_batches is sorted
             size_t i = 0;
@@ -36,10 +129,97 @@ namespace kat {
                 }
             }
             if (i < m_batches.size() && m_batches[i].first == z) {
-                m_batches[i].second.push_back(drawable);
-            } else {
-                m_batches.insert(m_batches.begin() + i, { z, { drawable } });
+                return m_batches[i].second;
             }
+            if (i < m_batches.size() && m_batches[i].first < z) {
+                ++i;
+            }
+            return m_batches.insert(m_batches.begin() + i, { z, {} })->second;
+        }
+
+        /**
+         * @brief Gets the run of shapes a shape must be appended to.
+         *        Consecutive shapes of a layer sharing a texture share a run.
+         * 
+         * @param batch The batch of the layer.
+         * @param texture The texture of the shape.
+         * @param shader The shader of the shape.
+         * @return ShapeBatch& The run.
+         */
+        ShapeBatch& shapeBatch(Batch& batch, const sf::Texture* texture, sf::Shader* shader = nullptr);
+
+        /**
+         * @brief Appends a sprite to the run of its layer, drawn with the uber shader.
+         * 
+         * @param sprite The sprite.
+         * @param effect The effect of the sprite.
+         * @param hull The tight polygon of the sprite, null to draw a quad.
+         * @param z The z-axis of the sprite.
+         * @return bool Whether the sprite was appended, false without uber shader.
+         */
+        bool addSprite(const sf::Sprite& sprite, const EffectParams& effect, const FrameHull* hull, ZAxis z);
+
+        /**
+         * @brief Refreshes the bounds of the runs of shapes, done once before drawing the views.
+         */
+        void prepare();
+
+        /**
+         * @brief Draws every visible drawable with a view, without sorting nor batching again.
+         * 
+         * @param target The target to draw to.
+         * @param view The view to draw with.
+         * @param stream The renderer of the runs without shader, null to draw them with sfml.
+         */
+        void drawView(sf::RenderTarget& target, const View& view, StreamRenderer* stream = nullptr) const;
+
+        /**
+         * @brief Draws every visible drawable with a view, ordered by the depth buffer.
+         * 
+         * @param target The target to draw to, it needs a depth buffer.
+         * @param view The view to draw with.
+         */
+        void drawViewDepth(sf::RenderTarget& target, const View& view) const;
+
+    public:
+        /**
+         * @brief Adds a drawable to the batch.
+         * 
+         * @param drawable The drawable to add.
+         * @param z The z-axis of the drawable.
+         */
+        void add(const shared_drawable_t& drawable, ZAxis z = 0)
+        {
+            layer(z).push_back({ drawable, FloatRect(), false, nullptr });
+        }
+
+        /**
+         * @brief Adds a drawable to the batch with its global bounds,
+         *        it is skipped by the views it is not visible in.
+         * 
+         * @param drawable The drawable to add.
+         * @param bounds The global bounds of the drawable.
+         * @param z The z-axis of the drawable.
+         */
+        void add(const shared_drawable_t& drawable, const FloatRect& bounds, ZAxis z = 0)
+        {
+            layer(z).push_back({ drawable, bounds, true, nullptr });
+        }
+
+        /**
+         * @brief Adds an opaque or alpha tested drawable to the batch,
+         *        see setDepthSorting().
+         * 
+         * @param drawable The drawable to add.
+         * @param bounds The global bounds of the drawable.
+         * @param texture The texture of the drawable.
+         * @param opacity How the drawable covers what is behind it.
+         * @param z The z-axis of the drawable.
+         */
+        void add(const shared_drawable_t& drawable, const FloatRect& bounds,
+                 const sf::Texture* texture, Opacity opacity, ZAxis z = 0)
+        {
+            layer(z).push_back({ drawable, bounds, true, nullptr, opacity, texture });
         }
 
         /**
@@ -49,33 +229,147 @@ namespace kat {
          * @param z The z-axis of the drawable.
          */
         template<typename T>
+        requires KatBatchable<T>
         void add(T& drawable, ZAxis z = 0)
         {
-            add(drawable.as_drawable(), z);
+            if constexpr (KatEffected<T>) {
+                if (m_uber && addSprite(*drawable.raw_handle(), drawable.getEffect(), drawable.getMesh(), z))
+                    return;
+            }
+            if constexpr (KatBounded<T>) {
+                add(drawable.as_drawable(), drawable.getGlobalBounds(), z);
+            } else {
+                add(drawable.as_drawable(), z);
+            }
+        }
+
+        /**
+         * @brief Adds an opaque or alpha tested drawable to the batch,
+         *        see setDepthSorting().
+         * 
+         * @param drawable The drawable to add.
+         * @param opacity How the drawable covers what is behind it.
+         * @param z The z-axis of the drawable.
+         */
+        template<typename T>
+        requires KatBatchable<T> && KatBounded<T> && KatTextured<T>
+        void add(T& drawable, Opacity opacity, ZAxis z = 0)
+        {
+            add(drawable.as_drawable(), drawable.getGlobalBounds(),
+                drawable.getTexture().raw_handle(), opacity, z);
         }
 
         /**
-         * @brief Draws the batch.
+         * @brief Orders opaque and alpha tested drawables with the depth buffer.
+         *        They are drawn first, front to back and grouped by texture across every
+         *        z-axis, each at a depth computed from its z-axis (and optionally its y-axis).
+         *        Translucent drawables are drawn back to front afterwards, depth tested
+         *        against the opaque ones.
+         *        The window needs a depth buffer (ContextSettings::depthBits), without one
+         *        the batch is drawn in z order as usual.
          * 
-         * @param window The window to draw to.
+         * @param enabled Whether to use the depth buffer.
+         * @param from_y Whether a bigger y-axis is in front inside of a z-axis (top down games).
+         * @return BatchRenderer& Reference to self.
          */
-        void draw(Window& window, bool clear = true)
+        BatchRenderer& setDepthSorting(bool enabled, bool from_y = false)
         {
-            for (const auto& [_, batch] : m_batches) {
-                for (const auto& drawable : batch) {
-                    window.draw(*drawable);
-                }
-            }
-            if (clear)
-                m_batches.clear();
+            m_depth_sorting = enabled;
+            m_depth_from_y = from_y;
+            return *this;
+        }
+
+        /**
+         * @brief Draws sprites with the uber shader (see uberShader()).
+         *        Their vertices are appended to runs like shapes, so consecutive sprites
+         *        of a layer sharing a texture are drawn in a single draw call whatever
+         *        their effects, which are packed in an effect texture (see encodeEffect()).
+         *        The vertex colors keep the colors of the sprites, multiplied into the result
+         *        of every effect like sfml does without shaders.
+         *        Falls back to drawing sprites one by one without shaders.
+         * 
+         * @param enabled Whether to use the uber shader.
+         * @return BatchRenderer& Reference to self.
+         */
+        BatchRenderer& setUberShader(bool enabled)
+        {
+            m_uber = enabled;
+            return *this;
+        }
+
+        /**
+         * @brief Draws the runs of shapes and sprites through the stream renderer of the
+         *        window (see Window::stream()) instead of sfml, when the context allows it.
+         *        Runs using the uber shader and depth sorted batches are still drawn by sfml.
+         * 
+         * @param enabled Whether to stream the runs.
+         * @return BatchRenderer& Reference to self.
+         */
+        BatchRenderer& setStreaming(bool enabled)
+        {
+            m_streaming = enabled;
+            return *this;
+        }
+
+        /**
+         * @brief Adds a shape to the batch.
+         *        The shape is tessellated once (see ShapeCache) and its triangles are
+         *        appended to the vertices of the previous shapes of the layer,
+         *        so consecutive shapes are drawn in a single draw call.
+         *        The shape is copied, it can be modified or destroyed right after.
+         * 
+         * @param shape The shape to add.
+         * @param z The z-axis of the shape.
+         */
+        void add(const sf::Shape& shape, ZAxis z = 0);
+
+        /**
+         * @brief Gets the tessellation cache of the shapes.
+         * 
+         * @return ShapeCache& The cache.
+         */
+        ShapeCache& shapeCache()
+        {
+            return m_shape_cache;
         }
 
+        /**
+         * @brief Draws the batch with the current view of the window.
+         * 
+         * @param window The window to draw to.
+         * @param clear Whether to clear the batch afterwards.
+         */
+        void draw(Window& window, bool clear = true);
+
+        /**
+         * @brief Draws the batch once per view (split screen, minimaps, picture in picture...).
+         *        The batch is sorted and batched once, each view only culls the drawables
+         *        outside of it. The views of the window are restored afterwards.
+         * 
+         * @param window The window to draw to.
+         * @param views The views to draw with.
+         * @param clear Whether to clear the batch afterwards.
+         */
+        void draw(Window& window, const std::vector<View>& views, bool clear = true);
+
+        /**
+         * @brief Draws the batch once per view, each view being drawn to its own target
+         *        (render textures for minimaps, the window...).
+         *        The views of the targets are restored afterwards. Depth sorting only
+         *        applies to the targets that have a depth buffer.
+         * 
+         * @param views The views and their targets.
+         * @param clear Whether to clear the batch afterwards.
+         */
+        void draw(const RenderViewList& views, bool clear = true);
+
         /**
          * @brief Clears the batch.
          */
         void clear()
         {
             m_batches.clear();
+            m_shape_batch_count = 0;
         }
 
         /**
@@ -1,5 +1,11 @@
 #pragma once
 
 #include "./components/animator.h"
+#include "./components/atlas.h"
+#include "./components/composite.h"
+#include "./components/dynamic_texture.h"
 #include "./components/texture.h"
-#include "./components/sprite.h"
\ No newline at end of file
+#include "./components/texture_cache.h"
+#include "./components/texture_release.h"
+#include "./components/sprite.h"
+#include "./components/trim.h"
\ No newline at end of file
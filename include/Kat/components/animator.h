@@ -43,6 +43,7 @@ namespace kat {
      */
     struct Animation {
         FrameList frames;         ///< The list of frames in the animation.
+        FrameTrimList trims;      ///< The trimming of each frame, empty if the frames are not trimmed.
         FrameTime speed = 0.2; ///< The time each frame is displayed.
         bool loop = true;         ///< Whether the animation should loop.
 
@@ -79,6 +80,15 @@ namespace kat {
          * @param loop Whether the animation should loop.
          */
         void setLoop(const bool& loop);
+
+        /**
+         * @brief Trim the transparent borders of every frame.
+         *        The frames are replaced by their trimmed rects and the offsets are kept
+         *        so the animator can compensate the origin of the sprite.
+         * @param image The image containing the frames.
+         * @param settings The trimming settings.
+         */
+        void trim(const sf::Image& image, const TrimSettings& settings = TrimSettings());
     };
 
     /**
@@ -116,6 +126,11 @@ namespace kat {
         */
         void _defaultAnimation();
 
+        /**
+        * @brief Apply the current frame of the current animation to the sprite.
+        */
+        void _applyFrame();
+
     public:
         /**
          * @brief Construct an Animator with a reference to a sprite.
@@ -183,6 +198,15 @@ namespace kat {
         */
         bool isLooping() const;
 
+       /**
+        * @brief Trim the transparent borders of the frames of every animation.
+        *        The texture of the sprite is read back once, this is meant to be
+        *        done at load time.
+        * @param settings The trimming settings.
+        * @return A reference to the Animator object.
+        */
+        Animator& trimAnimations(const TrimSettings& settings = TrimSettings());
+
        /**
         * @brief Add an animation created from a spritesheet to the set of available animations.
         * @param name The name of the animation.
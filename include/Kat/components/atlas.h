@@ -0,0 +1,162 @@
+#pragma once
+
+#include <SFML/Graphics/Image.hpp>
+
+#include "./texture.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief A page of a texture atlas and the state of its packer.
+     */
+    struct AtlasPage;
+
+    /**
+     * @brief Where an image was packed: the index of its page and its region in the page.
+     */
+    struct AtlasRegion {
+        u32 page = 0;
+        Frame region;
+    };
+
+    /**
+     * @brief Packs individually loaded images into shared pages at load time,
+     *        so sprites of different images can be batched together.
+     *
+     *        Images are packed incrementally with the skyline packer of stb (imstb_rectpack).
+     *        Each image is surrounded by its extruded edges, so linear filtering samples
+     *        the image itself, then by transparent padding.
+     *        The returned textures are regions of a page (see Texture::setRegion()):
+     *        sprites created from them remap their texture rects transparently.
+     */
+    class TextureAtlas {
+    public:
+        /**
+         * @brief Constructs a new Texture Atlas object.
+         *
+         * @param page_size The size of the pages, larger images get their own texture.
+         * @param padding The transparent pixels between images.
+         * @param extrusion The number of times the edges of the images are repeated.
+         */
+        TextureAtlas(const TextureSize& page_size = TextureSize(2048, 2048),
+                     TextureCoordinate padding = 1, TextureCoordinate extrusion = 1);
+
+        /**
+         * @brief Packs an image.
+         *
+         * @param image The image.
+         * @return Texture The region of the image in its page.
+         */
+        Texture add(const sf::Image& image);
+
+        /**
+         * @brief Loads and packs an image, an image loaded twice is packed once.
+         *
+         * @param filename The filename of the image.
+         * @return Texture The region of the image, a null texture if loading failed.
+         */
+        Texture load(const std::string& filename);
+
+        /**
+         * @brief Loads and packs an image from memory.
+         *
+         * @param data The data of the image.
+         * @param size The size of the data.
+         * @return Texture The region of the image, a null texture if loading failed.
+         */
+        Texture load(const Memory data, usize size);
+
+        /**
+         * @brief Gets the number of pages.
+         *
+         * @return usize The number of pages.
+         */
+        usize pages() const;
+
+        /**
+         * @brief Gets the texture of a page.
+         *
+         * @param index The index of the page.
+         * @return Texture The texture of the page.
+         */
+        Texture page(usize index) const;
+
+        /**
+         * @brief Sets the smoothing of every page, present and future.
+         *
+         * @param smooth Whether the pages are smooth.
+         * @return TextureAtlas& Reference to self.
+         */
+        TextureAtlas& setSmooth(bool smooth);
+
+        /**
+         * @brief Forgets every page, the textures already handed out stay valid.
+         */
+        void clear();
+
+        ~TextureAtlas();
+
+    private:
+        TextureSize m_page_size;
+        TextureCoordinate m_padding;
+        TextureCoordinate m_extrusion;
+        bool m_smooth = false;
+        std::vector<std::unique_ptr<AtlasPage>> m_pages;
+        std::unordered_map<std::string, Texture> m_files; ///< Packed images by filename.
+    };
+
+    /**
+     * @brief Packs images into pages on the cpu, the way TextureAtlas does, so atlases
+     *        can be baked offline (see kat_pak) and uploaded as whole pages.
+     */
+    class ImageAtlas {
+    public:
+        /**
+         * @brief Constructs a new Image Atlas object.
+         *
+         * @param page_size The size of the pages.
+         * @param padding The transparent pixels between images.
+         * @param extrusion The number of times the edges of the images are repeated.
+         */
+        ImageAtlas(const TextureSize& page_size = TextureSize(2048, 2048),
+                   TextureCoordinate padding = 1, TextureCoordinate extrusion = 1);
+
+        /**
+         * @brief Packs an image.
+         *
+         * @param image The image.
+         * @return std::optional<AtlasRegion> The page and region of the image, none if it
+         *         is empty or does not fit in a page.
+         */
+        std::optional<AtlasRegion> add(const sf::Image& image);
+
+        /**
+         * @brief Gets the number of pages.
+         *
+         * @return usize The number of pages.
+         */
+        usize pages() const;
+
+        /**
+         * @brief Gets the image of a page.
+         *
+         * @param index The index of the page.
+         * @return const sf::Image& The image of the page.
+         */
+        const sf::Image& page(usize index) const;
+
+        ~ImageAtlas();
+
+    private:
+        TextureSize m_page_size;
+        TextureCoordinate m_padding;
+        TextureCoordinate m_extrusion;
+        std::vector<std::unique_ptr<AtlasPage>> m_pages;
+    };
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <SFML/Graphics/RenderTexture.hpp>
+#include <SFML/Graphics/Transformable.hpp>
+
+#include "./sprite.h"
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief A region of a page of a composite atlas.
+     */
+    struct CompositeRegion {
+        usize page; ///< The page holding the region.
+        Frame rect; ///< The rect of the region, padding excluded.
+    };
+
+    /**
+     * @brief A pool of render textures that composites are baked into.
+     *        Pages are split into shelves (rows of regions as high as their tallest region),
+     *        released regions are reused by regions that fit in them and empty pages
+     *        are kept for the next allocations.
+     */
+    class CompositeAtlas {
+    public:
+        /**
+         * @brief The size of a page, regions larger than a page can not be baked.
+         */
+        static constexpr TextureCoordinate PageSize = 2048;
+
+        /**
+         * @brief The transparent pixels around a region, so linear filtering does not
+         *        bleed the neighbouring regions.
+         */
+        static constexpr TextureCoordinate Padding = 1;
+
+        /**
+         * @brief Allocates a region.
+         *
+         * @param size The size of the region.
+         * @return std::optional<CompositeRegion> The region, empty if it is larger than a page
+         *         or the render texture could not be created.
+         */
+        std::optional<CompositeRegion> allocate(const FrameSize& size);
+
+        /**
+         * @brief Releases a region, it can be handed out again.
+         *
+         * @param region The region.
+         */
+        void release(const CompositeRegion& region);
+
+        /**
+         * @brief Gets the render texture of a page.
+         *
+         * @param page The page.
+         * @return sf::RenderTexture& The render texture.
+         */
+        sf::RenderTexture& target(usize page);
+
+        /**
+         * @brief Gets the texture of a page, it lives as long as the page.
+         *
+         * @param page The page.
+         * @return Texture The texture.
+         */
+        Texture texture(usize page) const;
+
+        /**
+         * @brief Gets the number of pages.
+         *
+         * @return usize The number of pages.
+         */
+        usize pages() const;
+
+        /**
+         * @brief Returns a reference to the atlas shared by every composite by default.
+         * @return CompositeAtlas& The atlas.
+         */
+        static CompositeAtlas& instance();
+
+        /**
+         * @brief Destroys the shared atlas, after every composite using it
+         *        and before the gl context is destroyed.
+         */
+        static void destroy();
+
+        CompositeAtlas() = default;
+        ~CompositeAtlas() = default;
+
+    private:
+        /**
+         * @brief A row of regions of a page.
+         */
+        struct Shelf {
+            TextureCoordinate top;         ///< The top of the shelf.
+            TextureCoordinate height;      ///< The height of the shelf.
+            TextureCoordinate cursor = 0;  ///< The left of the free space at the end of the shelf.
+            std::vector<Frame> free;       ///< Released regions, padding included.
+        };
+
+        /**
+         * @brief A render texture and its shelves.
+         */
+        struct Page {
+            std::shared_ptr<sf::RenderTexture> target;
+            std::vector<Shelf> shelves;
+            TextureCoordinate bottom = 0; ///< The top of the free space under the shelves.
+            usize used = 0;               ///< The number of regions in use.
+        };
+
+        std::optional<Frame> allocate(Page& page, const FrameSize& size);
+
+        std::vector<Page> m_pages;
+
+        static CompositeAtlas *m_Instance; ///< The atlas shared by every composite by default.
+    };
+
+    /**
+     * @brief The state of a composite, shared between its copies like sprites.
+     */
+    struct CompositeState;
+
+    /**
+     * @brief A character made of layered sprites (body, equipment, effects...)
+     *        baked into a region of a CompositeAtlas and drawn as a single quad.
+     *
+     *        Parts are positioned relative to the composite. The composite is baked
+     *        again only when a part changes its texture, texture rect, color, mesh
+     *        or relative transform, or when parts are added or removed.
+     *        Composites too large for a page are drawn part by part.
+     */
+    class CompositeSprite {
+    public:
+        /**
+         * @brief Constructs a new Composite Sprite object.
+         * @param atlas The atlas to bake into.
+         */
+        CompositeSprite(CompositeAtlas& atlas = CompositeAtlas::instance());
+
+        /**
+         * @brief Adds a part on top of the previous ones.
+         *        The part shares its state with the given sprite, so modifying the sprite
+         *        modifies the part.
+         * @param part The part, its transform is relative to the composite.
+         * @return CompositeSprite& Reference to self.
+         */
+        CompositeSprite& add(const Sprite& part);
+
+        /**
+         * @brief Removes a part.
+         * @param index The index of the part.
+         * @return CompositeSprite& Reference to self.
+         */
+        CompositeSprite& remove(usize index);
+
+        /**
+         * @brief Removes every part.
+         * @return CompositeSprite& Reference to self.
+         */
+        CompositeSprite& clear();
+
+        /**
+         * @brief Gets a part.
+         * @param index The index of the part.
+         * @return Sprite& The part.
+         */
+        Sprite& part(usize index);
+
+        /**
+         * @brief Gets the number of parts.
+         * @return usize The number of parts.
+         */
+        usize size() const;
+
+        /**
+         * @brief Bakes the parts if they changed since the last bake.
+         *        Called when the composite is drawn or batched.
+         * @return bool Whether the parts were baked.
+         */
+        bool bake() const;
+
+        /**
+         * @brief Is the composite drawn from the atlas?
+         * @return true The composite is baked.
+         * @return false The composite is drawn part by part.
+         */
+        bool isBaked() const;
+
+        /**
+         * @brief Sets the position of the composite.
+         * @param position The position of the composite.
+         * @return CompositeSprite& Reference to self.
+         */
+        CompositeSprite& setPosition(const Position& position);
+
+        /**
+         * @brief Sets the rotation of the composite.
+         * @param angle The angle of the composite.
+         * @return CompositeSprite& Reference to self.
+         */
+        CompositeSprite& setRotation(const Angle& angle);
+
+        /**
+         * @brief Sets the scale of the composite.
+         * @param scale The scale of the composite.
+         * @return CompositeSprite& Reference to self.
+         */
+        CompositeSprite& setScale(const Scale& scale);
+
+        /**
+         * @brief Sets the origin of the composite, in the space of the parts.
+         * @param origin The origin of the composite.
+         * @return CompositeSprite& Reference to self.
+         */
+        CompositeSprite& setOrigin(const Position& origin);
+
+        /**
+         * @brief Gets the position of the composite.
+         * @return Position The position of the composite.
+         */
+        Position getPosition() const;
+
+        /**
+         * @brief Gets the rotation of the composite.
+         * @return Angle The rotation of the composite.
+         */
+        Angle getRotation() const;
+
+        /**
+         * @brief Gets the scale of the composite.
+         * @return Scale The scale of the composite.
+         */
+        Scale getScale() const;
+
+        /**
+         * @brief Gets the origin of the composite.
+         * @return Position The origin of the composite.
+         */
+        Position getOrigin() const;
+
+        /**
+         * @brief Gets the texture the composite is drawn from.
+         * @return const Texture& The page of the atlas, empty when not baked.
+         */
+        const Texture& getTexture() const;
+
+        /**
+         * @brief Gets the global bounds of the composite.
+         * @return GlobalBounds The global bounds.
+         */
+        GlobalBounds getGlobalBounds() const;
+
+        /**
+         * @brief Draws the composite.
+         * @param window The window to draw to.
+         */
+        void draw(Window& window) const;
+
+        shared_drawable_t as_drawable() const;
+
+    private:
+        std::shared_ptr<CompositeState> m_state;
+    };
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "./sprite.h"
+
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief A pool of reusable buffers, regions of a texture are copied into them
+     *        when their rows are not contiguous.
+     */
+    class StagingPool {
+    public:
+        /**
+         * @brief Takes a buffer from the pool, or allocates one.
+         *
+         * @param size The size of the buffer, in bytes.
+         * @return std::vector<u8> The buffer, of the requested size.
+         */
+        std::vector<u8> acquire(usize size);
+
+        /**
+         * @brief Gives a buffer back to the pool.
+         *
+         * @param buffer The buffer.
+         */
+        void release(std::vector<u8>&& buffer);
+
+        /**
+         * @brief Frees the buffers of the pool.
+         */
+        void clear();
+
+        /**
+         * @brief Gets the bytes held by the pool.
+         *
+         * @return usize The capacity of the pooled buffers.
+         */
+        usize capacity() const;
+
+        /**
+         * @brief Returns a reference to the pool shared by every dynamic texture by default.
+         * @return StagingPool& The pool.
+         */
+        static StagingPool& instance();
+
+        /**
+         * @brief Destroys the shared pool.
+         */
+        static void destroy();
+
+        StagingPool() = default;
+        ~StagingPool() = default;
+
+    private:
+        /**
+         * @brief The maximum number of pooled buffers.
+         */
+        static constexpr usize MaxBuffers = 8;
+
+        std::vector<std::vector<u8>> m_buffers;
+
+        static StagingPool *m_Instance; ///< The pool shared by every dynamic texture by default.
+    };
+
+    /**
+     * @brief A texture updated every frame (minimaps, canvases, fog of war).
+     *
+     *        The pixels are kept on the cpu: modify them, mark the modified rects dirty
+     *        and call flush() once per frame. Dirty rects are merged when merging wastes
+     *        little, and only they are uploaded, through buffers of a StagingPool.
+     *        An upload budget spreads large updates across frames.
+     */
+    class DynamicTexture {
+    public:
+        /**
+         * @brief The maximum number of dirty rects, more rects are merged into their bounds.
+         */
+        static constexpr usize MaxDirtyRects = 16;
+
+        /**
+         * @brief Constructs a new Dynamic Texture object.
+         * @param pool The pool of staging buffers.
+         */
+        DynamicTexture(StagingPool& pool = StagingPool::instance());
+
+        /**
+         * @brief Creates the texture and its pixels, transparent.
+         *
+         * @param size The size of the texture.
+         * @return DynamicTexture& Reference to self.
+         * @throw std::runtime_error If the texture could not be created, the dynamic
+         *        texture is then empty.
+         */
+        DynamicTexture& create(const TextureSize& size);
+
+        /**
+         * @brief Gets the size of the texture.
+         *
+         * @return TextureSize The size.
+         */
+        TextureSize size() const;
+
+        /**
+         * @brief Gets the rgba pixels of the texture, mark the pixels you modify dirty.
+         *
+         * @return Pixels The pixels, row by row.
+         */
+        Pixels pixels();
+
+        /**
+         * @brief Sets a pixel and marks it dirty.
+         *
+         * @param x The x position of the pixel.
+         * @param y The y position of the pixel.
+         * @param color The color of the pixel.
+         * @return DynamicTexture& Reference to self.
+         */
+        DynamicTexture& setPixel(TextureCoordinate x, TextureCoordinate y, const Color& color);
+
+        /**
+         * @brief Copies pixels into a rect and marks it dirty.
+         *        The part of the rect outside the texture is skipped.
+         *
+         * @param pixels The rgba pixels of the rect.
+         * @param frame The rect, may be partly outside the texture.
+         * @return DynamicTexture& Reference to self.
+         */
+        DynamicTexture& update(const Pixels pixels, const Frame& frame);
+
+        /**
+         * @brief Marks a rect dirty, it is uploaded by the next flush.
+         *
+         * @param frame The rect, clipped to the texture.
+         * @return DynamicTexture& Reference to self.
+         */
+        DynamicTexture& markDirty(const Frame& frame);
+
+        /**
+         * @brief Sets the maximum number of bytes uploaded per flush.
+         *
+         * @param bytes The budget, 0 for no budget.
+         * @return DynamicTexture& Reference to self.
+         */
+        DynamicTexture& setUploadBudget(usize bytes);
+
+        /**
+         * @brief Gets the maximum number of bytes uploaded per flush.
+         *
+         * @return usize The budget, 0 for no budget.
+         */
+        usize getUploadBudget() const;
+
+        /**
+         * @brief Uploads the dirty rects, within the budget.
+         *        Rects that do not fit are uploaded by the next flushes, at least one row
+         *        is uploaded per flush.
+         *
+         * @return usize The number of bytes uploaded.
+         */
+        usize flush();
+
+        /**
+         * @brief Gets the dirty rects.
+         *
+         * @return const std::vector<Frame>& The rects waiting for an upload.
+         */
+        const std::vector<Frame>& getDirtyRects() const;
+
+        /**
+         * @brief Gets the texture.
+         *
+         * @return const Texture& The texture.
+         */
+        const Texture& getTexture() const;
+
+    private:
+        /**
+         * @brief Uploads a rect, through a staging buffer unless its rows are contiguous.
+         */
+        void upload(const Frame& frame);
+
+        StagingPool* m_pool;
+        Texture m_texture;
+        TextureSize m_size;
+        std::vector<u8> m_pixels;
+        std::vector<Frame> m_dirty;
+        usize m_budget = 0;
+    };
+}
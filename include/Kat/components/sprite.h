@@ -3,7 +3,9 @@
 #include <SFML/Graphics/Sprite.hpp>
 
 #include "./texture.h"
+#include "./trim.h"
 #include "../batch.h"
+#include "../effects.h"
 
 namespace kat {
 
@@ -47,6 +49,55 @@ namespace kat {
      */
     using LocalBounds = FloatRect;
 
+    /**
+     * @brief Draws a sprite as a tight convex polygon instead of a quad.
+     *        Only the pixels covered by the hull are rasterized.
+     *        A sprite keeps its mesh, changing frames only points it to another hull.
+     */
+    class SpriteMesh : public sf::Drawable {
+    public:
+        /**
+         * @brief Constructs a new Sprite Mesh object.
+         * @param sprite The sprite to draw.
+         */
+        SpriteMesh(const shared_sprite_t& sprite);
+
+        /**
+         * @brief Sets the polygon of the mesh.
+         * @param hull The polygon, local to the texture rect of the sprite, null for none.
+         */
+        void setHull(const shared_frame_hull_t& hull);
+
+        /**
+         * @brief Gets the polygon of the mesh.
+         * @return const shared_frame_hull_t& The polygon, null for none.
+         */
+        const shared_frame_hull_t& getHull() const;
+
+    protected:
+        void draw(sf::RenderTarget& target, const sf::RenderStates& states) const override;
+
+    private:
+        shared_sprite_t m_sprite;
+        shared_frame_hull_t m_hull;
+        mutable std::vector<sf::Vertex> m_vertices;
+    };
+
+    /**
+     * @brief A shared pointer to a sprite mesh.
+     */
+    using shared_sprite_mesh_t = std::shared_ptr<SpriteMesh>;
+
+    /**
+     * @brief The state of a sprite that sfml does not hold,
+     *        shared between its copies like the sprite itself.
+     */
+    struct SpriteState {
+        Position trim_offset;      ///< Offset of the texture rect inside its untrimmed frame.
+        shared_sprite_mesh_t mesh; ///< Draws the tight polygon, created with the first one and kept.
+        EffectParams effect;       ///< The effect applied by the uber shader.
+    };
+
     class Sprite {
     public:
         /**
@@ -125,6 +176,61 @@ namespace kat {
          */
         Sprite& setOrigin(const Position& origin);
 
+        /**
+         * @brief Sets the offset of the texture rect inside its untrimmed frame.
+         *        The origin keeps referring to the untrimmed frame so trimmed
+         *        animations do not jitter.
+         * @param offset The offset of the trimmed texture rect.
+         * @return Sprite& Reference to self.
+         */
+        Sprite& setTrimOffset(const Position& offset);
+
+        /**
+         * @brief Gets the offset of the texture rect inside its untrimmed frame.
+         * @return Position The trim offset.
+         */
+        Position getTrimOffset() const;
+
+        /**
+         * @brief Draws the sprite as a tight polygon instead of a quad.
+         *        An empty hull restores the quad.
+         * @param hull The polygon, local to the texture rect.
+         * @return Sprite& Reference to self.
+         */
+        Sprite& setMesh(const FrameHull& hull);
+
+        /**
+         * @brief Draws the sprite as a shared tight polygon instead of a quad, the hull
+         *        is pointed to, not copied (see FrameTrim::hull).
+         * @param hull The polygon, local to the texture rect, null restores the quad.
+         * @return Sprite& Reference to self.
+         */
+        Sprite& setMesh(const shared_frame_hull_t& hull);
+
+        /**
+         * @brief Sets the effect of the sprite.
+         *        Effects are applied when the sprite is drawn by a BatchRenderer
+         *        using the uber shader (see BatchRenderer::setUberShader()).
+         * @param effect The effect.
+         * @param strength The strength of the effect, from 0 to 1.
+         * @param color The color used by the effect.
+         * @return Sprite& Reference to self.
+         */
+        Sprite& setEffect(const SpriteEffect& effect, const EffectStrength& strength = 1.0f,
+                          const Color& color = Color::White);
+
+        /**
+         * @brief Gets the effect of the sprite.
+         * @return const EffectParams& The effect.
+         */
+        const EffectParams& getEffect() const;
+
+        /**
+         * @brief Gets the tight polygon of the sprite.
+         * @return const FrameHull* The polygon, null when the sprite is a quad.
+         */
+        const FrameHull* getMesh() const;
+
         /**
          * @brief Gets the position of the sprite.
          * @return Position& The position of the sprite.
@@ -273,5 +379,6 @@ namespace kat {
     private:
         Texture m_texture;
         shared_sprite_t m_sprite = std::make_shared<sf::Sprite>();
+        std::shared_ptr<SpriteState> m_state = std::make_shared<SpriteState>();
     };
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "../meta.h"
 #include "../window.h"
 
+#include <SFML/Graphics/Image.hpp>
 #include <SFML/Graphics/Texture.hpp>
 
 #include <memory>
@@ -77,6 +78,9 @@ namespace kat {
 
         /**
          * @brief Loads a texture from a file.
+         *        Files already loaded share their texture (see TextureCache),
+         *        decoded pixels are reused from the ImageCache when it is enabled.
+         *        .qoi files are decoded without sfml, see ImageFormat.
          * @param filename The filename of the texture.
          * @param area The area of the texture.
          * @return Texture& Reference to self.
@@ -86,6 +90,9 @@ namespace kat {
 
         /**
          * @brief Loads a texture from memory.
+         *        Pre-decoded images (a RawImageHeader followed by rgba pixels, as stored
+         *        in paks) are uploaded as is, qoi images are decoded without sfml (bands
+         *        of large images across threads, see ImageFormat), other data is decoded by sfml.
          * 
          * @param data The data of the texture.
          * @param size The size of the data.
@@ -235,6 +242,41 @@ namespace kat {
          */
         bool repeated(bool rep);
 
+        /**
+         * @brief Restricts the texture to a region of its sfml texture.
+         *        Textures packed in a TextureAtlas share the page of the atlas,
+         *        sprites map their texture rects into the region transparently.
+         *        Updates are relative to the region and clipped to it, updates from
+         *        textures and windows then go through a cpu copy.
+         * 
+         * @param region The region, an empty region restores the whole texture.
+         * @return Texture& Reference to self.
+         */
+        Texture& setRegion(const Frame& region);
+
+        /**
+         * @brief Is the texture a region of its sfml texture?
+         * 
+         * @return true The texture is a region (see setRegion()).
+         * @return false The texture is the whole sfml texture.
+         */
+        bool hasRegion() const;
+
+        /**
+         * @brief Gets the region of the sfml texture covered by the texture.
+         * 
+         * @return const Frame& The region, empty when the whole texture is used.
+         */
+        const Frame& region() const;
+
+        /**
+         * @brief Copies the texture back from the gpu.
+         *        This is slow, use it for asset processing only.
+         * 
+         * @return sf::Image The pixels of the texture.
+         */
+        sf::Image copyToImage() const;
+
         /**
          * @brief Get the native handle of the texture.
          * 
@@ -242,6 +284,20 @@ namespace kat {
          */
         sf::Texture* raw_handle();
 
+        /**
+         * @brief Get the native handle of the texture. (const)
+         * 
+         * @return const sf::Texture* The native handle of the texture.
+         */
+        const sf::Texture* raw_handle() const;
+
+        /**
+         * @brief Get the shared native handle of the texture.
+         * 
+         * @return const shared_texture_t& The shared native handle of the texture.
+         */
+        const shared_texture_t& shared_handle() const;
+
         /**
          * @brief Construct a new Texture object
          */
@@ -319,6 +375,13 @@ namespace kat {
         Texture& operator=(Texture&&) = default;
 
     private:
+        /**
+         * @brief Gives the texture its own copy of a texture shared through the
+         *        TextureCache, before it is modified.
+         */
+        void detach();
+
         shared_texture_t m_texture;
+        Frame m_region; ///< The region of the sfml texture, empty for the whole texture.
     };
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "./texture.h"
+
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief Shares the textures loaded from the same file, or from files with the same content.
+     *
+     *        Textures are found by the canonical path of their file first, then by a hash of
+     *        the content of the file, so copies of a file are uploaded once.
+     *        The cache only holds weak references: a texture is freed once the last
+     *        kat::Texture using it is destroyed.
+     *        Texture::load(filename) goes through the cache, textures loaded from the same
+     *        file share their sf::Texture, like copies of a kat::Texture. A texture of the
+     *        cache is copied the first time it is modified (updates, smoothing, repetition),
+     *        so the other textures of the file and the later loads keep the file's pixels.
+     *        Content hits compare the content byte for byte with the file the texture was
+     *        loaded from, read again, so the cache keeps no copy of the contents.
+     */
+    class TextureCache {
+    public:
+        /**
+         * @brief Finds the texture of a file.
+         *
+         * @param filename The filename of the texture.
+         * @param area The area of the file, textures of different areas are different.
+         * @return shared_texture_t The texture, null if it is not cached.
+         */
+        shared_texture_t find(const std::string& filename, const Frame& area = Frame());
+
+        /**
+         * @brief Finds the texture of a file by the content of the file.
+         *        The file is then found by its path too.
+         *
+         * @param filename The filename of the texture.
+         * @param content The content of the file.
+         * @param area The area of the file.
+         * @return shared_texture_t The texture, null if no file with this content is cached.
+         */
+        shared_texture_t find(const std::string& filename, std::span<const u8> content, const Frame& area = Frame());
+
+        /**
+         * @brief Adds the texture of a file.
+         *
+         * @param filename The filename of the texture.
+         * @param content The content of the file, may be empty if unknown.
+         * @param area The area of the file.
+         * @param texture The texture.
+         */
+        void insert(const std::string& filename, std::span<const u8> content, const Frame& area,
+                    const shared_texture_t& texture);
+
+        /**
+         * @brief Is a texture shared through the cache? It has to be copied before it
+         *        is modified, see Texture::update.
+         *
+         * @param texture The texture.
+         * @return true The texture was inserted and is alive.
+         * @return false The texture is not in the cache.
+         */
+        bool contains(const shared_texture_t& texture) const;
+
+        /**
+         * @brief Enables or disables the cache, a disabled cache finds nothing.
+         *
+         * @param enabled Whether the cache is enabled.
+         * @return TextureCache& Reference to self.
+         */
+        TextureCache& setEnabled(bool enabled);
+
+        /**
+         * @brief Is the cache enabled?
+         *
+         * @return true The cache is enabled.
+         * @return false The cache is disabled.
+         */
+        bool isEnabled() const;
+
+        /**
+         * @brief Forgets every texture, the textures themselves live on.
+         *        The textures alive are no longer copied before they are modified.
+         */
+        void clear();
+
+        /**
+         * @brief Gets the number of files whose texture is alive.
+         *
+         * @return usize The number of files.
+         */
+        usize size() const;
+
+        /**
+         * @brief Gets the number of textures found by their path.
+         *
+         * @return usize The number of hits.
+         */
+        usize hits() const;
+
+        /**
+         * @brief Gets the number of textures found by the content of their file.
+         *
+         * @return usize The number of hits.
+         */
+        usize contentHits() const;
+
+        /**
+         * @brief Gets the number of textures that were not found.
+         *
+         * @return usize The number of misses.
+         */
+        usize misses() const;
+
+        /**
+         * @brief Returns a reference to the singleton instance of the TextureCache.
+         * @return TextureCache& The texture cache.
+         */
+        static TextureCache& instance();
+
+        /**
+         * @brief Destroys the singleton instance of the TextureCache.
+         */
+        static void destroy();
+
+        TextureCache() = default;
+        ~TextureCache() = default;
+
+    private:
+        /**
+         * @brief The number of insertions between two removals of the expired entries.
+         */
+        static constexpr usize PruneInterval = 64;
+
+        static std::string pathKey(const std::string& filename, const Frame& area);
+
+        static u64 contentKey(std::span<const u8> content, const Frame& area);
+
+        static bool hasContent(const std::string& filename, std::span<const u8> content);
+
+        void prune();
+
+        /**
+         * @brief A texture found by the content of its file.
+         */
+        struct ContentEntry {
+            std::weak_ptr<sf::Texture> texture;
+            std::string filename; ///< Read again and compared on hits, hashes may collide.
+            usize size = 0;
+            Frame area;
+        };
+
+        mutable std::mutex m_mutex;
+        std::unordered_map<std::string, std::weak_ptr<sf::Texture>> m_paths;
+        std::unordered_map<u64, ContentEntry> m_contents;
+        std::unordered_map<const sf::Texture *, std::weak_ptr<sf::Texture>> m_textures; ///< Every texture inserted.
+        bool m_enabled = true;
+        usize m_inserted = 0;
+        usize m_hits = 0;
+        usize m_content_hits = 0;
+        usize m_misses = 0;
+
+        static TextureCache *m_Instance; ///< The singleton instance of the TextureCache.
+    };
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "./texture.h"
+
+#include <mutex>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief Destroys the textures released by their last kat::Texture in batches.
+     *
+     *        Releasing a texture only queues it, from any thread. The queue is flushed
+     *        at the end of the frame by Window::display() (or Window::endFrame() for frames
+     *        presented otherwise) and when a window is destroyed, on the render thread with
+     *        its context active, so textures dropped mid-frame or by workers never delete
+     *        gl objects in the middle of a frame or in the context of another thread.
+     *        Tools without a window loop have to call setDeferred(false), or flush()
+     *        themselves, otherwise released textures stay queued until exit.
+     */
+    class TextureReleaseQueue {
+    public:
+        /**
+         * @brief Queues a texture, or destroys it right away when the queue is disabled.
+         * @param texture The texture, owned by the queue.
+         */
+        void push(sf::Texture *texture);
+
+        /**
+         * @brief Destroys every queued texture. Call it on the render thread.
+         * @return usize The number of textures destroyed.
+         */
+        usize flush();
+
+        /**
+         * @brief Sets whether textures are queued or destroyed right away.
+         *        Disabling the queue flushes it.
+         * @param deferred Whether textures are queued.
+         * @return TextureReleaseQueue& Reference to self.
+         */
+        TextureReleaseQueue& setDeferred(bool deferred);
+
+        /**
+         * @brief Are textures queued?
+         * @return true Textures are destroyed by flush().
+         * @return false Textures are destroyed by their last owner.
+         */
+        bool isDeferred() const;
+
+        /**
+         * @brief Gets the number of queued textures.
+         * @return usize The number of textures.
+         */
+        usize pending() const;
+
+        /**
+         * @brief Gets the number of textures destroyed since the queue was created.
+         * @return usize The number of textures.
+         */
+        usize destroyed() const;
+
+        /**
+         * @brief Gets the number of textures destroyed by the last flush.
+         * @return usize The number of textures.
+         */
+        usize lastBatch() const;
+
+        /**
+         * @brief Returns a reference to the queue, created on first use.
+         * @return TextureReleaseQueue& The queue.
+         */
+        static TextureReleaseQueue& instance();
+
+        /**
+         * @brief Flushes and destroys the queue, before the gl context is destroyed.
+         */
+        static void destroy();
+
+        TextureReleaseQueue() = default;
+        ~TextureReleaseQueue();
+
+    private:
+        mutable std::mutex m_mutex;
+        std::vector<sf::Texture *> m_queue;
+        bool m_deferred = true;
+        usize m_destroyed = 0;
+        usize m_last_batch = 0;
+
+        static TextureReleaseQueue *m_Instance;
+    };
+
+    /**
+     * @brief The deleter of shared textures, it queues them in the release queue.
+     */
+    struct TextureDeleter {
+        void operator()(sf::Texture *texture) const;
+    };
+
+    /**
+     * @brief Creates an empty shared texture released through the release queue.
+     * @return shared_texture_t The texture.
+     */
+    shared_texture_t makeSharedTexture();
+
+    /**
+     * @brief Takes the ownership of a texture, released through the release queue.
+     * @param texture The texture, may be null.
+     * @return shared_texture_t The shared texture.
+     */
+    shared_texture_t makeSharedTexture(sf::Texture *texture);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <SFML/Graphics/Image.hpp>
+
+#include "./texture.h"
+
+#include <memory>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief A convex polygon covering the opaque pixels of a frame.
+     *        Points are local to the trimmed frame and ordered around the polygon.
+     */
+    using FrameHull = std::vector<Position>;
+
+    /**
+     * @brief A shared frame hull, built once and pointed to by the sprites showing its frame.
+     */
+    using shared_frame_hull_t = std::shared_ptr<const FrameHull>;
+
+    /**
+     * @brief An alpha value.
+     */
+    using AlphaThreshold = u8;
+
+    /**
+     * @brief The result of trimming a single frame.
+     */
+    struct FrameTrim {
+        Frame source;    ///< The frame before trimming.
+        Frame trimmed;   ///< The smallest rect containing every opaque pixel of the frame.
+        Position offset; ///< Position of the trimmed rect inside the source frame.
+        shared_frame_hull_t hull; ///< Optional tight polygon, null when the quad is good enough.
+    };
+
+    /**
+     * @brief A list of trimmed frames.
+     */
+    using FrameTrimList = std::vector<FrameTrim>;
+
+    /**
+     * @brief Settings of the trimming step.
+     */
+    struct TrimSettings {
+        AlphaThreshold alpha_threshold = 0; ///< Pixels with an alpha lower or equal are transparent.
+        bool build_hull = false;            ///< Whether to generate tight polygons.
+        TextureCoordinate hull_min_area = 64 * 64; ///< Frames smaller than this keep a quad.
+        usize hull_max_points = 8;          ///< Maximum number of points of a polygon.
+        float hull_max_coverage = 0.85f;    ///< Polygons covering more of the quad are discarded.
+    };
+
+    /**
+     * @brief Trims the fully transparent borders of a frame.
+     *
+     * @param image The image containing the frame.
+     * @param frame The frame to trim.
+     * @param settings The trimming settings.
+     * @return FrameTrim The trimmed frame.
+     */
+    FrameTrim trimFrame(const sf::Image& image, const Frame& frame,
+                        const TrimSettings& settings = TrimSettings());
+
+    /**
+     * @brief Trims the fully transparent borders of a list of frames.
+     *
+     * @param image The image containing the frames.
+     * @param frames The frames to trim.
+     * @param settings The trimming settings.
+     * @return FrameTrimList The trimmed frames, in the same order.
+     */
+    FrameTrimList trimFrames(const sf::Image& image, const std::vector<Frame>& frames,
+                             const TrimSettings& settings = TrimSettings());
+}
@@ -0,0 +1,491 @@
+#pragma once
+
+#include "./resource.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace kat {
+
+    class ConcurrentResourcePoolBase {
+    public:
+        virtual ~ConcurrentResourcePoolBase() = default;
+
+        /**
+         * @brief Removes every resource, readers holding one keep it alive.
+         */
+        virtual void clear() = 0;
+    };
+
+    /**
+     * @brief The resources of a type, shared between threads.
+     *
+     *        Names are split into shards, each one a split-ordered list (Shalev & Shavit):
+     *        a single linked list sorted by the bit-reversed hash of the names, indexed by
+     *        buckets pointing into it. Doubling the buckets only adds indices to the same
+     *        list, nothing is rehashed nor copied. Every entry is published by a single
+     *        atomic pointer store, readers walk the list without locks and never wait.
+     *        Writers of the same shard are serialized, writers of different shards are not.
+     *        Replaced and removed entries are freed by a later write once no reader is in
+     *        the shard.
+     */
+    template<typename T>
+    class ConcurrentResourcePool : public ConcurrentResourcePoolBase {
+    public:
+        /**
+         * @brief The number of shards, writers of a shard are serialized.
+         */
+        static constexpr usize Shards = 16;
+
+        using Value = std::shared_ptr<const T>;
+
+        /**
+         * @brief Finds a resource.
+         * @param name The name of the resource.
+         * @return Value The resource, null if there is none.
+         */
+        Value find(const ResourceName& name) const {
+            const usize hash = std::hash<ResourceName>{}(name);
+
+            return m_shards[hash % Shards].find(name, hash / Shards);
+        }
+
+        /**
+         * @brief Adds a resource.
+         * @param name The name of the resource.
+         * @param resource The resource.
+         * @param replace Whether a resource of the same name is replaced or kept.
+         * @return bool Whether the resource was added.
+         */
+        bool insert(const ResourceName& name, Value resource, bool replace) {
+            const usize hash = std::hash<ResourceName>{}(name);
+
+            return m_shards[hash % Shards].insert(name, hash / Shards, std::move(resource), replace);
+        }
+
+        /**
+         * @brief Removes a resource.
+         * @param name The name of the resource.
+         * @return bool Whether the resource existed.
+         */
+        bool remove(const ResourceName& name) {
+            const usize hash = std::hash<ResourceName>{}(name);
+
+            return m_shards[hash % Shards].remove(name, hash / Shards);
+        }
+
+        /**
+         * @brief Gets the number of resources.
+         * @return usize The number of resources, a snapshot while writers run.
+         */
+        usize size() const {
+            usize total = 0;
+
+            for (const auto& shard : m_shards)
+                total += shard.size();
+            return total;
+        }
+
+        void clear() override {
+            for (auto& shard : m_shards)
+                shard.clear();
+        }
+
+    private:
+        /**
+         * @brief An entry of the list. Its key is the bit-reversed hash of its name, odd for
+         *        resources. Buckets are even keys without resource, they are never removed.
+         */
+        struct Node {
+            usize key = 0;
+            ResourceName name;
+            Value value;
+            std::atomic<Node *> next = nullptr;
+        };
+
+        static constexpr usize reverseBits(usize value) {
+            u64 bits = value;
+
+            bits = (bits >> 1 & 0x5555555555555555ULL) | (bits & 0x5555555555555555ULL) << 1;
+            bits = (bits >> 2 & 0x3333333333333333ULL) | (bits & 0x3333333333333333ULL) << 2;
+            bits = (bits >> 4 & 0x0F0F0F0F0F0F0F0FULL) | (bits & 0x0F0F0F0F0F0F0F0FULL) << 4;
+            bits = (bits >> 8 & 0x00FF00FF00FF00FFULL) | (bits & 0x00FF00FF00FF00FFULL) << 8;
+            bits = (bits >> 16 & 0x0000FFFF0000FFFFULL) | (bits & 0x0000FFFF0000FFFFULL) << 16;
+            bits = bits >> 32 | bits << 32;
+            return (usize)(bits >> (64 - sizeof(usize) * 8));
+        }
+
+        class Shard {
+        public:
+            /**
+             * @brief The buckets are allocated in segments that are never moved: the first
+             *        one holds FirstBuckets buckets, each next one as many as all before it.
+             */
+            static constexpr usize FirstBuckets = 8;
+            static constexpr usize Segments = 24;
+            static constexpr usize MaxBuckets = FirstBuckets << (Segments - 1);
+
+            /**
+             * @brief The average number of resources per bucket before the buckets double.
+             */
+            static constexpr usize MaxLoad = 2;
+
+            Shard() {
+                m_segments[0].store(new std::atomic<Node *>[FirstBuckets](), std::memory_order_relaxed);
+                m_segments[0].load(std::memory_order_relaxed)[0].store(&m_head, std::memory_order_relaxed);
+            }
+
+            ~Shard() {
+                for (Node *node = m_head.next.load(std::memory_order_relaxed); node;) {
+                    Node *next = node->next.load(std::memory_order_relaxed);
+
+                    delete node;
+                    node = next;
+                }
+                for (Node *node : m_retired)
+                    delete node;
+                for (auto& segment : m_segments)
+                    delete[] segment.load(std::memory_order_relaxed);
+            }
+
+            Shard(const Shard&) = delete;
+            Shard& operator=(const Shard&) = delete;
+
+            usize size() const {
+                return m_count.load(std::memory_order_relaxed);
+            }
+
+            Value find(const ResourceName& name, usize hash) const {
+                const usize key = reverseBits(hash) | 1;
+                Value found;
+
+                // Writers free unlinked entries only while no reader is in the shard
+                m_readers.fetch_add(1, std::memory_order_acquire);
+                for (const Node *node = bucket(hash & (m_buckets.load(std::memory_order_acquire) - 1))
+                                            ->next.load(std::memory_order_acquire);
+                     node && node->key <= key; node = node->next.load(std::memory_order_acquire)) {
+                    if (node->key == key && node->name == name) {
+                        found = node->value;
+                        break;
+                    }
+                }
+                m_readers.fetch_sub(1, std::memory_order_release);
+                return found;
+            }
+
+            bool insert(const ResourceName& name, usize hash, Value value, bool replace) {
+                std::lock_guard lock(m_writer);
+                const usize key = reverseBits(hash) | 1;
+                Node *previous = initializedBucket(hash & (m_buckets.load(std::memory_order_relaxed) - 1));
+                Node *node = previous->next.load(std::memory_order_relaxed);
+
+                for (; node && node->key <= key; previous = node, node = node->next.load(std::memory_order_relaxed)) {
+                    if (node->key == key && node->name == name) {
+                        if (replace == false)
+                            return false;
+
+                        auto *replacement = new Node{ key, name, std::move(value) };
+
+                        replacement->next.store(node->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                        previous->next.store(replacement, std::memory_order_release);
+                        retire(node);
+                        return true;
+                    }
+                }
+
+                auto *added = new Node{ key, name, std::move(value) };
+
+                added->next.store(node, std::memory_order_relaxed);
+                previous->next.store(added, std::memory_order_release);
+
+                const usize buckets = m_buckets.load(std::memory_order_relaxed);
+
+                if (m_count.fetch_add(1, std::memory_order_relaxed) + 1 > buckets * MaxLoad && buckets < MaxBuckets)
+                    m_buckets.store(buckets * 2, std::memory_order_release);
+                return true;
+            }
+
+            bool remove(const ResourceName& name, usize hash) {
+                std::lock_guard lock(m_writer);
+                const usize key = reverseBits(hash) | 1;
+                Node *previous = initializedBucket(hash & (m_buckets.load(std::memory_order_relaxed) - 1));
+
+                for (Node *node = previous->next.load(std::memory_order_relaxed); node && node->key <= key;
+                     previous = node, node = node->next.load(std::memory_order_relaxed)) {
+                    if (node->key == key && node->name == name) {
+                        previous->next.store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+                        m_count.fetch_sub(1, std::memory_order_relaxed);
+                        retire(node);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void clear() {
+                std::lock_guard lock(m_writer);
+                Node *previous = &m_head;
+
+                for (Node *node = m_head.next.load(std::memory_order_relaxed); node;
+                     node = previous->next.load(std::memory_order_relaxed)) {
+                    if ((node->key & 1) == 0) {
+                        previous = node;
+                        continue;
+                    }
+                    previous->next.store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+                    m_retired.push_back(node);
+                }
+                m_count.store(0, std::memory_order_relaxed);
+                reclaim();
+            }
+
+        private:
+            static usize segmentOf(usize bucket) {
+                return bucket < FirstBuckets ? 0 : (usize)std::bit_width(bucket / FirstBuckets);
+            }
+
+            static usize segmentStart(usize segment) {
+                return segment == 0 ? 0 : FirstBuckets << (segment - 1);
+            }
+
+            /**
+             * @brief The bucket a bucket was split from, its index without its highest bit.
+             */
+            static usize parent(usize bucket) {
+                return bucket & ~std::bit_floor(bucket);
+            }
+
+            /**
+             * @brief Finds a bucket for a reader. Buckets are initialized by writers, until
+             *        then the list of its parent holds its entries.
+             */
+            const Node *bucket(usize index) const {
+                for (;;) {
+                    const usize segment = segmentOf(index);
+
+                    if (const auto *buckets = m_segments[segment].load(std::memory_order_acquire)) {
+                        if (const Node *node = buckets[index - segmentStart(segment)].load(std::memory_order_acquire))
+                            return node;
+                    }
+                    index = parent(index);
+                }
+            }
+
+            /**
+             * @brief Finds a bucket for a writer, it is linked into the list if needed.
+             */
+            Node *initializedBucket(usize index) {
+                const usize segment = segmentOf(index);
+                auto *buckets = m_segments[segment].load(std::memory_order_relaxed);
+
+                if (buckets == nullptr) {
+                    buckets = new std::atomic<Node *>[segmentStart(segment) == 0 ? FirstBuckets : segmentStart(segment)]();
+                    m_segments[segment].store(buckets, std::memory_order_release);
+                }
+
+                auto& slot = buckets[index - segmentStart(segment)];
+
+                if (Node *node = slot.load(std::memory_order_relaxed))
+                    return node;
+
+                auto *created = new Node();
+                Node *previous = initializedBucket(parent(index));
+                Node *next = previous->next.load(std::memory_order_relaxed);
+
+                created->key = reverseBits(index);
+                while (next && next->key < created->key) {
+                    previous = next;
+                    next = next->next.load(std::memory_order_relaxed);
+                }
+                created->next.store(next, std::memory_order_relaxed);
+                previous->next.store(created, std::memory_order_release);
+                slot.store(created, std::memory_order_release);
+                return created;
+            }
+
+            void retire(Node *node) {
+                m_retired.push_back(node);
+                reclaim();
+            }
+
+            /**
+             * @brief Frees the unlinked entries if no reader is in the shard. Readers that
+             *        enter after this read-modify-write synchronize with it, they can not
+             *        reach the entries unlinked before.
+             */
+            void reclaim() {
+                if (m_readers.fetch_add(0, std::memory_order_acq_rel) != 0)
+                    return;
+                for (Node *node : m_retired)
+                    delete node;
+                m_retired.clear();
+            }
+
+            Node m_head;                                                   ///< The bucket 0, the start of the list.
+            std::atomic<usize> m_buckets = FirstBuckets;                   ///< The number of buckets, a power of two.
+            std::atomic<usize> m_count = 0;                                ///< The number of resources.
+            std::array<std::atomic<std::atomic<Node *> *>, Segments> m_segments {};
+            mutable std::atomic<usize> m_readers = 0;                      ///< The readers in the shard.
+            std::vector<Node *> m_retired;                                 ///< The unlinked entries not freed yet.
+            std::mutex m_writer;                                           ///< Serializes the writers of the shard.
+        };
+
+        std::array<Shard, Shards> m_shards;
+    };
+
+    // A resource manager shared between threads (jobs, loader workers, the main thread).
+    // Reading a resource never blocks: it walks a lock-free list of its shard of names.
+    // Writing a resource publishes a single entry, writers of the same shard wait for each
+    // other. Resources are returned as shared pointers, a resource replaced or removed
+    // while a thread uses it lives until that thread drops it.
+    class ConcurrentResourceManager {
+    private:
+        /**
+         * @brief The maximum number of resource types.
+         */
+        static constexpr usize MaxTypes = 64;
+
+        /**
+         * @brief The pools of every type, indexed by resourceTypeIndex(), created once.
+         */
+        std::array<std::atomic<ConcurrentResourcePoolBase *>, MaxTypes> m_pools {};
+
+        template<typename T>
+        ConcurrentResourcePool<T> *findPool() const {
+            const usize index = resourceTypeIndex<T>();
+            if (index >= MaxTypes)
+                return nullptr;
+            return static_cast<ConcurrentResourcePool<T> *>(m_pools[index].load(std::memory_order_acquire));
+        }
+
+    public:
+        /**
+         * @brief Default constructor, it will setup every trivial resource.
+         */
+        ConcurrentResourceManager() {
+            addResource("default", Texture());
+        }
+
+        /**
+         * @brief Destructor, no other thread may use the manager anymore.
+         */
+        ~ConcurrentResourceManager() {
+            for (auto& resources : m_pools)
+                delete resources.load();
+        }
+
+        ConcurrentResourceManager(const ConcurrentResourceManager&) = delete;
+        ConcurrentResourceManager& operator=(const ConcurrentResourceManager&) = delete;
+
+        /**
+         * @brief Get the pool of a type, created if needed.
+         * @return The pool.
+         */
+        template<typename T>
+        ConcurrentResourcePool<T>& pool() {
+            const usize index = resourceTypeIndex<T>();
+            if (index >= MaxTypes)
+                throw std::runtime_error("Too many resource types.");
+
+            ConcurrentResourcePoolBase *current = m_pools[index].load(std::memory_order_acquire);
+
+            if (current == nullptr) {
+                auto *created = new ConcurrentResourcePool<T>();
+
+                // Another thread may have created the pool meanwhile
+                if (m_pools[index].compare_exchange_strong(current, created, std::memory_order_acq_rel))
+                    current = created;
+                else
+                    delete created;
+            }
+            return static_cast<ConcurrentResourcePool<T>&>(*current);
+        }
+
+        /**
+         * @brief Add a resource, a resource of the same name is kept.
+         * @param name The name of the resource.
+         * @param resource The resource to add.
+         * @return Whether the resource was added.
+         */
+        template<typename T>
+        bool addResource(const ResourceName& name, T&& resource) {
+            using Type = std::decay_t<T>;
+            return pool<Type>().insert(name, std::make_shared<const Type>(std::forward<T>(resource)), false);
+        }
+
+        /**
+         * @brief Add or replace a resource.
+         * @param name The name of the resource.
+         * @param resource The resource.
+         */
+        template<typename T>
+        void setResource(const ResourceName& name, T&& resource) {
+            using Type = std::decay_t<T>;
+            pool<Type>().insert(name, std::make_shared<const Type>(std::forward<T>(resource)), true);
+        }
+
+        /**
+         * @brief Find a resource, never blocks.
+         * @param name The name of the resource.
+         * @return The resource, null if there is none.
+         */
+        template<typename T>
+        std::shared_ptr<const T> findResource(const ResourceName& name) const {
+            const auto *resources = findPool<T>();
+            return resources ? resources->find(name) : nullptr;
+        }
+
+        /**
+         * @brief Get a resource, never blocks.
+         * @param name The name of the resource.
+         * @return The resource.
+         */
+        template<typename T>
+        std::shared_ptr<const T> getResource(const ResourceName& name) const {
+            const auto *resources = findPool<T>();
+            if (resources == nullptr)
+                throw std::runtime_error("Resource type not found.");
+            auto resource = resources->find(name);
+            if (resource == nullptr)
+                throw std::runtime_error("Resource not found.");
+            return resource;
+        }
+
+        /**
+         * @brief Is there a resource of this name?
+         * @param name The name of the resource.
+         * @return Whether the resource exists.
+         */
+        template<typename T>
+        bool hasResource(const ResourceName& name) const {
+            return findResource<T>(name) != nullptr;
+        }
+
+        /**
+         * @brief Remove a resource.
+         * @param name The name of the resource.
+         * @return Whether the resource existed.
+         */
+        template<typename T>
+        bool removeResource(const ResourceName& name) {
+            auto *resources = findPool<T>();
+            return resources && resources->remove(name);
+        }
+
+        /**
+         * @brief Clear the registry.
+         */
+        void clear() {
+            for (auto& resources : m_pools) {
+                if (auto *current = resources.load(std::memory_order_acquire))
+                    current->clear();
+            }
+        }
+    };
+}
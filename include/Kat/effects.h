@@ -0,0 +1,58 @@
+#pragma once
+
+#include <SFML/Graphics/Color.hpp>
+#include <SFML/Graphics/Shader.hpp>
+
+#include "./meta.h"
+
+namespace kat {
+
+    /**
+     * @brief The effects of the sprite uber shader, at most 8.
+     */
+    enum class SpriteEffect : u8 {
+        None = 0,  ///< Modulated by the color of the effect, the strength is the opacity.
+        Tint,      ///< Multiplied by the color.
+        Flash,     ///< Blended towards the color (hit flashes).
+        Dissolve,  ///< Pixels are discarded by a noise threshold, the edge glows with the color.
+        Outline,   ///< Transparent pixels next to opaque ones take the color.
+        Grayscale  ///< Desaturated, then multiplied by the color.
+    };
+
+    /**
+     * @brief The strength of an effect, from 0 to 1.
+     */
+    using EffectStrength = float;
+
+    /**
+     * @brief An effect and its parameters.
+     */
+    struct EffectParams {
+        SpriteEffect effect = SpriteEffect::None; ///< The effect.
+        EffectStrength strength = 1.0f;           ///< The strength of the effect.
+        sf::Color color = sf::Color::White;       ///< The color used by the effect.
+    };
+
+    /**
+     * @brief Packs an effect in a texel of the effect texture of a run (see ShapeBatch):
+     *        the rgb channels hold the color of the effect, the alpha channel the effect
+     *        (3 bits) and its strength (5 bits).
+     *        With SpriteEffect::None the strength is an opacity on top of the sprite's own.
+     *
+     * @param params The effect.
+     * @return sf::Color The vertex color.
+     */
+    sf::Color encodeEffect(const EffectParams& params);
+
+    /**
+     * @brief Gets the sprite uber shader, that decodes the effect of each vertex from
+     *        the effect texture of its run (see encodeEffect()), so sprites with different
+     *        effects can share a draw call. The result of every effect is modulated by the
+     *        vertex color, the color of the sprite.
+     *        The shader is loaded on first use, a gl context has to be active, it needs
+     *        glsl 1.30 (vertex ids and texel fetches).
+     *
+     * @return sf::Shader* The shader, null if shaders are not available.
+     */
+    sf::Shader* uberShader();
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <SFML/Graphics/Drawable.hpp>
+#include <SFML/Graphics/Shader.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/Graphics/VertexBuffer.hpp>
+
+#include "./components/sprite.h"
+
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief Draws many sprites sharing a texture, the quads are expanded on the gpu.
+     *
+     * Every sprite is written as 12 floats (48 bytes): position, rotation, color,
+     * scale, origin and texture rect. The floats are stored bit for bit in the texels
+     * of an RGBA8 data texture that is uploaded once per frame, and a vertex shader
+     * rebuilds the transformed quads from a static vertex template that only holds
+     * (corner, sprite index) pairs.
+     * The cpu never computes a transformed vertex, which makes it suited to
+     * hundreds of thousands of moving sprites.
+     *
+     * Requires GLSL 1.30 (OpenGL 3.0) and a little endian cpu, check isAvailable().
+     *
+     *      GpuSpriteBatch batch;
+     *      batch.setTexture(texture).reserve(100000);
+     *      for (const auto& bullet : bullets)
+     *          batch.add(bullet.position, bullet.angle, Scale(1, 1), Position(4, 4), frame, Color::White);
+     *      window.draw(batch);
+     *      batch.clear();
+     */
+    class GpuSpriteBatch : public sf::Drawable {
+    public:
+        /**
+         * @brief The number of floats written per sprite.
+         */
+        static constexpr usize FloatsPerSprite = 12;
+
+        /**
+         * @brief The width in texels of the data texture.
+         */
+        static constexpr u32 DataWidth = 1024;
+
+        /**
+         * @brief Checks whether the gpu path can be used on this machine.
+         *
+         * @return true If shaders and vertex buffers are available.
+         * @return false Otherwise.
+         */
+        static bool isAvailable();
+
+        /**
+         * @brief Sets the texture shared by every sprite of the batch.
+         *
+         * @param texture The texture.
+         * @return GpuSpriteBatch& Reference to self.
+         */
+        GpuSpriteBatch& setTexture(const Texture& texture);
+
+        /**
+         * @brief Reserves room for a number of sprites, this is the only
+         *        call that rebuilds the vertex template.
+         *
+         * @param count The number of sprites.
+         * @return GpuSpriteBatch& Reference to self.
+         */
+        GpuSpriteBatch& reserve(usize count);
+
+        /**
+         * @brief Adds a sprite to the batch.
+         *
+         * @param position The position of the sprite.
+         * @param rotation The rotation of the sprite.
+         * @param scale The scale of the sprite.
+         * @param origin The origin of the sprite.
+         * @param rect The texture rect of the sprite.
+         * @param color The color of the sprite.
+         * @return GpuSpriteBatch& Reference to self.
+         */
+        GpuSpriteBatch& add(const Position& position, const Angle& rotation, const Scale& scale,
+                            const Position& origin, const Frame& rect, const Color& color);
+
+        /**
+         * @brief Adds a sprite to the batch, the texture of the sprite is ignored.
+         *
+         * @param sprite The sprite.
+         * @return GpuSpriteBatch& Reference to self.
+         */
+        GpuSpriteBatch& add(const Sprite& sprite);
+
+        /**
+         * @brief Removes every sprite, the memory is kept.
+         *
+         * @return GpuSpriteBatch& Reference to self.
+         */
+        GpuSpriteBatch& clear();
+
+        /**
+         * @brief Gets the number of sprites of the batch.
+         *
+         * @return usize The number of sprites.
+         */
+        usize size() const;
+
+        GpuSpriteBatch();
+        ~GpuSpriteBatch() = default;
+
+    protected:
+        void draw(sf::RenderTarget& target, const sf::RenderStates& states) const override;
+
+    private:
+        Texture m_texture;
+        std::vector<f32> m_data; ///< FloatsPerSprite floats per sprite, bit copied into the data texture.
+        usize m_count = 0;
+        usize m_capacity = 0;
+        sf::VertexBuffer m_template;
+        mutable sf::Texture m_data_texture;
+        mutable bool m_dirty = false;
+    };
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <SFML/Graphics/Image.hpp>
+
+#include "./components/sprite.h"
+
+#include <array>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief The instruction sets the image kernels can use.
+     */
+    enum class SimdLevel : u8 {
+        Scalar,
+        SSE2,
+        SSSE3,
+        AVX2
+    };
+
+    /**
+     * @brief Gets the instruction set used by the image kernels,
+     *        the best one of the cpu unless overridden.
+     *
+     * @return SimdLevel The instruction set.
+     */
+    SimdLevel simdLevel();
+
+    /**
+     * @brief Overrides the instruction set used by the image kernels (comparisons, tests).
+     *
+     * @param level The instruction set, lowered to what the cpu supports.
+     * @return SimdLevel The instruction set now used.
+     */
+    SimdLevel setSimdLevel(SimdLevel level);
+
+    /**
+     * @brief A channel order: the channel of the source read by each channel of the result.
+     *        {2, 1, 0, 3} swaps rgba and bgra.
+     */
+    using Swizzle = std::array<u8, 4>;
+
+    /**
+     * @brief The filters used to halve an image.
+     */
+    enum class DownscaleFilter {
+        Box,     ///< The average of each 2x2 block.
+        Gaussian ///< A 4x4 binomial filter (1 3 3 1), softer and without aliasing.
+    };
+
+    /**
+     * @brief Premultiplies the colors of rgba pixels by their alpha.
+     *
+     * @param pixels The pixels.
+     * @param count The number of pixels.
+     */
+    void premultiply(Pixels pixels, usize count);
+
+    /**
+     * @brief Divides the colors of premultiplied rgba pixels by their alpha.
+     *
+     * @param pixels The pixels.
+     * @param count The number of pixels.
+     */
+    void unpremultiply(Pixels pixels, usize count);
+
+    /**
+     * @brief Makes the pixels of a color fully transparent.
+     *
+     * @param pixels The rgba pixels.
+     * @param count The number of pixels.
+     * @param key The color, its alpha is ignored.
+     */
+    void colorKey(Pixels pixels, usize count, const Color& key);
+
+    /**
+     * @brief Reorders the channels of pixels.
+     *
+     * @param pixels The pixels.
+     * @param count The number of pixels.
+     * @param order The channel order.
+     */
+    void swizzle(Pixels pixels, usize count, const Swizzle& order);
+
+    /**
+     * @brief A cpu-side rgba image, processed by vectorized kernels
+     *        (sse2, ssse3 or avx2, chosen at runtime). Large images are split across threads.
+     *        Its pixels can be given to Texture::update as is.
+     */
+    class Image {
+    public:
+        /**
+         * @brief The number of pixels above which kernels are split across threads.
+         */
+        static constexpr usize ParallelThreshold = 1 << 18;
+
+        /**
+         * @brief Creates an image filled with a color.
+         *
+         * @param size The size of the image.
+         * @param color The color.
+         * @return Image& Reference to self.
+         */
+        Image& create(const TextureSize& size, const Color& color = Color(0, 0, 0, 0));
+
+        /**
+         * @brief Copies rgba pixels.
+         *
+         * @param pixels The pixels, row by row.
+         * @param size The size of the image.
+         * @return Image& Reference to self.
+         */
+        Image& load(const u8 *pixels, const TextureSize& size);
+
+        /**
+         * @brief Copies a sfml image.
+         *
+         * @param image The image.
+         * @return Image& Reference to self.
+         */
+        Image& load(const sf::Image& image);
+
+        /**
+         * @brief Gets the size of the image.
+         *
+         * @return TextureSize The size.
+         */
+        TextureSize size() const;
+
+        /**
+         * @brief Gets the pixels of the image.
+         *
+         * @return Pixels The rgba pixels, row by row.
+         */
+        Pixels pixels();
+
+        /**
+         * @brief Gets the pixels of the image. (const)
+         *
+         * @return const u8* The rgba pixels, row by row.
+         */
+        const u8 *pixels() const;
+
+        /**
+         * @brief Premultiplies the colors by the alpha.
+         * @return Image& Reference to self.
+         */
+        Image& premultiply();
+
+        /**
+         * @brief Divides the premultiplied colors by the alpha.
+         * @return Image& Reference to self.
+         */
+        Image& unpremultiply();
+
+        /**
+         * @brief Makes the pixels of a color fully transparent.
+         *
+         * @param key The color, its alpha is ignored.
+         * @return Image& Reference to self.
+         */
+        Image& colorKey(const Color& key);
+
+        /**
+         * @brief Reorders the channels.
+         *
+         * @param order The channel order.
+         * @return Image& Reference to self.
+         */
+        Image& swizzle(const Swizzle& order);
+
+        /**
+         * @brief Flips the image left to right.
+         * @return Image& Reference to self.
+         */
+        Image& flipHorizontally();
+
+        /**
+         * @brief Flips the image upside down.
+         * @return Image& Reference to self.
+         */
+        Image& flipVertically();
+
+        /**
+         * @brief Halves the image, odd rows and columns are dropped by the box filter.
+         *
+         * @param filter The filter.
+         * @return Image The image, half the size (at least a pixel).
+         */
+        Image halve(DownscaleFilter filter = DownscaleFilter::Box) const;
+
+        /**
+         * @brief Halves the image until it fits a size, for thumbnails and mipmaps.
+         *
+         * @param max_size The size the image has to fit.
+         * @param filter The filter.
+         * @return Image The image.
+         */
+        Image downscale(const TextureSize& max_size, DownscaleFilter filter = DownscaleFilter::Box) const;
+
+        /**
+         * @brief Copies the image into a sfml image.
+         *
+         * @return sf::Image The image.
+         */
+        sf::Image toSfml() const;
+
+        /**
+         * @brief Creates a texture from the image.
+         *
+         * @return Texture The texture, null if it could not be created.
+         */
+        Texture toTexture() const;
+
+        Image() = default;
+        ~Image() = default;
+
+    private:
+        TextureSize m_size;
+        std::vector<u8> m_pixels;
+    };
+}
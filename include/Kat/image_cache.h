@@ -0,0 +1,173 @@
+#pragma once
+
+#include <SFML/Graphics/Image.hpp>
+
+#include "./mapped_file.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace kat {
+
+    /**
+     * @brief A decoded image found in the image cache.
+     */
+    struct CachedImage {
+        MappedFile file;           ///< The mapping of the cache file.
+        std::span<const u8> image; ///< A RawImageHeader followed by rgba pixels, in the mapping.
+    };
+
+    /**
+     * @brief An on-disk cache of decoded images, for builds that load loose files
+     *        instead of paks (development, mods).
+     *
+     *        Images are keyed by their path, modification time and size: a cache hit
+     *        maps the decoded pixels instead of decoding the file again, a miss decodes
+     *        the file and writes its pixels to the cache on a background thread.
+     *        The cache files of older versions of a file are removed by that write.
+     *        Texture::load(filename) uses the cache once it has a directory.
+     */
+    class ImageCache {
+    public:
+        /**
+         * @brief Sets the directory of the cache files, creating it if needed.
+         *
+         * @param directory The directory, empty to disable the cache.
+         * @return ImageCache& Reference to self.
+         */
+        ImageCache& setDirectory(const std::string& directory);
+
+        /**
+         * @brief Gets the directory of the cache files.
+         *
+         * @return const std::string& The directory, empty when the cache is disabled.
+         */
+        const std::string& getDirectory() const;
+
+        /**
+         * @brief Is the cache enabled?
+         *
+         * @return true The cache has a directory.
+         * @return false The cache is disabled.
+         */
+        bool isEnabled() const;
+
+        /**
+         * @brief Finds the decoded pixels of an image file.
+         *
+         * @param filename The filename of the image.
+         * @return std::optional<CachedImage> The decoded image, empty if it is not cached
+         *         or the file changed since it was cached.
+         */
+        std::optional<CachedImage> find(const std::string& filename);
+
+        /**
+         * @brief Writes the decoded pixels of an image file to the cache on the background thread.
+         *
+         * @param filename The filename of the image.
+         * @param image The decoded image.
+         */
+        void store(const std::string& filename, sf::Image image);
+
+        /**
+         * @brief Blocks until every pending write is done.
+         */
+        void flush();
+
+        /**
+         * @brief Gets the number of images found in the cache.
+         *
+         * @return usize The number of hits.
+         */
+        usize hits() const;
+
+        /**
+         * @brief Gets the number of images that were not in the cache.
+         *
+         * @return usize The number of misses.
+         */
+        usize misses() const;
+
+        /**
+         * @brief Returns a reference to the singleton instance of the ImageCache.
+         * @return ImageCache& The image cache.
+         */
+        static ImageCache& instance();
+
+        /**
+         * @brief Destroys the singleton instance, after the pending writes are done.
+         */
+        static void destroy();
+
+        ImageCache() = default;
+        ~ImageCache();
+
+        ImageCache(const ImageCache&) = delete;
+        ImageCache& operator=(const ImageCache&) = delete;
+
+    private:
+        /**
+         * @brief The header of a cache file, followed by the path of the image file
+         *        and the raw image.
+         */
+        struct FileHeader {
+            char magic[4] = { 'K', 'I', 'M', 'C' };
+            u32 version = 2;
+            i64 time = 0;       ///< The modification time of the image file.
+            u64 size = 0;       ///< The size of the image file.
+            u32 path_size = 0;  ///< The size of the path of the image file.
+            u32 reserved = 0;
+        };
+
+        /**
+         * @brief The version of an image file a cache file was written from, checked on reads.
+         */
+        struct Source {
+            std::string path; ///< The canonical path.
+            i64 time = 0;     ///< The modification time.
+            u64 size = 0;     ///< The size.
+        };
+
+        /**
+         * @brief A write waiting for the background thread.
+         */
+        struct Write {
+            Source source;
+            sf::Image image;
+        };
+
+        /**
+         * @brief Gets the version of an image file.
+         * @return std::optional<Source> The version, empty if the file does not exist.
+         */
+        static std::optional<Source> source(const std::string& filename);
+
+        /**
+         * @brief Gets the prefix of the names of the cache files of an image file, every
+         *        version of the file shares it.
+         */
+        static std::string prefix(const Source& source);
+
+        std::string path(const Source& source) const;
+
+        void work();
+
+        std::string m_directory;
+        std::thread m_thread; ///< Started on the first write.
+        mutable std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_idle;
+        std::deque<Write> m_writes;
+        bool m_writing = false;
+        bool m_stop = false;
+        std::atomic<usize> m_hits = 0;
+        std::atomic<usize> m_misses = 0;
+
+        static ImageCache *m_Instance; ///< The singleton instance of the ImageCache.
+    };
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <SFML/Graphics/Image.hpp>
+
+#include "./components/texture.h"
+
+#include <span>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief The image formats the asset pipeline can bake images into.
+     *        They skip the png decoder of sfml, which is single threaded.
+     */
+    enum class ImageFormat : u8 {
+        Encoded,  ///< Any format sfml decodes (png, jpg...), the bytes of the source file.
+        Raw,      ///< A RawImageHeader followed by rgba pixels, uploaded as is.
+        Qoi,      ///< A standard qoi image ("qoif"), decoded sequentially.
+        QoiBands  ///< A QoiBandsHeader followed by bands of rows encoded as qoi, decoded in parallel.
+    };
+
+    /**
+     * @brief The header of an image split into bands of rows, each band is a qoi stream
+     *        (without header nor end marker) that starts from a fresh qoi state.
+     *        The header is followed by the end offset of each band, relative to the
+     *        end of the offsets, then by the bands.
+     */
+    struct QoiBandsHeader {
+        char magic[4] = { 'K', 'Q', 'O', 'I' };
+        u32 width = 0;
+        u32 height = 0;
+        u32 band_rows = 0; ///< The number of rows of a band, the last one may be shorter.
+    };
+
+    static_assert(sizeof(QoiBandsHeader) == 16);
+
+    /**
+     * @brief The number of rows of the bands of encodeImage(), each band costs an offset
+     *        and a fresh qoi state, which is negligible at 64 rows.
+     */
+    constexpr u32 QoiBandRows = 64;
+
+    /**
+     * @brief Detects the format of an image from its first bytes.
+     *
+     * @param data The bytes of the image.
+     * @return ImageFormat The format, Encoded when it is not one of the fast formats.
+     */
+    ImageFormat imageFormat(std::span<const u8> data);
+
+    /**
+     * @brief Encodes an image.
+     *
+     * @param image The image.
+     * @param format The format, Encoded images are baked as their source file.
+     * @return std::vector<u8> The encoded image, empty for Encoded.
+     */
+    std::vector<u8> encodeImage(const sf::Image& image, ImageFormat format);
+
+    /**
+     * @brief Encodes rgba pixels as a standard qoi image.
+     *
+     * @param pixels The pixels, row by row.
+     * @param size The size of the image.
+     * @return std::vector<u8> The qoi image.
+     */
+    std::vector<u8> encodeQoi(const u8 *pixels, const TextureSize& size);
+
+    /**
+     * @brief Encodes rgba pixels as bands of qoi rows, see QoiBandsHeader.
+     *
+     * @param pixels The pixels, row by row.
+     * @param size The size of the image.
+     * @param band_rows The number of rows of a band.
+     * @return std::vector<u8> The encoded image.
+     */
+    std::vector<u8> encodeQoiBands(const u8 *pixels, const TextureSize& size, u32 band_rows = QoiBandRows);
+
+    /**
+     * @brief Decodes an image of one of the fast formats to rgba pixels.
+     *        Bands of large images are decoded across threads (see Image::ParallelThreshold).
+     *
+     * @param data The bytes of the image.
+     * @param pixels The pixels, resized to the image.
+     * @param size The size of the image.
+     * @return bool Whether the data is a valid Raw, Qoi or QoiBands image.
+     */
+    bool decodeImage(std::span<const u8> data, std::vector<u8>& pixels, TextureSize& size);
+
+    /**
+     * @brief Decodes an image of any format, the fast formats are decoded by
+     *        decodeImage(), other data by sfml.
+     *
+     * @param data The bytes of the image.
+     * @param image The image.
+     * @return bool Whether the image was decoded.
+     */
+    bool decodeImage(std::span<const u8> data, sf::Image& image);
+}
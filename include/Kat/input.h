@@ -118,6 +118,13 @@ public:
      */
     static void update(Window& window);
 
+    /**
+     * @brief Waits for the window's frame scheduler to latch the frame, then updates the InputManager.
+     *        Input is sampled as late as possible so it is fresh when the frame is displayed.
+     * @param window The window to latch and to use as a reference for mouse position.
+     */
+    static void updateLatched(Window& window);
+
     /**
      * @brief Advances the InputManager to the next frame.
      */
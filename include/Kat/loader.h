@@ -0,0 +1,381 @@
+#pragma once
+
+#include "./resource.h"
+#include "./uploader.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief The priority of a load, higher priorities are loaded first.
+     */
+    using LoadPriority = int;
+
+    /**
+     * @brief The time the main thread may spend finishing loads per frame.
+     */
+    using LoadBudget = std::chrono::microseconds;
+
+    /**
+     * @brief A progress callback, called on the main thread with the number of
+     *        finished loads and the number of loads.
+     */
+    using LoadProgress = std::function<void(usize finished, usize total)>;
+
+    /**
+     * @brief The state of a load.
+     */
+    enum class LoadState : u8 {
+        Queued,   ///< Waiting for a worker, or for the bundles it depends on.
+        Loading,  ///< Read and decoded by a worker.
+        Decoded,  ///< Waiting for the main thread to finish it (gpu uploads).
+        Ready,    ///< Stored in the resource manager.
+        Failed,   ///< The load threw, or a bundle it depends on failed.
+        Cancelled ///< Cancelled before it was ready.
+    };
+
+    /**
+     * @brief The shared state of a bundle.
+     */
+    struct BundleState;
+
+    class PreloadRecorder;
+    class VirtualFileSystem;
+
+    /**
+     * @brief A single load, shared by the loader and its handles.
+     */
+    struct LoadTask {
+        ResourceName name;
+        LoadPriority priority = 0;
+        std::function<Resource()> decode;                         ///< Run by a worker.
+        std::function<void(Resource&)> finish;                    ///< Run by the main thread, may be empty.
+        std::function<void(ResourceManager&, Resource&)> store;   ///< Adds the result to the resource manager.
+        std::shared_ptr<BundleState> bundle;                      ///< The bundle of the load, may be null.
+        std::atomic<LoadState> state = LoadState::Queued;
+        Resource result;
+        std::string error;
+    };
+
+    /**
+     * @brief A handle to a load.
+     */
+    class LoadHandle {
+    public:
+        /**
+         * @brief Gets the state of the load.
+         * @return LoadState The state.
+         */
+        LoadState state() const;
+
+        /**
+         * @brief Is the load ready?
+         * @return true The resource is in the resource manager.
+         * @return false The load is pending, failed or was cancelled.
+         */
+        bool isReady() const;
+
+        /**
+         * @brief Is the load over?
+         * @return true The load is ready, failed or was cancelled.
+         * @return false The load is pending.
+         */
+        bool isDone() const;
+
+        /**
+         * @brief Cancels the load, a resource already ready is kept.
+         */
+        void cancel();
+
+        /**
+         * @brief Gets the name of the resource.
+         * @return const ResourceName& The name.
+         */
+        const ResourceName& name() const;
+
+        /**
+         * @brief Gets the reason of a failure.
+         * @return const std::string& The error, empty unless the load failed.
+         */
+        const std::string& error() const;
+
+        /**
+         * @brief Gets the loaded resource.
+         * @return const T& The resource, the load has to be ready.
+         */
+        template<typename T>
+        const T& get() const {
+            if (isReady() == false)
+                throw std::runtime_error("Resource not ready.");
+            return std::any_cast<const T&>(m_task->result);
+        }
+
+        LoadHandle() = default;
+        LoadHandle(const std::shared_ptr<LoadTask>& task);
+
+    private:
+        std::shared_ptr<LoadTask> m_task;
+    };
+
+    /**
+     * @brief A group of loads (a level, a tileset...), that may wait for other bundles.
+     */
+    class LoadBundle {
+    public:
+        /**
+         * @brief Gets the number of finished loads of the bundle.
+         * @return usize The number of loads ready, failed or cancelled.
+         */
+        usize finished() const;
+
+        /**
+         * @brief Gets the number of loads of the bundle.
+         * @return usize The number of loads.
+         */
+        usize size() const;
+
+        /**
+         * @brief Gets the progress of the bundle.
+         * @return float The progress, from 0 to 1.
+         */
+        float progress() const;
+
+        /**
+         * @brief Is every load of the bundle ready?
+         * @return true The bundle and the bundles it depends on are ready.
+         * @return false Some loads are pending or failed.
+         */
+        bool isReady() const;
+
+        /**
+         * @brief Did a load of the bundle fail or was it cancelled?
+         * @return true A load failed.
+         * @return false No load failed so far.
+         */
+        bool hasFailed() const;
+
+        /**
+         * @brief Cancels every pending load of the bundle.
+         */
+        void cancel();
+
+        /**
+         * @brief Sets the callback called when a load of the bundle is over.
+         * @param callback The callback.
+         * @return LoadBundle& Reference to self.
+         */
+        LoadBundle& onProgress(const LoadProgress& callback);
+
+        LoadBundle() = default;
+        LoadBundle(const std::shared_ptr<BundleState>& state);
+
+        const std::shared_ptr<BundleState>& state() const;
+
+    private:
+        std::shared_ptr<BundleState> m_state;
+    };
+
+    /**
+     * @brief Loads resources on a pool of worker threads.
+     *
+     *        Workers read and decode resources, highest priority first. Work that needs
+     *        the main thread (gpu uploads) and the insertion in the resource manager
+     *        are done by pump(), within a time budget per frame.
+     *        Loads of a bundle start once the bundles it depends on are ready.
+     */
+    class ResourceLoader {
+    public:
+        /**
+         * @brief Constructs a new Resource Loader object.
+         *
+         * @param resources The resource manager the resources are added to.
+         * @param threads The number of workers, 0 for one less than the number of cores.
+         */
+        ResourceLoader(ResourceManager& resources, usize threads = 0);
+
+        /**
+         * @brief Cancels the pending loads and joins the workers.
+         */
+        ~ResourceLoader();
+
+        ResourceLoader(const ResourceLoader&) = delete;
+        ResourceLoader& operator=(const ResourceLoader&) = delete;
+
+        /**
+         * @brief Creates a bundle.
+         *
+         * @param dependencies The bundles that have to be ready before its loads start.
+         * @return LoadBundle The bundle.
+         */
+        LoadBundle bundle(const std::vector<LoadBundle>& dependencies = {});
+
+        /**
+         * @brief Loads a resource.
+         *
+         * @param name The name of the resource.
+         * @param decode Loads the resource on a worker, throws on failure. It is recorded as
+         *               the loader of the resource, reloading it once evicted.
+         * @param priority The priority of the load.
+         * @param bundle The bundle of the load, may be null.
+         * @return LoadHandle The handle of the load.
+         */
+        template<typename T>
+        LoadHandle load(const ResourceName& name, std::function<T()> decode,
+                        LoadPriority priority = 0, const LoadBundle* bundle = nullptr) {
+            auto task = std::make_shared<LoadTask>();
+
+            task->name = name;
+            task->priority = priority;
+            task->decode = [decode]() { return Resource(decode()); };
+            task->store = [name, decode](ResourceManager& resources, Resource& result) {
+                const auto handle = resources.addResource<T>(name, std::any_cast<const T&>(result));
+
+                // The resource is reloaded on the main thread if it gets evicted
+                resources.setLoader<T>(handle, decode);
+            };
+            return submit(task, bundle);
+        }
+
+        /**
+         * @brief Loads a resource in two steps.
+         *
+         * @param name The name of the resource.
+         * @param decode Loads the resource on a worker (an image), throws on failure.
+         *               Together with finish, it reloads the resource once evicted.
+         * @param finish Turns the decoded resource into the resource on the main thread
+         *               (a texture), throws on failure.
+         * @param priority The priority of the load.
+         * @param bundle The bundle of the load, may be null.
+         * @return LoadHandle The handle of the load.
+         */
+        template<typename Decoded, typename T>
+        LoadHandle load(const ResourceName& name, std::function<Decoded()> decode,
+                        std::function<T(Decoded&&)> finish,
+                        LoadPriority priority = 0, const LoadBundle* bundle = nullptr) {
+            auto task = std::make_shared<LoadTask>();
+
+            task->name = name;
+            task->priority = priority;
+            task->decode = [decode]() { return Resource(decode()); };
+            task->finish = [finish](Resource& result) {
+                result = Resource(finish(std::move(std::any_cast<Decoded&>(result))));
+            };
+            task->store = [name, decode, finish](ResourceManager& resources, Resource& result) {
+                const auto handle = resources.addResource<T>(name, std::any_cast<const T&>(result));
+
+                resources.setLoader<T>(handle, [decode, finish]() { return finish(decode()); });
+            };
+            return submit(task, bundle);
+        }
+
+        /**
+         * @brief Loads a texture: the image is decoded by a worker, the texture is
+         *        created by the main thread, or by the uploader if there is one.
+         *
+         * @param name The name of the texture.
+         * @param filename The filename of the image.
+         * @param priority The priority of the load.
+         * @param bundle The bundle of the load, may be null.
+         * @return LoadHandle The handle of the load.
+         */
+        LoadHandle loadTexture(const ResourceName& name, const std::string& filename,
+                               LoadPriority priority = 0, const LoadBundle* bundle = nullptr);
+
+        /**
+         * @brief Finishes decoded loads on the main thread, highest priority first,
+         *        until the budget is spent. At least one load is finished per call.
+         *
+         * @param budget The time that may be spent, none to finish every decoded load.
+         * @return usize The number of loads finished.
+         */
+        usize pump(std::optional<LoadBudget> budget = LoadBudget(2000));
+
+        /**
+         * @brief Finishes a load, blocking the main thread.
+         * @param handle The load.
+         */
+        void wait(const LoadHandle& handle);
+
+        /**
+         * @brief Finishes every load of a bundle, blocking the main thread.
+         * @param bundle The bundle.
+         */
+        void wait(const LoadBundle& bundle);
+
+        /**
+         * @brief Sets the callback called when any load is over.
+         * @param callback The callback.
+         * @return ResourceLoader& Reference to self.
+         */
+        ResourceLoader& onProgress(const LoadProgress& callback);
+
+        /**
+         * @brief Sets the uploader creating the textures of the next loads, the worker
+         *        waits for the upload so the main thread only stores the texture.
+         * @param uploader The uploader, null to create textures on the main thread.
+         * @return ResourceLoader& Reference to self.
+         */
+        ResourceLoader& setUploader(TextureUploader* uploader);
+
+        /**
+         * @brief Sets the recorder the sources of the next texture loads are reported to.
+         * @param recorder The recorder, null to stop reporting.
+         * @return ResourceLoader& Reference to self.
+         */
+        ResourceLoader& setRecorder(PreloadRecorder* recorder);
+
+        /**
+         * @brief Sets the file system the images of the next texture loads are read from,
+         *        they are decoded straight from the buffers of the reads.
+         * @param files The file system, null to read the files directly.
+         * @return ResourceLoader& Reference to self.
+         */
+        ResourceLoader& setFileSystem(VirtualFileSystem* files);
+
+        /**
+         * @brief Gets the number of loads that are not over.
+         * @return usize The number of loads.
+         */
+        usize pending() const;
+
+    private:
+        LoadHandle submit(const std::shared_ptr<LoadTask>& task, const LoadBundle* bundle);
+
+        void work();
+
+        /**
+         * @brief Takes the queued load with the highest priority that can start.
+         *        The mutex has to be locked.
+         */
+        std::shared_ptr<LoadTask> next();
+
+        void complete(LoadTask& task);
+
+        ResourceManager& m_resources;
+        std::vector<std::thread> m_workers;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_wake;       ///< Wakes the workers.
+        std::condition_variable m_decoded_cv; ///< Wakes the main thread waiting for a load.
+        std::vector<std::shared_ptr<LoadTask>> m_queue;
+        std::vector<std::shared_ptr<LoadTask>> m_decoded;
+        bool m_stop = false;
+
+        usize m_total = 0;    ///< Loads submitted since the loader was last idle.
+        usize m_finished = 0; ///< Loads over since the loader was last idle.
+        LoadProgress m_on_progress;
+        TextureUploader* m_uploader = nullptr;
+        PreloadRecorder* m_recorder = nullptr;
+        VirtualFileSystem* m_files = nullptr;
+    };
+}
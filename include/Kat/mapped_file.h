@@ -0,0 +1,57 @@
+#pragma once
+
+#include "./meta.h"
+
+#include <span>
+#include <string>
+
+namespace kat {
+
+    /**
+     * @brief A read-only memory mapping of a whole file.
+     */
+    class MappedFile {
+    public:
+        /**
+         * @brief Maps a file, unmapping the previous one.
+         *
+         * @param filename The filename of the file.
+         * @return bool Whether the file is mapped.
+         */
+        bool open(const std::string& filename);
+
+        /**
+         * @brief Unmaps the file.
+         */
+        void close();
+
+        /**
+         * @brief Is a file mapped?
+         *
+         * @return true A file is mapped.
+         * @return false No file is mapped.
+         */
+        bool isOpen() const;
+
+        /**
+         * @brief Gets the mapped bytes.
+         *
+         * @return std::span<const u8> The bytes of the file, valid until the file is unmapped.
+         */
+        std::span<const u8> bytes() const;
+
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+    private:
+        const u8 *m_data = nullptr;
+        usize m_size = 0;
+        bool m_open = false; ///< Empty files are open without any mapping.
+    };
+}
@@ -0,0 +1,294 @@
+#pragma once
+
+#include "./meta.h"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief Maps names to values in a radix trie, for queries by prefix.
+     *
+     *        Names sharing a prefix share the nodes of the prefix, and chains of nodes
+     *        with a single child are merged, so there are at most twice as many nodes as
+     *        names. Finding the names under a prefix walks the prefix, then the matching
+     *        names only. Path-like names ("level3/enemies/bat") make namespaces: query
+     *        "level3/" with the separator to exclude "level30/...".
+     */
+    template<typename Value>
+    class NameIndex {
+    public:
+        /**
+         * @brief Adds a name.
+         * @param name The name.
+         * @param value The value of the name.
+         * @return bool Whether the name was added, an existing name is kept as is.
+         */
+        bool insert(std::string_view name, const Value& value) {
+            Node *node = &m_root;
+            usize position = 0;
+
+            while (true) {
+                if (position == name.size()) {
+                    if (node->value)
+                        return false;
+                    node->value = value;
+                    ++m_size;
+                    return true;
+                }
+
+                auto *slot = child(*node, name[position]);
+
+                if (slot == nullptr) {
+                    auto leaf = std::make_unique<Node>();
+
+                    leaf->label = std::string(name.substr(position));
+                    leaf->value = value;
+                    node->children.push_back(std::move(leaf));
+                    std::sort(node->children.begin(), node->children.end(),
+                              [](const auto& a, const auto& b) { return a->label[0] < b->label[0]; });
+                    ++m_size;
+                    return true;
+                }
+
+                Node& next = **slot;
+                const usize common = commonPrefix(next.label, name.substr(position));
+
+                // Splits the edge where the names diverge
+                if (common < next.label.size()) {
+                    auto middle = std::make_unique<Node>();
+
+                    middle->label = next.label.substr(0, common);
+                    next.label.erase(0, common);
+                    middle->children.push_back(std::move(*slot));
+                    *slot = std::move(middle);
+                }
+                node = slot->get();
+                position += common;
+            }
+        }
+
+        /**
+         * @brief Removes a name.
+         * @param name The name.
+         * @return bool Whether the name existed.
+         */
+        bool erase(std::string_view name) {
+            std::vector<Node *> path = { &m_root };
+            usize position = 0;
+
+            while (position < name.size()) {
+                auto *slot = child(*path.back(), name[position]);
+
+                if (slot == nullptr || name.substr(position).starts_with((*slot)->label) == false)
+                    return false;
+                position += (*slot)->label.size();
+                path.push_back(slot->get());
+            }
+            if (!path.back()->value)
+                return false;
+            path.back()->value.reset();
+            --m_size;
+            prune(path);
+            return true;
+        }
+
+        /**
+         * @brief Finds the value of a name.
+         * @param name The name.
+         * @return const Value* The value, null if there is no such name.
+         */
+        const Value *find(std::string_view name) const {
+            const Node *node = &m_root;
+            usize position = 0;
+
+            while (position < name.size()) {
+                auto *slot = child(*node, name[position]);
+
+                if (slot == nullptr || name.substr(position).starts_with((*slot)->label) == false)
+                    return nullptr;
+                position += (*slot)->label.size();
+                node = slot->get();
+            }
+            return node->value ? &*node->value : nullptr;
+        }
+
+        /**
+         * @brief Calls a function with every name starting with a prefix, in lexicographic order.
+         * @param prefix The prefix, empty for every name.
+         * @param function Called with the name and its value.
+         */
+        template<typename Function>
+        void forEach(std::string_view prefix, const Function& function) const {
+            std::string name;
+            const Node *node = const_cast<NameIndex *>(this)->locate(prefix, name, nullptr);
+
+            if (node)
+                visit(*node, name, function);
+        }
+
+        /**
+         * @brief Counts the names starting with a prefix.
+         * @param prefix The prefix.
+         * @return usize The number of names.
+         */
+        usize count(std::string_view prefix) const {
+            usize total = 0;
+
+            forEach(prefix, [&total](const std::string&, const Value&) { ++total; });
+            return total;
+        }
+
+        /**
+         * @brief Removes every name starting with a prefix, the subtree is cut at once.
+         * @param prefix The prefix, empty for every name.
+         * @return usize The number of names removed.
+         */
+        usize erasePrefix(std::string_view prefix) {
+            std::string name;
+            std::vector<Node *> path;
+            Node *node = locate(prefix, name, &path);
+
+            if (node == nullptr)
+                return 0;
+
+            const usize removed = count(prefix);
+
+            if (node == &m_root) {
+                clear();
+                return removed;
+            }
+
+            Node& parent = *path[path.size() - 2];
+
+            parent.children.erase(std::find_if(parent.children.begin(), parent.children.end(),
+                                               [node](const auto& other) { return other.get() == node; }));
+            path.pop_back();
+            m_size -= removed;
+            prune(path);
+            return removed;
+        }
+
+        /**
+         * @brief Gets the number of names.
+         * @return usize The number of names.
+         */
+        usize size() const {
+            return m_size;
+        }
+
+        /**
+         * @brief Removes every name.
+         */
+        void clear() {
+            m_root.children.clear();
+            m_root.value.reset();
+            m_size = 0;
+        }
+
+    private:
+        struct Node {
+            std::string label;                          ///< The part of the name on the edge to the node.
+            std::optional<Value> value;                 ///< Set when a name ends at the node.
+            std::vector<std::unique_ptr<Node>> children; ///< Sorted by the first character of their label.
+        };
+
+        static usize commonPrefix(std::string_view a, std::string_view b) {
+            usize length = 0;
+
+            while (length < a.size() && length < b.size() && a[length] == b[length])
+                ++length;
+            return length;
+        }
+
+        template<typename N>
+        static auto *child(N& node, char first) {
+            auto it = std::lower_bound(node.children.begin(), node.children.end(), first,
+                                       [](const auto& other, char c) { return other->label[0] < c; });
+
+            if (it == node.children.end() || (*it)->label[0] != first)
+                return static_cast<decltype(&*it)>(nullptr);
+            return &*it;
+        }
+
+        /**
+         * @brief Finds the node under which every name starts with a prefix.
+         * @param name Set to the name of the node, which may be longer than the prefix.
+         * @param path Set to the nodes from the root to the node, may be null.
+         */
+        Node *locate(std::string_view prefix, std::string& name, std::vector<Node *> *path) {
+            Node *node = &m_root;
+            usize position = 0;
+
+            if (path)
+                path->push_back(node);
+            while (position < prefix.size()) {
+                auto *slot = child(*node, prefix[position]);
+
+                if (slot == nullptr)
+                    return nullptr;
+
+                const std::string& label = (*slot)->label;
+                const std::string_view rest = prefix.substr(position);
+
+                // The prefix may end in the middle of an edge
+                if (rest.size() < label.size() ? label.starts_with(rest) == false
+                                               : rest.starts_with(label) == false)
+                    return nullptr;
+                name += label;
+                position += label.size();
+                node = slot->get();
+                if (path)
+                    path->push_back(node);
+            }
+            return node;
+        }
+
+        template<typename Function>
+        static void visit(const Node& node, std::string& name, const Function& function) {
+            if (node.value)
+                function(name, *node.value);
+            for (const auto& next : node.children) {
+                name += next->label;
+                visit(*next, name, function);
+                name.resize(name.size() - next->label.size());
+            }
+        }
+
+        /**
+         * @brief Removes the empty nodes at the end of a path and merges the nodes left
+         *        with a single child.
+         */
+        void prune(std::vector<Node *>& path) {
+            while (path.size() > 1) {
+                Node *node = path.back();
+                Node& parent = *path[path.size() - 2];
+
+                if (node->value || node->children.size() > 1)
+                    break;
+                if (node->children.empty()) {
+                    parent.children.erase(std::find_if(parent.children.begin(), parent.children.end(),
+                                                       [node](const auto& other) { return other.get() == node; }));
+                    path.pop_back();
+                    continue;
+                }
+
+                // A single child, merged into the node
+                std::unique_ptr<Node> only = std::move(node->children[0]);
+
+                node->label += only->label;
+                node->value = std::move(only->value);
+                node->children = std::move(only->children);
+                break;
+            }
+        }
+
+        Node m_root;
+        usize m_size = 0;
+    };
+}
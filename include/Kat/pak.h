@@ -0,0 +1,292 @@
+#pragma once
+
+#include "./components/animator.h"
+#include "./components/atlas.h"
+#include "./mapped_file.h"
+
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief The kind of an asset stored in a pak.
+     */
+    enum class PakEntryType : u16 {
+        Raw,        ///< Bytes stored as is.
+        Image,      ///< An image baked in one of the ImageFormat, see Texture::load(Memory, size).
+        Animations, ///< An animation table, see encodeAnimations().
+        Script,     ///< A precompiled lua chunk, load it with luaL_loadbufferx in binary mode.
+        Atlas       ///< The regions of the images packed into atlas pages, see encodeAtlas().
+    };
+
+    /**
+     * @brief The images the baker packed into atlas pages (see ImageAtlas).
+     *        The pages are image entries, packed images have no entry of their own.
+     */
+    struct AtlasTable {
+        std::vector<std::string> pages;                          ///< The names of the entries of the pages.
+        std::map<std::string, AtlasRegion, std::less<>> regions; ///< The page and region of the images, by name.
+    };
+
+    /**
+     * @brief The header of a pre-decoded image, followed by width * height rgba pixels.
+     */
+    struct RawImageHeader {
+        char magic[4] = { 'K', 'R', 'A', 'W' };
+        u32 width = 0;
+        u32 height = 0;
+        u32 reserved = 0;
+    };
+
+    static_assert(sizeof(RawImageHeader) == 16);
+
+    /**
+     * @brief The header of a pak, at the start of the file.
+     */
+    struct PakHeader {
+        char magic[4] = { 'K', 'P', 'A', 'K' };
+        u32 version = 1;
+        u32 entries = 0;      ///< The number of entries of the index.
+        u32 block_size = 0;   ///< The uncompressed size of a block of a compressed entry.
+        u64 index_offset = 0; ///< The index, sorted by name.
+        u64 names_offset = 0; ///< The names of the entries, not null terminated.
+    };
+
+    static_assert(sizeof(PakHeader) == 32);
+
+    /**
+     * @brief An entry of the index of a pak.
+     *        A compressed entry starts with the stored size of each of its blocks,
+     *        blocks that did not shrink are stored as is.
+     */
+    struct PakIndexEntry {
+        u64 offset = 0;      ///< The offset of the data in the pak, 16 bytes aligned.
+        u64 size = 0;        ///< The size of the data.
+        u64 stored = 0;      ///< The size of the data in the pak.
+        u32 name_offset = 0; ///< The offset of the name in the names.
+        u32 name_size = 0;
+        u32 blocks = 0;      ///< The number of blocks, 0 when the entry is not compressed.
+        PakEntryType type = PakEntryType::Raw;
+        u16 reserved = 0;
+    };
+
+    static_assert(sizeof(PakIndexEntry) == 40);
+
+    /**
+     * @brief Compresses bytes with a byte-oriented lz77 codec (lz4-like sequences of
+     *        literals and matches within the last 64 KiB), made for fast decompression.
+     *
+     * @param input The bytes.
+     * @return std::vector<u8> The compressed bytes.
+     */
+    std::vector<u8> lzCompress(std::span<const u8> input);
+
+    /**
+     * @brief Decompresses bytes compressed by lzCompress().
+     *
+     * @param input The compressed bytes.
+     * @param output The bytes, its size has to be the size of the uncompressed bytes.
+     * @return bool Whether the bytes were valid and filled the output exactly.
+     */
+    bool lzDecompress(std::span<const u8> input, std::span<u8> output);
+
+    /**
+     * @brief Encodes an image as a RawImageHeader followed by its pixels.
+     *
+     * @param image The image.
+     * @return std::vector<u8> The encoded image.
+     */
+    std::vector<u8> encodeRawImage(const sf::Image& image);
+
+    /**
+     * @brief Encodes an animation table (names, speeds, loops and frames, trims are not kept).
+     *
+     * @param animations The animations.
+     * @return std::vector<u8> The encoded animations.
+     */
+    std::vector<u8> encodeAnimations(const AnimationRegistry& animations);
+
+    /**
+     * @brief Decodes an animation table encoded by encodeAnimations().
+     *
+     * @param data The encoded animations.
+     * @return AnimationRegistry The animations, throws a std::runtime_error if the data is invalid.
+     */
+    AnimationRegistry decodeAnimations(std::span<const u8> data);
+
+    /**
+     * @brief Encodes an atlas table (the names of the pages, then the names and regions of the images).
+     *
+     * @param atlas The atlas table.
+     * @return std::vector<u8> The encoded atlas table.
+     */
+    std::vector<u8> encodeAtlas(const AtlasTable& atlas);
+
+    /**
+     * @brief Decodes an atlas table encoded by encodeAtlas().
+     *
+     * @param data The encoded atlas table.
+     * @return AtlasTable The atlas table, throws a std::runtime_error if the data is invalid.
+     */
+    AtlasTable decodeAtlas(std::span<const u8> data);
+
+    /**
+     * @brief Writes paks, used by the kat_pak baker.
+     */
+    class PakWriter {
+    public:
+        /**
+         * @brief The uncompressed size of a block of a compressed entry.
+         */
+        static constexpr u32 BlockSize = 1 << 16;
+
+        /**
+         * @brief Adds an entry, replacing an entry of the same name.
+         *
+         * @param name The name of the entry.
+         * @param type The type of the entry.
+         * @param data The data of the entry.
+         * @return PakWriter& Reference to self.
+         */
+        PakWriter& add(const std::string& name, PakEntryType type, std::vector<u8> data);
+
+        /**
+         * @brief Gets the number of entries.
+         *
+         * @return usize The number of entries.
+         */
+        usize size() const;
+
+        /**
+         * @brief Writes the pak.
+         *
+         * @param filename The filename of the pak.
+         * @param compress Whether the entries are compressed in blocks.
+         * @return bool Whether the pak was written.
+         */
+        bool save(const std::string& filename, bool compress) const;
+
+    private:
+        struct Entry {
+            std::string name;
+            PakEntryType type;
+            std::vector<u8> data;
+        };
+
+        std::vector<Entry> m_entries;
+    };
+
+    /**
+     * @brief A pak mapped in memory: pre-decoded assets in a single file with an index.
+     *
+     *        Opening a pak maps it, checks its index and decodes its atlas tables, entries
+     *        are then read straight from the mapping, without any file access. Only compressed
+     *        entries are copied, when they are decompressed.
+     */
+    class Pak {
+    public:
+        /**
+         * @brief Maps a pak.
+         *
+         * @param filename The filename of the pak.
+         * @return bool Whether the pak is mapped and valid.
+         */
+        bool open(const std::string& filename);
+
+        /**
+         * @brief Unmaps the pak.
+         */
+        void close();
+
+        /**
+         * @brief Gets the number of entries.
+         *
+         * @return usize The number of entries.
+         */
+        usize size() const;
+
+        /**
+         * @brief Finds an entry.
+         *
+         * @param name The name of the entry, its path relative to the baked directory.
+         * @return const PakIndexEntry* The entry, null if there is none.
+         */
+        const PakIndexEntry* find(std::string_view name) const;
+
+        /**
+         * @brief Does the pak contain an entry?
+         *
+         * @param name The name of the entry.
+         * @return true The entry exists.
+         * @return false There is no such entry.
+         */
+        bool contains(std::string_view name) const;
+
+        /**
+         * @brief Gets the name of an entry.
+         *
+         * @param entry The entry.
+         * @return std::string_view The name.
+         */
+        std::string_view name(const PakIndexEntry& entry) const;
+
+        /**
+         * @brief Gets the entries, sorted by name.
+         *
+         * @return std::span<const PakIndexEntry> The entries.
+         */
+        std::span<const PakIndexEntry> entries() const;
+
+        /**
+         * @brief Gets the data of an entry, throws a std::runtime_error if the entry
+         *        does not exist or is corrupted.
+         *
+         * @param name The name of the entry.
+         * @param scratch Holds compressed entries once decompressed.
+         * @return std::span<const u8> The data, in the mapping or in the scratch buffer.
+         */
+        std::span<const u8> data(std::string_view name, std::vector<u8>& scratch) const;
+
+        /**
+         * @brief Finds an image packed into an atlas page by the baker.
+         *
+         * @param name The name of the image.
+         * @return const AtlasRegion* The page and region of the image, null if it was not packed.
+         */
+        const AtlasRegion* region(std::string_view name) const;
+
+        /**
+         * @brief Creates a texture from an image entry, uploaded straight from the mapping.
+         *        Images packed into atlas pages are regions of their page (see Texture::setRegion()),
+         *        each page is uploaded once.
+         *
+         * @param name The name of the entry or of the packed image.
+         * @return Texture The texture, null if it could not be created.
+         */
+        Texture texture(std::string_view name) const;
+
+        /**
+         * @brief Decodes an animations entry.
+         *
+         * @param name The name of the entry.
+         * @return AnimationRegistry The animations.
+         */
+        AnimationRegistry animations(std::string_view name) const;
+
+    private:
+        MappedFile m_file;
+        const PakHeader *m_header = nullptr;
+        std::span<const PakIndexEntry> m_entries;
+        std::string_view m_names;
+        AtlasTable m_atlas;
+        mutable std::vector<Texture> m_pages; ///< The textures of the atlas pages, created on first use.
+        mutable std::mutex m_pages_mutex;
+
+        Texture loadTexture(std::string_view name) const;
+    };
+}
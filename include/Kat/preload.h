@@ -0,0 +1,179 @@
+#pragma once
+
+#include "./loader.h"
+#include "./resource.h"
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief A resource used during a recorded session.
+     */
+    struct PreloadEntry {
+        u32 time = 0;        ///< The time of the first use, in milliseconds since the recording started.
+        std::string kind;    ///< How the resource is loaded ("texture"...).
+        ResourceName name;   ///< The name of the resource.
+        std::string source;  ///< What it is loaded from, a filename for textures.
+    };
+
+    /**
+     * @brief The resources of a session, in the order they were first used.
+     *
+     *        Manifests are text files, one tab separated entry per line:
+     *        time, kind, name and source.
+     */
+    class PreloadManifest {
+    public:
+        /**
+         * @brief Reads a manifest.
+         * @param filename The filename of the manifest.
+         * @return bool Whether the manifest was read.
+         */
+        bool load(const std::string& filename);
+
+        /**
+         * @brief Writes the manifest.
+         * @param filename The filename of the manifest.
+         * @return bool Whether the manifest was written.
+         */
+        bool save(const std::string& filename) const;
+
+        /**
+         * @brief Adds an entry at the end of the manifest.
+         * @param entry The entry.
+         * @return PreloadManifest& Reference to self.
+         */
+        PreloadManifest& add(const PreloadEntry& entry);
+
+        /**
+         * @brief Removes every entry.
+         * @return PreloadManifest& Reference to self.
+         */
+        PreloadManifest& clear();
+
+        /**
+         * @brief Gets the entries, in the order of their first use.
+         * @return const std::vector<PreloadEntry>& The entries.
+         */
+        const std::vector<PreloadEntry>& entries() const;
+
+        /**
+         * @brief Gets the number of entries.
+         * @return usize The number of entries.
+         */
+        usize size() const;
+
+    private:
+        std::vector<PreloadEntry> m_entries;
+    };
+
+    /**
+     * @brief Records the first use of the resources of a manager into a manifest.
+     *
+     *        Only resources whose source is known can be preloaded: the resource loader
+     *        reports the sources of its loads (see ResourceLoader::setRecorder), other
+     *        sources are reported with setSource().
+     */
+    class PreloadRecorder {
+    public:
+        /**
+         * @brief Starts recording.
+         *
+         * @param resources The resource manager to trace, its first use callback is replaced.
+         * @param duration The time to record, 0 to record until the recorder is destroyed.
+         */
+        PreloadRecorder(ResourceManager& resources,
+                        std::chrono::milliseconds duration = std::chrono::milliseconds(0));
+
+        /**
+         * @brief Stops recording.
+         */
+        ~PreloadRecorder();
+
+        PreloadRecorder(const PreloadRecorder&) = delete;
+        PreloadRecorder& operator=(const PreloadRecorder&) = delete;
+
+        /**
+         * @brief Sets how a resource is loaded.
+         *
+         * @param kind How the resource is loaded ("texture"...).
+         * @param name The name of the resource.
+         * @param source What it is loaded from.
+         * @return PreloadRecorder& Reference to self.
+         */
+        PreloadRecorder& setSource(const std::string& kind, const ResourceName& name,
+                                   const std::string& source);
+
+        /**
+         * @brief Records the first use of a resource, called by the resource manager.
+         * @param name The name of the resource.
+         */
+        void access(const ResourceName& name);
+
+        /**
+         * @brief Is the recorder still recording?
+         * @return bool Whether the duration is not over.
+         */
+        bool isRecording() const;
+
+        /**
+         * @brief Gets the recorded manifest.
+         * @return const PreloadManifest& The manifest.
+         */
+        const PreloadManifest& manifest() const;
+
+        /**
+         * @brief Writes the recorded manifest.
+         * @param filename The filename of the manifest.
+         * @return bool Whether the manifest was written.
+         */
+        bool save(const std::string& filename) const;
+
+    private:
+        struct Source {
+            std::string kind;
+            std::string source;
+            bool recorded = false;
+        };
+
+        ResourceManager& m_resources;
+        std::chrono::steady_clock::time_point m_start;
+        std::chrono::milliseconds m_duration;
+        std::unordered_map<ResourceName, Source> m_sources;
+        PreloadManifest m_manifest;
+    };
+
+    /**
+     * @brief Starts the load of an entry of a manifest.
+     */
+    using Preloader = std::function<LoadHandle(ResourceLoader& loader, const PreloadEntry& entry,
+                                               LoadPriority priority, const LoadBundle* bundle)>;
+
+    /**
+     * @brief Sets how the entries of a kind are preloaded, "texture" is known by default.
+     * @param kind The kind of the entries.
+     * @param preloader Starts the load of an entry.
+     */
+    void setPreloader(const std::string& kind, const Preloader& preloader);
+
+    /**
+     * @brief Loads the resources of a manifest on the workers of a loader, in the order
+     *        they were first used: the first entry has the given priority, the next ones
+     *        a lower priority, so the loads the game asks for meanwhile come first.
+     *        Entries of an unknown kind are skipped.
+     *
+     * @param loader The loader.
+     * @param manifest The manifest.
+     * @param priority The priority of the first entry.
+     * @param prefix Only preloads the resources of a namespace ("level3/"), empty for every resource.
+     * @return LoadBundle The bundle of the loads.
+     */
+    LoadBundle preload(ResourceLoader& loader, const PreloadManifest& manifest,
+                       LoadPriority priority = 0, std::string_view prefix = {});
+}
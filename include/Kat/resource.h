@@ -1,18 +1,529 @@
 #pragma once
 
-#include <typeindex>
-#include <unordered_map>
+#include <algorithm>
 #include <any>
+#include <array>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
 
 #include "./components/texture.h"
+#include "./name_index.h"
 
 namespace kat {
 
     using Resource     = std::any;
-    using ResourceType = const char *;
     using ResourceName = std::string; 
-    using ResourceMap  = std::unordered_map<ResourceName, Resource>;
-    using ResourceMapRegistry = std::unordered_map<ResourceType, ResourceMap>;
+
+    /**
+     * @brief A generational handle to a resource of type T.
+     *        The low 20 bits index a slot of the pool of T, the high 12 bits hold the
+     *        generation of the slot, so handles to removed resources are detected.
+     */
+    template<typename T>
+    struct ResourceHandle {
+        static constexpr u32 IndexBits = 20;
+        static constexpr u32 IndexMask = (1u << IndexBits) - 1;
+        static constexpr u32 GenerationMask = (1u << (32 - IndexBits)) - 1;
+
+        u32 value = 0; ///< 0 is the null handle, generations start at 1.
+
+        u32 index() const { return value & IndexMask; }
+
+        u32 generation() const { return value >> IndexBits; }
+
+        bool isNull() const { return value == 0; }
+
+        explicit operator bool() const { return value != 0; }
+
+        bool operator==(const ResourceHandle&) const = default;
+
+        static ResourceHandle make(u32 index, u32 generation) {
+            return ResourceHandle{ (generation << IndexBits) | index };
+        }
+    };
+
+    /**
+     * @brief Gets the next free resource type index.
+     */
+    usize nextResourceTypeIndex();
+
+    /**
+     * @brief Gets a small integer identifying a resource type, assigned on first use.
+     * @return The index of the type.
+     */
+    template<typename T>
+    usize resourceTypeIndex() {
+        static const usize index = nextResourceTypeIndex();
+        return index;
+    }
+
+    /**
+     * @brief The memory held by resources, in bytes.
+     */
+    struct ResourceBytes {
+        usize cpu = 0;
+        usize gpu = 0;
+
+        ResourceBytes& operator+=(const ResourceBytes& other) {
+            cpu += other.cpu;
+            gpu += other.gpu;
+            return *this;
+        }
+
+        ResourceBytes& operator-=(const ResourceBytes& other) {
+            cpu -= other.cpu;
+            gpu -= other.gpu;
+            return *this;
+        }
+
+        /**
+         * @brief Is a budget exceeded? A budget of 0 is unlimited.
+         * @param budget The budget.
+         * @return Whether the cpu or the gpu bytes exceed the budget.
+         */
+        bool exceeds(const ResourceBytes& budget) const {
+            return (budget.cpu && cpu > budget.cpu) || (budget.gpu && gpu > budget.gpu);
+        }
+
+        bool operator==(const ResourceBytes&) const = default;
+    };
+
+    /**
+     * @brief Gets the memory held by a resource, overload it for your resource types.
+     * @return ResourceBytes By default the size of the resource, on the cpu.
+     */
+    template<typename T>
+    ResourceBytes resourceBytes(const T&) {
+        return { sizeof(T), 0 };
+    }
+
+    /**
+     * @brief Gets the memory held by a texture, its pixels on the gpu.
+     *        A region (see Texture::setRegion()) only counts the pixels of its region.
+     */
+    ResourceBytes resourceBytes(const Texture& texture);
+
+    /**
+     * @brief Is a resource used outside of its resource manager? Used resources are never
+     *        evicted. Overload it for the resource types sharing their data, like Texture.
+     * @return bool By default false, copies of the resource do not depend on it.
+     */
+    template<typename T>
+    bool isResourceShared(const T&) {
+        return false;
+    }
+
+    /**
+     * @brief Is a texture used by another kat::Texture (a sprite, a region...)?
+     */
+    bool isResourceShared(const Texture& texture);
+
+    class ResourcePoolBase;
+
+    /**
+     * @brief A resource that may be evicted.
+     */
+    struct EvictionCandidate {
+        u64 last_use;
+        ResourceBytes bytes;
+        ResourcePoolBase *pool;
+        u32 index;
+    };
+
+    class ResourcePoolBase {
+    public:
+        virtual ~ResourcePoolBase() = default;
+
+        /**
+         * @brief Removes every resource, the handles to them become stale.
+         */
+        virtual void clear() = 0;
+
+        /**
+         * @brief Measures the resources again and lists the ones that may be evicted:
+         *        loaded with a loader and not shared.
+         * @param candidates The list the candidates are appended to.
+         */
+        virtual void collect(std::vector<EvictionCandidate>& candidates) = 0;
+
+        /**
+         * @brief Evicts a resource, its handles stay valid and reload it.
+         * @param index The index of the slot of the resource.
+         */
+        virtual void evict(u32 index) = 0;
+
+        /**
+         * @brief Removes every resource whose name starts with a prefix.
+         * @param prefix The prefix ("level3/").
+         * @return usize The number of resources removed.
+         */
+        virtual usize removePrefix(std::string_view prefix) = 0;
+
+        /**
+         * @brief Gets the memory held by the loaded resources.
+         * @return const ResourceBytes& The bytes.
+         */
+        const ResourceBytes& bytes() const {
+            return m_bytes;
+        }
+
+        /**
+         * @brief Sets the budget of the pool, enforced by ResourceManager::collect().
+         * @param budget The budget, 0 for unlimited.
+         */
+        void setBudget(const ResourceBytes& budget) {
+            m_budget = budget;
+        }
+
+        /**
+         * @brief Gets the budget of the pool.
+         * @return const ResourceBytes& The budget, 0 for unlimited.
+         */
+        const ResourceBytes& getBudget() const {
+            return m_budget;
+        }
+
+        /**
+         * @brief Sets the clock stamping the accesses, shared by the pools of a manager
+         *        so the least recently used resource of every type can be found.
+         * @param clock The clock, null to stop stamping.
+         */
+        void setClock(u64 *clock) {
+            m_clock = clock;
+        }
+
+        /**
+         * @brief Sets the callback called the first time each resource is accessed.
+         * @param callback The callback, owned by the manager, null to stop tracing.
+         */
+        void setFirstUse(const std::function<void(const ResourceName&)> *callback) {
+            m_first_use = callback;
+        }
+
+    protected:
+        ResourceBytes m_bytes;
+        ResourceBytes m_budget;
+        u64 *m_clock = nullptr;
+        const std::function<void(const ResourceName&)> *m_first_use = nullptr;
+    };
+
+    /**
+     * @brief The storage of the resources of a type.
+     *        Resources live in fixed size chunks, so they never move: references stay
+     *        valid until the resource is removed or evicted. Lookups by handle are two
+     *        array accesses, lookups by name walk a radix trie and are meant for loading time.
+     *        Resources with a loader may be evicted, the next access reloads them.
+     */
+    template<typename T>
+    class ResourcePool : public ResourcePoolBase {
+    public:
+        static constexpr u32 ChunkSize = 256;
+
+        /**
+         * @brief Adds a resource, a resource of the same name is kept as is.
+         * @param name The name of the resource.
+         * @param resource The resource.
+         * @return ResourceHandle<T> The handle of the resource of this name.
+         */
+        template<typename U>
+        ResourceHandle<T> insert(const ResourceName& name, U&& resource) {
+            if (const auto *existing = m_names.find(name))
+                return *existing;
+
+            u32 index;
+
+            if (m_free.empty() == false) {
+                index = m_free.back();
+                m_free.pop_back();
+            } else {
+                if (m_used > ResourceHandle<T>::IndexMask)
+                    throw std::runtime_error("Resource pool full.");
+                if (m_used % ChunkSize == 0)
+                    m_chunks.push_back(std::make_unique<std::array<Slot, ChunkSize>>());
+                index = m_used++;
+            }
+
+            Slot& entry = slot(index);
+
+            entry.value.emplace(std::forward<U>(resource));
+            entry.name = name;
+            entry.used = true;
+            entry.bytes = resourceBytes(*entry.value);
+            entry.last_use = m_clock ? ++*m_clock : 0;
+            m_bytes += entry.bytes;
+
+            const auto handle = ResourceHandle<T>::make(index, entry.generation);
+
+            m_names.insert(name, handle);
+            return handle;
+        }
+
+        /**
+         * @brief Gets a resource.
+         * @param handle The handle of the resource.
+         * @return T* The resource, null if the handle is stale or null.
+         */
+        T *get(ResourceHandle<T> handle) {
+            Slot *entry = use(handle);
+
+            if (entry == nullptr)
+                return nullptr;
+            if (!entry->value) {
+                try {
+                    reload(*entry);
+                } catch (const std::exception&) {
+                    return nullptr;
+                }
+            }
+            return &*entry->value;
+        }
+
+        /**
+         * @brief Gets a resource, reloaded if it was evicted.
+         * @param handle The handle of the resource.
+         * @return T& The resource.
+         * @throw std::runtime_error If the handle is stale or null, or the error of the
+         *        loader if the resource could not be reloaded.
+         */
+        T& at(ResourceHandle<T> handle) {
+            Slot *entry = use(handle);
+
+            if (entry == nullptr)
+                throw std::runtime_error("Stale resource handle.");
+            if (!entry->value)
+                reload(*entry);
+            return *entry->value;
+        }
+
+        /**
+         * @brief Does a handle refer to a resource, loaded or evicted?
+         *        Unlike get(), the resource is neither reloaded nor marked as used.
+         * @param handle The handle.
+         * @return bool Whether the resource exists.
+         */
+        bool contains(ResourceHandle<T> handle) const {
+            return const_cast<ResourcePool *>(this)->lookup(handle) != nullptr;
+        }
+
+        /**
+         * @brief Gets a resource. (const)
+         * @param handle The handle of the resource.
+         * @return const T* The resource, null if the handle is stale or null.
+         */
+        const T *get(ResourceHandle<T> handle) const {
+            return const_cast<ResourcePool *>(this)->get(handle);
+        }
+
+        /**
+         * @brief Sets the loader of a resource, so it can be evicted and reloaded.
+         * @param handle The handle of the resource.
+         * @param loader The loader, empty to never evict the resource.
+         * @return bool Whether the resource exists.
+         */
+        bool setLoader(ResourceHandle<T> handle, std::function<T()> loader) {
+            Slot *entry = lookup(handle);
+
+            if (entry == nullptr)
+                return false;
+            entry->loader = std::move(loader);
+            return true;
+        }
+
+        /**
+         * @brief Is a resource evicted?
+         * @param handle The handle of the resource.
+         * @return bool Whether the resource exists and has to be reloaded.
+         */
+        bool isEvicted(ResourceHandle<T> handle) const {
+            const Slot *entry = const_cast<ResourcePool *>(this)->lookup(handle);
+
+            return entry && !entry->value;
+        }
+
+        /**
+         * @brief Gets the memory held by a resource, as measured when it was added,
+         *        reloaded or last collected.
+         * @param handle The handle of the resource.
+         * @return ResourceBytes The bytes, 0 if the resource is evicted or does not exist.
+         */
+        ResourceBytes bytes(ResourceHandle<T> handle) const {
+            const Slot *entry = const_cast<ResourcePool *>(this)->lookup(handle);
+
+            return entry && entry->value ? entry->bytes : ResourceBytes();
+        }
+
+        using ResourcePoolBase::bytes;
+
+        /**
+         * @brief Finds the handle of a resource.
+         * @param name The name of the resource.
+         * @return ResourceHandle<T> The handle, null if there is no such resource.
+         */
+        ResourceHandle<T> find(const ResourceName& name) const {
+            const auto *handle = m_names.find(name);
+
+            return handle ? *handle : ResourceHandle<T>();
+        }
+
+        /**
+         * @brief Calls a function with the resources whose name starts with a prefix,
+         *        in the order of their names. The time taken is proportional to the
+         *        number of matching resources.
+         * @param prefix The prefix ("level3/enemies/"), empty for every resource.
+         * @param function Called with the name and the handle of every resource.
+         */
+        template<typename Function>
+        void forEach(std::string_view prefix, const Function& function) const {
+            m_names.forEach(prefix, function);
+        }
+
+        usize removePrefix(std::string_view prefix) override {
+            m_names.forEach(prefix, [this](const ResourceName&, ResourceHandle<T> handle) {
+                release(handle.index());
+            });
+            return m_names.erasePrefix(prefix);
+        }
+
+        /**
+         * @brief Removes a resource, its handles become stale.
+         * @param handle The handle of the resource.
+         * @return bool Whether the resource existed.
+         */
+        bool remove(ResourceHandle<T> handle) {
+            Slot *entry = lookup(handle);
+
+            if (entry == nullptr)
+                return false;
+            m_names.erase(entry->name);
+            release(handle.index());
+            return true;
+        }
+
+        /**
+         * @brief Gets the number of resources.
+         * @return usize The number of resources.
+         */
+        usize size() const {
+            return m_names.size();
+        }
+
+        void clear() override {
+            for (u32 index = 0; index < m_used; ++index) {
+                if (slot(index).used)
+                    release(index);
+            }
+            m_names.clear();
+        }
+
+        void collect(std::vector<EvictionCandidate>& candidates) override {
+            for (u32 index = 0; index < m_used; ++index) {
+                Slot& entry = slot(index);
+
+                if (!entry.value)
+                    continue;
+
+                // Resources may grow or shrink through the references handed out
+                m_bytes -= entry.bytes;
+                entry.bytes = resourceBytes(*entry.value);
+                m_bytes += entry.bytes;
+                if (entry.loader && isResourceShared(*entry.value) == false)
+                    candidates.push_back({ entry.last_use, entry.bytes, this, index });
+            }
+        }
+
+        void evict(u32 index) override {
+            Slot& entry = slot(index);
+
+            if (!entry.value)
+                return;
+            m_bytes -= entry.bytes;
+            entry.value.reset();
+        }
+
+    private:
+        struct Slot {
+            std::optional<T> value;        ///< Empty when the slot is free or the resource evicted.
+            u32 generation = 1;
+            ResourceName name;
+            bool used = false;             ///< Whether the slot holds a resource, loaded or evicted.
+            bool traced = false;           ///< Whether the first use of the resource was reported.
+            ResourceBytes bytes;
+            u64 last_use = 0;
+            std::function<T()> loader;     ///< Reloads the resource once evicted, may be empty.
+        };
+
+        Slot& slot(u32 index) {
+            return (*m_chunks[index / ChunkSize])[index % ChunkSize];
+        }
+
+        /**
+         * @brief Gets the slot of a resource, loaded or evicted.
+         */
+        Slot *lookup(ResourceHandle<T> handle) {
+            if (handle.index() >= m_used)
+                return nullptr;
+
+            Slot& entry = slot(handle.index());
+
+            if (entry.generation != handle.generation() || entry.used == false)
+                return nullptr;
+            return &entry;
+        }
+
+        /**
+         * @brief Gets the slot of a resource and marks it as used.
+         */
+        Slot *use(ResourceHandle<T> handle) {
+            Slot *entry = lookup(handle);
+
+            if (entry == nullptr)
+                return nullptr;
+            if (m_clock)
+                entry->last_use = ++*m_clock;
+            if (entry->traced == false && m_first_use && *m_first_use) {
+                entry->traced = true;
+                (*m_first_use)(entry->name);
+            }
+            return entry;
+        }
+
+        /**
+         * @brief Reloads an evicted resource, the errors of the loader are thrown as is.
+         */
+        void reload(Slot& entry) {
+            if (!entry.loader)
+                throw std::runtime_error("Evicted resource without a loader.");
+            entry.value.emplace(entry.loader());
+            entry.bytes = resourceBytes(*entry.value);
+            m_bytes += entry.bytes;
+        }
+
+        void release(u32 index) {
+            Slot& entry = slot(index);
+
+            if (entry.value)
+                m_bytes -= entry.bytes;
+            entry.value.reset();
+            entry.loader = nullptr;
+            entry.name.clear();
+            entry.used = false;
+            entry.traced = false;
+            // Generation 0 would make null handles
+            entry.generation = (entry.generation & ResourceHandle<T>::GenerationMask) + 1;
+            if (entry.generation > ResourceHandle<T>::GenerationMask)
+                entry.generation = 1;
+            m_free.push_back(index);
+        }
+
+        std::vector<std::unique_ptr<std::array<Slot, ChunkSize>>> m_chunks;
+        std::vector<u32> m_free;
+        u32 m_used = 0; ///< The number of slots ever used.
+        NameIndex<ResourceHandle<T>> m_names;
+    };
 
     // Please consider using copyable resources only.
     // Theses resources are not thread safe and should be used only in the main thread.
@@ -23,21 +534,86 @@ namespace kat {
     // This pointer is handeled like a shared pointer.
     // This means that the texture is not destroyed until the last copy of the texture is destroyed.
     // This is a good idea because the texture is used in multiple places.
+    //
+    // Resources are stored in a pool per type. Resolve names to handles at loading time
+    // (getHandle) and use handles in hot loops (get): a handle lookup is an array access.
+    // Use a ConcurrentResourceManager to share resources between threads.
+    //
+    // Names are path-like ("level3/enemies/bat"): the resources of a namespace are found
+    // and removed at once by prefix (findResources, removeResources).
+    //
+    // The memory held by resources is tracked per resource and per type. Resources added
+    // with a loader (loadResource, setLoader) may be evicted by collect() when a budget is
+    // exceeded, least recently used first, unless they are shared (see isResourceShared).
+    // Their handles stay valid: the next access reloads them.
     class ResourceManager {
     private:
         /**
-         * @brief The registry of all resources.
+         * @brief The pools of every type, indexed by resourceTypeIndex().
+         */
+        std::vector<std::unique_ptr<ResourcePoolBase>> m_pools;
+
+        /**
+         * @brief Stamps the accesses of every pool.
          */
-        ResourceMapRegistry m_registry;
+        u64 m_clock = 0;
+
+        /**
+         * @brief The budget of every type together, 0 for unlimited.
+         */
+        ResourceBytes m_budget;
+
+        /**
+         * @brief The number of resources evicted since the manager was created.
+         */
+        usize m_evicted = 0;
+
+        /**
+         * @brief Called the first time each resource is accessed, may be empty.
+         */
+        std::function<void(const ResourceName&)> m_first_use;
+
+        template<typename T>
+        ResourcePoolBase *findPoolBase() const {
+            const usize index = resourceTypeIndex<T>();
+            if (index >= m_pools.size())
+                return nullptr;
+            return m_pools[index].get();
+        }
+
+        /**
+         * @brief Evicts candidates, least recently used first, until the bytes fit the budget.
+         */
+        usize evict(std::vector<EvictionCandidate>& candidates, ResourceBytes& bytes,
+                    const ResourceBytes& budget) {
+            usize count = 0;
+
+            std::sort(candidates.begin(), candidates.end(),
+                      [](const auto& a, const auto& b) { return a.last_use < b.last_use; });
+            for (auto& candidate : candidates) {
+                if (bytes.exceeds(budget) == false)
+                    break;
+
+                // Only evict resources holding the kind of memory over budget
+                const bool cpu = budget.cpu && bytes.cpu > budget.cpu && candidate.bytes.cpu;
+                const bool gpu = budget.gpu && bytes.gpu > budget.gpu && candidate.bytes.gpu;
+
+                if (candidate.pool == nullptr || (cpu == false && gpu == false))
+                    continue;
+                candidate.pool->evict(candidate.index);
+                bytes -= candidate.bytes;
+                candidate.pool = nullptr;
+                ++count;
+            }
+            return count;
+        }
 
     public:
         /**
          * @brief Default constructor, it will setup every trivial resource.
          */
         ResourceManager() {
-            const auto typid = typeid(Texture).name();
-            m_registry[typid] = ResourceMap();
-            m_registry[typid].emplace("default", std::any(Texture()));
+            addResource("default", Texture());
         }
 
         /**
@@ -45,30 +621,175 @@ namespace kat {
          */
         ~ResourceManager() = default;
 
+        // The pools point to the clock and the callbacks of their manager
+        ResourceManager(const ResourceManager&) = delete;
+        ResourceManager& operator=(const ResourceManager&) = delete;
+
         /**
-         * @brief Add a resource to the registry.
+         * @brief Get the pool of a type, created if needed.
+         * @return The pool.
+         */
+        template<typename T>
+        ResourcePool<T>& pool() {
+            const usize index = resourceTypeIndex<T>();
+            if (index >= m_pools.size())
+                m_pools.resize(index + 1);
+            if (!m_pools[index]) {
+                m_pools[index] = std::make_unique<ResourcePool<T>>();
+                m_pools[index]->setClock(&m_clock);
+                m_pools[index]->setFirstUse(&m_first_use);
+            }
+            return static_cast<ResourcePool<T>&>(*m_pools[index]);
+        }
+
+        /**
+         * @brief Get the pool of a type.
+         * @return The pool, null if no resource of this type was ever added.
+         */
+        template<typename T>
+        const ResourcePool<T> *findPool() const {
+            const usize index = resourceTypeIndex<T>();
+            if (index >= m_pools.size() || !m_pools[index])
+                return nullptr;
+            return static_cast<const ResourcePool<T> *>(m_pools[index].get());
+        }
+
+        /**
+         * @brief Add a resource to the registry, a resource of the same name is kept.
          * @param name The name of the resource.
          * @param resource The resource to add.
+         * @return The handle of the resource.
          */
         template<typename T>
-        void addResource(const ResourceName& name, const T& resource) {
-            const auto typid = typeid(T).name();
-            if (m_registry.find(typid) == m_registry.end())
-                m_registry[typid] = ResourceMap();
-            m_registry[typid].emplace(name, std::any(resource));
+        ResourceHandle<T> addResource(const ResourceName& name, const T& resource) {
+            return pool<T>().insert(name, resource);
         }
 
         /**
-         * @brief Add a resource to the registry.
+         * @brief Add a resource to the registry, a resource of the same name is kept.
          * @param name The name of the resource.
          * @param resource The resource to add.
+         * @return The handle of the resource.
+         */
+        template<typename T>
+        ResourceHandle<std::decay_t<T>> addResource(const ResourceName& name, T&& resource) {
+            return pool<std::decay_t<T>>().insert(name, std::forward<T>(resource));
+        }
+
+        /**
+         * @brief Load a resource and record its loader, so it can be evicted and reloaded.
+         *        A resource of the same name is kept.
+         * @param name The name of the resource.
+         * @param loader Loads the resource, now and after every eviction.
+         * @return The handle of the resource.
          */
         template<typename T>
-        void addResource(const ResourceName& name, T&& resource) {
-            const auto typid = typeid(T).name();
-            if (m_registry.find(typid) == m_registry.end())
-                m_registry[typid] = ResourceMap();
-            m_registry[typid].emplace(name, std::any(std::move(resource)));
+        ResourceHandle<T> loadResource(const ResourceName& name, std::function<T()> loader) {
+            auto& resources = pool<T>();
+            const auto existing = resources.find(name);
+            if (existing)
+                return existing;
+            const auto handle = resources.insert(name, loader());
+            resources.setLoader(handle, std::move(loader));
+            return handle;
+        }
+
+        /**
+         * @brief Set the loader of a resource, so it can be evicted and reloaded.
+         * @param handle The handle of the resource.
+         * @param loader The loader, empty to never evict the resource.
+         * @return Whether the resource exists.
+         */
+        template<typename T>
+        bool setLoader(ResourceHandle<T> handle, std::function<T()> loader) {
+            return pool<T>().setLoader(handle, std::move(loader));
+        }
+
+        /**
+         * @brief Get the handle of a resource, to be resolved once at loading time.
+         * @param name The name of the resource.
+         * @return The handle.
+         */
+        template<typename T>
+        ResourceHandle<T> getHandle(const ResourceName& name) const {
+            const auto *resources = findPool<T>();
+            if (resources == nullptr)
+                throw std::runtime_error("Resource type not found.");
+            const auto handle = resources->find(name);
+            if (!handle)
+                throw std::runtime_error("Resource not found.");
+            return handle;
+        }
+
+        /**
+         * @brief Get a resource from the registry, reloaded if it was evicted.
+         * @param handle The handle of the resource.
+         * @return The resource.
+         * @throw std::runtime_error If the handle is stale, or the error of the loader.
+         */
+        template<typename T>
+        T &get(ResourceHandle<T> handle) {
+            const usize index = resourceTypeIndex<T>();
+            if (index >= m_pools.size() || !m_pools[index])
+                throw std::runtime_error("Stale resource handle.");
+            return static_cast<ResourcePool<T>&>(*m_pools[index]).at(handle);
+        }
+
+        /**
+         * @brief Get a resource from the registry, reloaded if it was evicted.
+         * @param handle The handle of the resource.
+         * @return The resource.
+         * @throw std::runtime_error If the handle is stale, or the error of the loader.
+         */
+        template<typename T>
+        const T &get(ResourceHandle<T> handle) const {
+            return const_cast<ResourceManager *>(this)->get(handle);
+        }
+
+        /**
+         * @brief Get a resource from the registry without throwing.
+         * @param handle The handle of the resource.
+         * @return The resource, null if the handle is stale.
+         */
+        template<typename T>
+        T *tryGet(ResourceHandle<T> handle) {
+            const usize index = resourceTypeIndex<T>();
+            if (index >= m_pools.size() || !m_pools[index])
+                return nullptr;
+            return static_cast<ResourcePool<T>&>(*m_pools[index]).get(handle);
+        }
+
+        /**
+         * @brief Get a resource from the registry without throwing.
+         * @param handle The handle of the resource.
+         * @return The resource, null if the handle is stale.
+         */
+        template<typename T>
+        const T *tryGet(ResourceHandle<T> handle) const {
+            const auto *resources = findPool<T>();
+            return resources ? resources->get(handle) : nullptr;
+        }
+
+        /**
+         * @brief Is a handle valid?
+         * @param handle The handle.
+         * @return Whether the resource of the handle exists.
+         */
+        template<typename T>
+        bool isValid(ResourceHandle<T> handle) const {
+            const auto *resources = findPool<T>();
+            return resources && resources->contains(handle);
+        }
+
+        /**
+         * @brief Is there a resource of this name?
+         * @param name The name of the resource.
+         * @return Whether the resource exists.
+         */
+        template<typename T>
+        bool hasResource(const ResourceName& name) const {
+            const auto *resources = findPool<T>();
+            return resources && resources->find(name);
         }
 
         /**
@@ -78,14 +799,7 @@ namespace kat {
          */
         template<typename T>
         T &getResource(const ResourceName& name) {
-            const auto typid = typeid(T).name();
-            const auto type = m_registry.find(typid);
-            if (type == m_registry.end())
-                throw std::runtime_error("Resource type not found.");
-            const auto resource = type->second.find(name);
-            if (resource == type->second.end())
-                throw std::runtime_error("Resource not found.");
-            return std::any_cast<T&>(resource->second);
+            return get(getHandle<T>(name));
         }
 
         /**
@@ -95,21 +809,210 @@ namespace kat {
          */
         template<typename T>
         const T &getResource(const ResourceName& name) const {
-            const auto typid = typeid(T).name();
-            const auto type = m_registry.find(typid);
-            if (type == m_registry.end())
-                throw std::runtime_error("Resource type not found.");
-            const auto resource = type->second.find(name);
-            if (resource == type->second.end())
-                throw std::runtime_error("Resource not found.");
-            return std::any_cast<const T&>(resource->second);
+            return get(getHandle<T>(name));
+        }
+
+        /**
+         * @brief Remove a resource, its handles become stale.
+         * @param handle The handle of the resource.
+         * @return Whether the resource existed.
+         */
+        template<typename T>
+        bool removeResource(ResourceHandle<T> handle) {
+            return pool<T>().remove(handle);
+        }
+
+        /**
+         * @brief Remove a resource, its handles become stale.
+         * @param name The name of the resource.
+         * @return Whether the resource existed.
+         */
+        template<typename T>
+        bool removeResource(const ResourceName& name) {
+            auto& resources = pool<T>();
+            return resources.remove(resources.find(name));
+        }
+
+        /**
+         * @brief Find the resources of a namespace, in the order of their names.
+         * @param prefix The prefix of their names ("level3/enemies/").
+         * @return The handles of the resources.
+         */
+        template<typename T>
+        std::vector<ResourceHandle<T>> findResources(std::string_view prefix) const {
+            std::vector<ResourceHandle<T>> handles;
+            if (const auto *resources = findPool<T>())
+                resources->forEach(prefix, [&handles](const ResourceName&, ResourceHandle<T> handle) {
+                    handles.push_back(handle);
+                });
+            return handles;
+        }
+
+        /**
+         * @brief Remove the resources of a namespace, their handles become stale.
+         * @param prefix The prefix of their names ("level3/").
+         * @return The number of resources removed.
+         */
+        template<typename T>
+        usize removeResources(std::string_view prefix) {
+            auto *resources = findPoolBase<T>();
+            return resources ? resources->removePrefix(prefix) : 0;
+        }
+
+        /**
+         * @brief Remove the resources of a namespace of every type, their handles become stale.
+         *        The time taken is proportional to the number of resources removed.
+         * @param prefix The prefix of their names ("level3/").
+         * @return The number of resources removed.
+         */
+        usize removeResources(std::string_view prefix) {
+            usize count = 0;
+            for (auto& resources : m_pools) {
+                if (resources)
+                    count += resources->removePrefix(prefix);
+            }
+            return count;
+        }
+
+        /**
+         * @brief Set the budget of every type together, enforced by collect().
+         * @param budget The budget, 0 for unlimited.
+         * @return Reference to self.
+         */
+        ResourceManager& setBudget(const ResourceBytes& budget) {
+            m_budget = budget;
+            return *this;
+        }
+
+        /**
+         * @brief Set the budget of a type, enforced by collect().
+         * @param budget The budget, 0 for unlimited.
+         * @return Reference to self.
+         */
+        template<typename T>
+        ResourceManager& setBudget(const ResourceBytes& budget) {
+            pool<T>().setBudget(budget);
+            return *this;
+        }
+
+        /**
+         * @brief Get the budget of every type together.
+         * @return The budget, 0 for unlimited.
+         */
+        const ResourceBytes& getBudget() const {
+            return m_budget;
+        }
+
+        /**
+         * @brief Get the memory held by the loaded resources.
+         * @return The bytes.
+         */
+        ResourceBytes usage() const {
+            ResourceBytes total;
+            for (const auto& resources : m_pools) {
+                if (resources)
+                    total += resources->bytes();
+            }
+            return total;
+        }
+
+        /**
+         * @brief Get the memory held by the loaded resources of a type.
+         * @return The bytes.
+         */
+        template<typename T>
+        ResourceBytes usage() const {
+            const auto *resources = findPoolBase<T>();
+            return resources ? resources->bytes() : ResourceBytes();
+        }
+
+        /**
+         * @brief Get the memory held by a resource.
+         * @param handle The handle of the resource.
+         * @return The bytes, 0 if the resource is evicted.
+         */
+        template<typename T>
+        ResourceBytes usage(ResourceHandle<T> handle) const {
+            const auto *resources = findPool<T>();
+            return resources ? resources->bytes(handle) : ResourceBytes();
+        }
+
+        /**
+         * @brief Is a resource evicted? Its next access reloads it.
+         * @param handle The handle of the resource.
+         * @return Whether the resource is evicted.
+         */
+        template<typename T>
+        bool isEvicted(ResourceHandle<T> handle) const {
+            const auto *resources = findPool<T>();
+            return resources && resources->isEvicted(handle);
+        }
+
+        /**
+         * @brief Measure the resources and evict the least recently used ones until every
+         *        budget is met. References to evicted resources dangle, so call it where
+         *        none is held, once per frame for instance.
+         * @return The number of resources evicted.
+         */
+        usize collect() {
+            std::vector<EvictionCandidate> candidates;
+            usize count = 0;
+
+            for (auto& resources : m_pools) {
+                if (!resources)
+                    continue;
+
+                const usize first = candidates.size();
+
+                resources->collect(candidates);
+                if (resources->bytes().exceeds(resources->getBudget())) {
+                    std::vector<EvictionCandidate> own(candidates.begin() + first, candidates.end());
+                    ResourceBytes bytes = resources->bytes();
+
+                    count += evict(own, bytes, resources->getBudget());
+                    candidates.resize(first);
+                    for (const auto& candidate : own) {
+                        if (candidate.pool)
+                            candidates.push_back(candidate);
+                    }
+                }
+            }
+
+            ResourceBytes bytes = usage();
+
+            if (bytes.exceeds(m_budget))
+                count += evict(candidates, bytes, m_budget);
+            m_evicted += count;
+            return count;
+        }
+
+        /**
+         * @brief Set the callback called the first time each resource is accessed by handle
+         *        or by name (see PreloadRecorder).
+         * @param callback The callback, empty to stop tracing.
+         * @return Reference to self.
+         */
+        ResourceManager& onFirstUse(const std::function<void(const ResourceName&)>& callback) {
+            m_first_use = callback;
+            return *this;
+        }
+
+        /**
+         * @brief Get the number of resources evicted since the manager was created.
+         * @return The number of evictions.
+         */
+        usize evicted() const {
+            return m_evicted;
         }
 
         /**
-         * @brief Clear the registry.
+         * @brief Clear the registry, every handle becomes stale.
          */
         void clear() {
-            m_registry.clear();
+            for (auto& resources : m_pools) {
+                if (resources)
+                    resources->clear();
+            }
         }
     };
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <SFML/System/Clock.hpp>
+#include <SFML/System/Time.hpp>
+
+#include <array>
+
+#include "./meta.h"
+
+namespace kat {
+
+    /**
+     * @brief Fps limit.
+     */
+    using FpsLimit = u32;
+
+    /**
+     * @brief A duration measured by the frame scheduler.
+     */
+    using FrameDuration = sf::Time;
+
+    /**
+     * @brief Schedules frames so that the work of a frame happens as late as possible.
+     *
+     * Instead of working at the start of a frame and then idling until the framerate
+     * limit releases it, the scheduler predicts how long the simulation and the rendering
+     * of a frame take (from the most expensive of the recent frames) and sleeps until just
+     * before the presentation deadline minus that prediction.
+     * Input sampled right after latch() is therefore as fresh as possible when the frame is
+     * presented.
+     *
+     *      window.setFps(144);
+     *      while (window.isOpen()) {
+     *          InputManager::updateLatched(window); // latch() + update()
+     *          simulate();
+     *          render();
+     *          window.display(); // present()
+     *      }
+     */
+    class FrameScheduler {
+    public:
+        /**
+         * @brief The number of frames used to predict the cost of the next one.
+         */
+        static constexpr usize HistorySize = 16;
+
+        /**
+         * @brief Sets the target framerate, 0 disables the scheduling.
+         *
+         * @param limit The framerate limit.
+         * @return FrameScheduler& Reference to self.
+         */
+        FrameScheduler& setFps(const FpsLimit& limit);
+
+        /**
+         * @brief Gets the target framerate.
+         *
+         * @return FpsLimit The framerate limit, 0 if unlimited.
+         */
+        FpsLimit getFps() const;
+
+        /**
+         * @brief Sets the time kept in reserve on top of the predicted frame cost.
+         *        Absorbs the jitter of the prediction and of the os scheduler.
+         *
+         * @param margin The safety margin.
+         * @return FrameScheduler& Reference to self.
+         */
+        FrameScheduler& setSafetyMargin(const FrameDuration& margin);
+
+        /**
+         * @brief Blocks until the latest moment the next frame can start
+         *        and still be presented on time.
+         */
+        void latch();
+
+        /**
+         * @brief Marks the frame as presented, records its cost and
+         *        advances the deadline.
+         */
+        void present();
+
+        /**
+         * @brief Gets the predicted cost of the next frame.
+         *
+         * @return FrameDuration The predicted cost.
+         */
+        FrameDuration predictedCost() const;
+
+        /**
+         * @brief Gets the measured cost of the last frame (from latch to present).
+         *
+         * @return FrameDuration The cost of the last frame.
+         */
+        FrameDuration lastCost() const;
+
+        FrameScheduler() = default;
+        ~FrameScheduler() = default;
+
+    private:
+        sf::Clock m_clock;
+        FrameDuration m_period = FrameDuration::Zero; ///< Time between two presents.
+        FrameDuration m_deadline = FrameDuration::Zero; ///< Next present time on m_clock.
+        FrameDuration m_latched = FrameDuration::Zero; ///< Time the current frame was latched at.
+        FrameDuration m_margin = sf::microseconds(1000);
+        std::array<FrameDuration, HistorySize> m_history {};
+        usize m_history_index = 0;
+        bool m_started = false;
+    };
+}
@@ -5,8 +5,10 @@
 #include "../input.h"
 #include "../math.h"
 #include "../meta.h"
+#include "../pak.h"
 #include "../resource.h"
 #include "../version.h"
+#include "../vfs.h"
 #include "../window.h"
 
 namespace kat {
@@ -127,6 +129,58 @@ namespace kat {
             );
         }
 
+        void load_pak_api()
+        {
+            m_kat.new_usertype<Pak>("Pak",
+                sol::constructors<Pak()>(),
+                "open", &Pak::open,
+                "close", &Pak::close,
+                "size", &Pak::size,
+                "contains",
+                [](const Pak& self, const std::string& name) { return self.contains(name); },
+                "texture",
+                [](const Pak& self, const std::string& name) { return self.texture(name); },
+                "script",
+                [this](const Pak& self, const std::string& name) {
+                    std::vector<u8> scratch;
+                    const auto chunk = self.data(name, scratch);
+
+                    // Scripts are baked to bytecode, sources are refused
+                    return m_state.load(std::string_view(reinterpret_cast<const char *>(chunk.data()), chunk.size()),
+                                        "@" + name, sol::load_mode::binary);
+                }
+            );
+        }
+
+        void load_vfs_api()
+        {
+            m_kat.new_usertype<VirtualFileSystem>("VirtualFileSystem",
+                sol::no_constructor,
+                "mountDirectory",
+                [](VirtualFileSystem& self, const std::string& point, const std::string& directory) {
+                    self.mountDirectory(point, directory);
+                },
+                "mountPak", &VirtualFileSystem::mountPak,
+                "unmount",
+                [](VirtualFileSystem& self, const std::string& point) { self.unmount(point); },
+                "exists", &VirtualFileSystem::exists,
+                "read",
+                [](VirtualFileSystem& self, const std::string& path) {
+                    return std::string(self.readNow(path).view());
+                },
+                "texture",
+                [](VirtualFileSystem& self, const std::string& path) { return self.readNow(path).texture(); },
+                "script",
+                [this](VirtualFileSystem& self, const std::string& path) {
+                    const VfsBuffer chunk = self.readNow(path);
+
+                    // Sources and bytecode are loaded from the buffer of the read
+                    return m_state.load(chunk.view(), "@" + path);
+                }
+            );
+            m_kat.set_function("vfs", []() -> VirtualFileSystem& { return VirtualFileSystem::instance(); });
+        }
+
         void load_texture_component()
         {
             generate_rect<i32>("Frame");
@@ -330,6 +384,10 @@ namespace kat {
                 [](Sprite& self) {
                     return self.getColor();
                 },
+                "setEffect",
+                [](Sprite& self, u8 effect, f32 strength, const Color& color) {
+                    return self.setEffect((SpriteEffect)effect, strength, color);
+                },
                 "getGlobalBounds",
                 [](Sprite& self) {
                     return self.getGlobalBounds();
@@ -407,6 +465,10 @@ namespace kat {
                 [](Animator& self) {
                     return self.isLooping();
                 },
+                "trimAnimations",
+                [](Animator& self) {
+                    return self.trimAnimations();
+                },
                 "addAnimationSpritesheetPro",
                 [](Animator& self, const AnimationName& name,
                     const FrameIndexList& frames, const FrameSize& frameSize,
@@ -575,6 +637,8 @@ namespace kat {
             load_basic_rect_types();
             load_basic_vector_types();
             load_texture_component();
+            load_pak_api();
+            load_vfs_api();
             load_sprite_component();
             load_animator_component();
             load_batch_renderer_api();
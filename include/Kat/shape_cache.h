@@ -0,0 +1,190 @@
+#pragma once
+
+#include <SFML/Graphics/Drawable.hpp>
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/Shape.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/Graphics/Vertex.hpp>
+
+#include "./meta.h"
+#include "./vector.h"
+
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief The key of a tessellated shape, a hash of the parameters of the shape.
+     */
+    using ShapeKey = u64;
+
+    /**
+     * @brief A shape tessellated into triangle lists, in the local space of the shape.
+     */
+    struct ShapeMesh {
+        std::vector<Vector2f> fill;    ///< Triangles of the inside of the shape.
+        std::vector<Vector2f> outline; ///< Triangles of the outline, empty without outline.
+        FloatRect bounds;              ///< Local bounds of the inside, used to map texture coordinates.
+    };
+
+    /**
+     * @brief Tessellates shapes once and keeps the result keyed by the shape parameters
+     *        (radius and point count of circles, size of rectangles, points of convex shapes,
+     *        outline thickness). The parameters are kept with each mesh and compared on
+     *        hits, so shapes whose keys collide never share a mesh.
+     *        Transforms and colors are not part of the key, they are applied per instance.
+     */
+    class ShapeCache {
+    public:
+        /**
+         * @brief The number of meshes after which the cache is flushed.
+         */
+        static constexpr usize MaxEntries = 4096;
+
+        /**
+         * @brief Gets the tessellation of a shape, tessellates it on a miss.
+         *
+         * @param shape The shape.
+         * @return const ShapeMesh& The mesh of the shape.
+         */
+        const ShapeMesh& get(const sf::Shape& shape);
+
+        /**
+         * @brief Gets the number of cached meshes.
+         *
+         * @return usize The number of meshes.
+         */
+        usize size() const;
+
+        /**
+         * @brief Gets the number of lookups answered by the cache.
+         *
+         * @return usize The number of hits.
+         */
+        usize hits() const;
+
+        /**
+         * @brief Gets the number of lookups that needed a tessellation.
+         *
+         * @return usize The number of misses.
+         */
+        usize misses() const;
+
+        /**
+         * @brief Clears the cache.
+         */
+        void clear();
+
+        ShapeCache() = default;
+        ~ShapeCache() = default;
+
+    private:
+        /**
+         * @brief A mesh and the parameters of its shape.
+         */
+        struct Entry {
+            std::vector<float> parameters;
+            ShapeMesh mesh;
+        };
+
+        std::unordered_map<ShapeKey, Entry> m_meshes;
+        std::vector<float> m_parameters; ///< The parameters of the last shape looked up, reused.
+        usize m_hits = 0;
+        usize m_misses = 0;
+    };
+
+    /**
+     * @brief A run of consecutive shapes sharing a texture, drawn in a single draw call.
+     *        Sprites drawn with the uber shader are tessellated into runs too, the effect
+     *        of each vertex is uploaded to an effect texture, a texel per vertex.
+     */
+    class ShapeBatch : public sf::Drawable {
+    public:
+        /**
+         * @brief Constructs a new Shape Batch object.
+         * @param texture The texture of the run, null for untextured shapes.
+         */
+        ShapeBatch(const sf::Texture* texture = nullptr);
+
+        /**
+         * @brief Appends triangles to the run.
+         *
+         * @param triangles The triangles, in the local space of the instance.
+         * @param transform The transform of the instance.
+         * @param color The color of the instance.
+         */
+        void append(std::span<const Vector2f> triangles, const sf::Transform& transform,
+                    const sf::Color& color);
+
+        /**
+         * @brief Appends textured triangles to the run.
+         *
+         * @param triangles The triangles, in the local space of the instance.
+         * @param transform The transform of the instance.
+         * @param color The color of the instance.
+         * @param bounds The local rect mapped onto the texture rect.
+         * @param texture_rect The texture rect.
+         */
+        void append(std::span<const Vector2f> triangles, const sf::Transform& transform,
+                    const sf::Color& color, const FloatRect& bounds, const IntRect& texture_rect);
+
+        /**
+         * @brief Appends textured triangles with an effect of the uber shader.
+         *
+         * @param triangles The triangles, in the local space of the instance.
+         * @param transform The transform of the instance.
+         * @param color The color of the instance.
+         * @param bounds The local rect mapped onto the texture rect.
+         * @param texture_rect The texture rect.
+         * @param effect The effect of the instance (see encodeEffect()).
+         */
+        void append(std::span<const Vector2f> triangles, const sf::Transform& transform,
+                    const sf::Color& color, const FloatRect& bounds, const IntRect& texture_rect,
+                    const sf::Color& effect);
+
+        /**
+         * @brief Empties the run and sets its texture, the memory is kept.
+         * @param texture The texture of the run.
+         * @param shader The shader of the run.
+         */
+        void reset(const sf::Texture* texture = nullptr, sf::Shader* shader = nullptr);
+
+        /**
+         * @brief Gets the shader of the run.
+         * @return sf::Shader* The shader, null for the default pipeline.
+         */
+        sf::Shader* getShader() const;
+
+        /**
+         * @brief Gets the texture of the run.
+         * @return const sf::Texture* The texture, null for untextured shapes.
+         */
+        const sf::Texture* getTexture() const;
+
+        /**
+         * @brief Gets the vertices of the run, a triangle list in world coordinates.
+         * @return std::span<const sf::Vertex> The vertices.
+         */
+        std::span<const sf::Vertex> getVertices() const;
+
+        /**
+         * @brief Gets the bounds of the run, in world coordinates.
+         * @return FloatRect The bounds.
+         */
+        FloatRect getGlobalBounds() const;
+
+    protected:
+        void draw(sf::RenderTarget& target, const sf::RenderStates& states) const override;
+
+    private:
+        const sf::Texture* m_texture = nullptr;
+        sf::Shader* m_shader = nullptr;
+        std::vector<sf::Vertex> m_vertices;
+        mutable std::vector<sf::Color> m_effects; ///< The effect of each vertex, for the uber shader.
+        mutable sf::Texture m_effect_texture;
+        Vector2f m_min;
+        Vector2f m_max;
+    };
+}
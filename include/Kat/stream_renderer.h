@@ -0,0 +1,169 @@
+#pragma once
+
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/Graphics/Vertex.hpp>
+#include <SFML/Graphics/View.hpp>
+
+#include "./meta.h"
+
+#include <span>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief The vertex layouts uploaded by the stream renderer.
+     */
+    enum class VertexFormat {
+        Full,   ///< The layout of sf::Vertex, 20 bytes.
+        Compact ///< CompactVertex, 12 bytes.
+    };
+
+    /**
+     * @brief A vertex with 16-bit positions and texture coordinates and an 8-bit color.
+     *        Positions are fixed point (see StreamRenderer::PositionScale) relative to the
+     *        top left of their draw call, texture coordinates are normalized.
+     */
+    struct CompactVertex {
+        u16 x, y;
+        u16 u, v;
+        u8 r, g, b, a;
+    };
+
+    static_assert(sizeof(CompactVertex) == 12);
+
+    /**
+     * @brief Draws triangle lists with plain gl calls instead of sf::RenderTarget::draw,
+     *        streaming the vertices through a ring buffer.
+     *
+     *        The ring buffer is persistently mapped (gl 4.4 or ARB_buffer_storage) and
+     *        split into sections guarded by fences, so vertices are written straight
+     *        into memory the gpu reads from, without any driver copy. Without buffer
+     *        storage the buffer is orphaned when it wraps around instead.
+     *        Needs gl 3.0 and glsl 1.30, which Mesa llvmpipe provides.
+     *
+     *        Draws bypass the state cache of sfml, call sf::RenderTarget::resetGLStates()
+     *        before drawing with sfml again (BatchRenderer does it).
+     */
+    class StreamRenderer {
+    public:
+        /**
+         * @brief The size of a section of the ring buffer, in bytes.
+         */
+        static constexpr usize SectionSize = 1 << 21;
+
+        /**
+         * @brief The number of sections of the ring buffer,
+         *        a section is written again once the gpu is done reading it.
+         */
+        static constexpr usize Sections = 3;
+
+        /**
+         * @brief The number of compact position units per pixel.
+         */
+        static constexpr u32 PositionScale = 4;
+
+        /**
+         * @brief Creates the buffer and the program in the context of a target.
+         *        Vertex arrays are not shared between contexts, the renderer draws to
+         *        this target only and has to be destroyed while its context lives.
+         *
+         * @param target The target, usually the window.
+         * @return bool Whether the renderer can be used.
+         */
+        bool create(sf::RenderTarget& target);
+
+        /**
+         * @brief Is the renderer created?
+         *
+         * @return true The renderer can draw.
+         * @return false The renderer is not created or the context is too old.
+         */
+        bool isAvailable() const;
+
+        /**
+         * @brief Is the ring buffer persistently mapped?
+         *
+         * @return true The buffer is persistently mapped.
+         * @return false The buffer is orphaned instead.
+         */
+        bool isPersistent() const;
+
+        /**
+         * @brief Sets the vertex format.
+         *        Compact vertices are 40% smaller, their positions are rounded to a
+         *        quarter of a pixel. Draws spanning more than 16383 pixels, or with texture
+         *        coordinates outside of the texture (repeated textures), fall back
+         *        to the full format.
+         *
+         * @param format The vertex format.
+         * @return StreamRenderer& Reference to self.
+         */
+        StreamRenderer& setVertexFormat(VertexFormat format);
+
+        /**
+         * @brief Gets the vertex format.
+         *
+         * @return VertexFormat The vertex format.
+         */
+        VertexFormat getVertexFormat() const;
+
+        /**
+         * @brief Draws a triangle list with alpha blending.
+         *
+         * @param target The target to draw to, other targets than the one of create()
+         *                are drawn to through sfml.
+         * @param view The view to draw with.
+         * @param triangles The vertices, in world coordinates.
+         * @param texture The texture, null for untextured triangles.
+         */
+        void draw(sf::RenderTarget& target, const sf::View& view,
+                  std::span<const sf::Vertex> triangles, const sf::Texture* texture);
+
+        /**
+         * @brief Gets the number of bytes uploaded since the renderer was created.
+         *
+         * @return usize The number of bytes.
+         */
+        usize uploaded() const;
+
+        StreamRenderer() = default;
+        ~StreamRenderer();
+
+        StreamRenderer(const StreamRenderer&) = delete;
+        StreamRenderer& operator=(const StreamRenderer&) = delete;
+
+    private:
+        /**
+         * @brief Reserves space in the ring buffer.
+         *
+         * @param size The number of bytes, at most a section.
+         * @return usize The offset of the space in the buffer.
+         */
+        usize reserve(usize size);
+
+        void upload(usize offset, const void *data, usize size);
+
+        bool m_available = false;
+        sf::RenderTarget* m_target = nullptr; ///< The target whose context owns the vertex array.
+        bool m_persistent = false;
+        VertexFormat m_format = VertexFormat::Compact;
+
+        u32 m_buffer = 0;
+        u32 m_vao = 0;
+        u32 m_program = 0;
+        u8 *m_mapped = nullptr;    ///< The persistently mapped ring buffer.
+        usize m_offset = 0;        ///< The next free byte of the ring buffer.
+        void *m_fences[Sections] = {}; ///< The fence of every section, once it was left.
+        usize m_uploaded = 0;
+
+        std::vector<CompactVertex> m_compact; ///< Scratch vertices when the buffer is not mapped.
+
+        i32 m_projection_location = -1;
+        i32 m_texture_matrix_location = -1;
+        i32 m_origin_location = -1;
+        i32 m_scale_location = -1;
+        i32 m_textured_location = -1;
+    };
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <SFML/Graphics/Image.hpp>
+
+#include "./components/texture.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief The state of an upload.
+     */
+    enum class UploadState : u8 {
+        Queued,    ///< Waiting for the uploader thread.
+        Uploading, ///< Submitted to the gpu, waiting for its fence.
+        Ready,     ///< The texture can be drawn by any context.
+        Failed     ///< The texture could not be created.
+    };
+
+    /**
+     * @brief A single upload, shared by the uploader and its handles.
+     */
+    struct UploadTask {
+        std::function<bool(Texture&)> upload; ///< Run by the uploader thread.
+        Texture texture;
+        std::atomic<UploadState> state = UploadState::Queued;
+    };
+
+    /**
+     * @brief A handle to an upload.
+     */
+    class UploadHandle {
+    public:
+        /**
+         * @brief Gets the state of the upload.
+         * @return UploadState The state.
+         */
+        UploadState state() const;
+
+        /**
+         * @brief Is the upload ready?
+         * @return true The texture can be drawn.
+         * @return false The upload is pending or failed.
+         */
+        bool isReady() const;
+
+        /**
+         * @brief Blocks until the upload is ready or failed.
+         * @return bool Whether the upload is ready.
+         */
+        bool wait() const;
+
+        /**
+         * @brief Gets the texture of the upload, only drawable once ready.
+         * @return const Texture& The texture.
+         */
+        const Texture& texture() const;
+
+        UploadHandle() = default;
+        UploadHandle(const std::shared_ptr<UploadTask>& task);
+
+    private:
+        std::shared_ptr<UploadTask> m_task;
+    };
+
+    /**
+     * @brief Creates and updates textures on a thread owning its own gl context,
+     *        shared with the contexts of sfml, so large uploads do not stall the render thread.
+     *
+     *        Each upload is followed by a fence: an upload is published as ready once the gpu
+     *        passed its fence, from then on every context sees the texture.
+     *        Without fences (gl older than 3.2) the uploader thread waits for the gpu instead.
+     */
+    class TextureUploader {
+    public:
+        /**
+         * @brief Starts the uploader thread.
+         */
+        TextureUploader();
+
+        /**
+         * @brief Finishes the queued uploads and joins the uploader thread.
+         */
+        ~TextureUploader();
+
+        TextureUploader(const TextureUploader&) = delete;
+        TextureUploader& operator=(const TextureUploader&) = delete;
+
+        /**
+         * @brief Creates a texture from an image.
+         *
+         * @param image The image, moved to the uploader thread.
+         * @param smooth Whether the texture is smooth.
+         * @return UploadHandle The handle of the upload.
+         */
+        UploadHandle create(sf::Image image, bool smooth = false);
+
+        /**
+         * @brief Updates an area of a texture.
+         *
+         * @param texture The texture, regions are honored (see Texture::setRegion()).
+         * @param pixels The rgba pixels of the area, moved to the uploader thread.
+         * @param area The area of the texture.
+         * @return UploadHandle The handle of the upload.
+         */
+        UploadHandle update(const Texture& texture, std::vector<u8> pixels, const Frame& area);
+
+        /**
+         * @brief Gets the number of uploads that are not ready yet.
+         * @return usize The number of uploads.
+         */
+        usize pending() const;
+
+    private:
+        UploadHandle submit(const std::shared_ptr<UploadTask>& task);
+
+        void work();
+
+        std::thread m_thread;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::deque<std::shared_ptr<UploadTask>> m_queue;
+        std::atomic<usize> m_pending = 0;
+        bool m_stop = false;
+    };
+}
@@ -0,0 +1,322 @@
+#pragma once
+
+#include "./components/texture.h"
+#include "./pak.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief How the files of mounted directories are read.
+     */
+    enum class VfsBackend : u8 {
+        Auto,      ///< io_uring when the kernel provides it, the thread pool otherwise.
+        IoUring,   ///< Batches of reads submitted to the kernel with a single syscall (Linux).
+        ThreadPool ///< Blocking reads on the workers of the file system.
+    };
+
+    /**
+     * @brief The state of a read.
+     */
+    enum class VfsState : u8 {
+        Pending, ///< Queued, or submitted to the kernel.
+        Ready,   ///< The buffer holds the whole file.
+        Failed   ///< The file does not exist or could not be read.
+    };
+
+    /**
+     * @brief The bytes of a file, shared without copies.
+     *
+     *        Files of directories are read into a buffer of their own, uncompressed
+     *        entries of paks are views of the mapping of the pak, which stays mapped
+     *        as long as a buffer points into it.
+     */
+    class VfsBuffer {
+    public:
+        /**
+         * @brief Gets the bytes.
+         * @return std::span<const u8> The bytes.
+         */
+        std::span<const u8> bytes() const;
+
+        /**
+         * @brief Gets the bytes as characters, for text and scripts.
+         * @return std::string_view The bytes.
+         */
+        std::string_view view() const;
+
+        const u8 *data() const;
+
+        usize size() const;
+
+        bool empty() const;
+
+        /**
+         * @brief Creates a texture straight from the bytes (an encoded or a raw image).
+         * @param area The area of the image to load, empty for the whole image.
+         * @return Texture The texture, null if the bytes are not an image.
+         */
+        Texture texture(const Frame& area = Frame()) const;
+
+        VfsBuffer() = default;
+        VfsBuffer(std::shared_ptr<const void> owner, std::span<const u8> bytes);
+
+    private:
+        std::shared_ptr<const void> m_owner; ///< Keeps the bytes alive.
+        std::span<const u8> m_bytes;
+    };
+
+    /**
+     * @brief A single read, shared by the file system and its handles.
+     */
+    struct VfsTask {
+        std::string path;
+        std::atomic<VfsState> state = VfsState::Pending;
+        VfsBuffer buffer;
+        std::string error;
+    };
+
+    /**
+     * @brief A handle to a read.
+     */
+    class VfsRead {
+    public:
+        /**
+         * @brief Gets the state of the read.
+         * @return VfsState The state.
+         */
+        VfsState state() const;
+
+        /**
+         * @brief Is the read ready?
+         * @return true The buffer holds the file.
+         * @return false The read is pending or failed.
+         */
+        bool isReady() const;
+
+        /**
+         * @brief Blocks until the read is ready or failed.
+         * @return bool Whether the read is ready.
+         */
+        bool wait() const;
+
+        /**
+         * @brief Gets the bytes of the file, once ready.
+         * @return const VfsBuffer& The bytes.
+         */
+        const VfsBuffer& buffer() const;
+
+        /**
+         * @brief Gets the path of the file.
+         * @return const std::string& The path.
+         */
+        const std::string& path() const;
+
+        /**
+         * @brief Gets the reason of a failure.
+         * @return const std::string& The error, empty unless the read failed.
+         */
+        const std::string& error() const;
+
+        VfsRead() = default;
+        VfsRead(const std::shared_ptr<VfsTask>& task);
+
+    private:
+        std::shared_ptr<VfsTask> m_task;
+    };
+
+    /**
+     * @brief The io_uring of the file system, see vfs.cpp.
+     */
+    struct VfsRing;
+
+    /**
+     * @brief Serves the files of mounted directories and paks asynchronously.
+     *
+     *        Paths are resolved against the mounts, the last mount first, so mods and
+     *        patches mounted last override the base game. On Linux the files of directories
+     *        are read through io_uring: a thread opens the files of every pending read and
+     *        submits all their reads with one syscall, so thousands of small reads keep
+     *        the disk busy instead of waiting for each other. Elsewhere, when the kernel
+     *        headers of the build lack io_uring (see CMakeLists.txt), or when io_uring is
+     *        not allowed, workers read the files with blocking calls.
+     *        Entries of paks are served from their mapping, compressed ones are
+     *        decompressed by the workers.
+     */
+    class VirtualFileSystem {
+    public:
+        /**
+         * @brief The maximum number of reads submitted to the kernel at once.
+         */
+        static constexpr u32 RingSize = 256;
+
+        /**
+         * @brief Constructs a new Virtual File System object.
+         *
+         * @param backend How the files of directories are read.
+         * @param threads The number of workers (blocking reads, decompression).
+         */
+        VirtualFileSystem(VfsBackend backend = VfsBackend::Auto, usize threads = 2);
+
+        /**
+         * @brief Fails the pending reads and joins the threads.
+         */
+        ~VirtualFileSystem();
+
+        VirtualFileSystem(const VirtualFileSystem&) = delete;
+        VirtualFileSystem& operator=(const VirtualFileSystem&) = delete;
+
+        /**
+         * @brief Mounts a directory.
+         *
+         * @param point The path the directory is mounted at ("" or "mods/").
+         * @param directory The directory.
+         * @return VirtualFileSystem& Reference to self.
+         */
+        VirtualFileSystem& mountDirectory(const std::string& point, const std::string& directory);
+
+        /**
+         * @brief Mounts a pak, its entries are named relative to the mount point.
+         *
+         * @param point The path the pak is mounted at.
+         * @param filename The filename of the pak.
+         * @return bool Whether the pak could be opened.
+         */
+        bool mountPak(const std::string& point, const std::string& filename);
+
+        /**
+         * @brief Unmounts everything mounted at a path. Pending reads are not affected.
+         *
+         * @param point The mount point.
+         * @return VirtualFileSystem& Reference to self.
+         */
+        VirtualFileSystem& unmount(const std::string& point);
+
+        /**
+         * @brief Does a file exist? Blocks on the file system for directories.
+         *
+         * @param path The path of the file.
+         * @return bool Whether a mount holds the file.
+         */
+        bool exists(const std::string& path) const;
+
+        /**
+         * @brief Reads a file asynchronously.
+         *
+         * @param path The path of the file.
+         * @return VfsRead The handle of the read.
+         */
+        VfsRead read(const std::string& path);
+
+        /**
+         * @brief Reads files asynchronously, submitted together.
+         *
+         * @param paths The paths of the files.
+         * @return std::vector<VfsRead> The handles of the reads, in the same order.
+         */
+        std::vector<VfsRead> read(const std::vector<std::string>& paths);
+
+        /**
+         * @brief Reads a file, blocking the calling thread.
+         *
+         * @param path The path of the file.
+         * @return VfsBuffer The bytes, empty if the file could not be read.
+         */
+        VfsBuffer readNow(const std::string& path);
+
+        /**
+         * @brief Gets the backend reading the files of directories.
+         * @return VfsBackend IoUring or ThreadPool.
+         */
+        VfsBackend backend() const;
+
+        /**
+         * @brief Returns a reference to the shared file system, created on first use.
+         * @return VirtualFileSystem& The file system.
+         */
+        static VirtualFileSystem& instance();
+
+        /**
+         * @brief Destroys the shared file system.
+         */
+        static void destroy();
+
+    private:
+        struct Mount {
+            std::string point;
+            std::string directory;
+            std::shared_ptr<Pak> pak;
+        };
+
+        using Mounts = std::vector<Mount>;
+
+        /**
+         * @brief Where a file may be, the files of directories first, then at most one pak.
+         */
+        struct Source {
+            std::string file;             ///< The file in a directory, empty for a pak.
+            std::shared_ptr<Pak> pak;
+            std::string_view entry;       ///< The name of the entry in the pak.
+        };
+
+        /**
+         * @brief Gets the mounts, a snapshot that mounting does not modify.
+         */
+        std::shared_ptr<const Mounts> mounts() const;
+
+        static std::vector<Source> sources(const std::string& path, const Mounts& mounts);
+
+        void submit(const std::vector<std::shared_ptr<VfsTask>>& tasks);
+
+        /**
+         * @brief Opens the file of a read for the io_uring thread. Reads served by a pak
+         *        are completed, or left to the workers when they have to be decompressed.
+         * @return int The file descriptor, -1 if the read is not left to io_uring.
+         */
+        int open(const std::shared_ptr<VfsTask>& task, const Mounts& mounts);
+
+        /**
+         * @brief Reads a file with blocking calls, on a worker.
+         */
+        static void readBlocking(VfsTask& task, const Mounts& mounts);
+
+        static void readPak(VfsTask& task, const std::shared_ptr<Pak>& pak, std::string_view entry);
+
+        static void complete(VfsTask& task, VfsBuffer buffer);
+
+        static void fail(VfsTask& task, const std::string& error);
+
+        void work();
+
+        void react();
+
+        VfsBackend m_backend = VfsBackend::ThreadPool;
+        std::unique_ptr<VfsRing> m_ring;
+
+        mutable std::mutex m_mounts_mutex;
+        std::shared_ptr<const Mounts> m_mounts;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake;                  ///< Wakes the workers.
+        std::condition_variable m_react;                 ///< Wakes the io_uring thread.
+        std::deque<std::function<void()>> m_queue;       ///< Jobs of the workers.
+        std::deque<std::shared_ptr<VfsTask>> m_pending;  ///< Reads for the io_uring thread.
+        bool m_stop = false;                             ///< Stops the io_uring thread.
+        bool m_stop_workers = false;                     ///< Stops the workers once their jobs are done.
+        std::vector<std::thread> m_workers;
+        std::thread m_reactor;
+
+        static VirtualFileSystem *m_Instance;
+    };
+}
@@ -6,8 +6,12 @@
 #include <SFML/Window/VideoMode.hpp>
 
 #include "./meta.h"
+#include "./scheduler.h"
+#include "./stream_renderer.h"
 #include "./vector.h"
 
+#include <memory>
+
 namespace kat {
 
     template<typename DrawableObject, typename _Window>
@@ -52,11 +56,6 @@ namespace kat {
         Default = sf::Style::Default
     };
 
-    /**
-     * @brief Fps limit.
-     */
-    using FpsLimit = u32;
-
     /**
      * @brief A window size.
      */
@@ -102,6 +101,12 @@ namespace kat {
          */
         Window(WindowHandle handle, const ContextSettings& settings = ContextSettings());
 
+        /**
+         * @brief Destroys the textures still waiting in the TextureReleaseQueue
+         *        while the context of the window lives.
+         */
+        ~Window();
+
         /**
          * @brief Closes the window.
          * 
@@ -128,12 +133,65 @@ namespace kat {
 
         /**
          * @brief Sets the framerate limit of the window.
+         *        Sfml enforces the limit by sleeping after the frame was displayed, until
+         *        latch() is called for the first time. From then on the frame scheduler
+         *        enforces it (see latch() and display()), frames have to be displayed
+         *        through display().
          * 
          * @param limit The framerate limit.
          * @return Window& Reference to self.
          */
         Window& setFps(const FpsLimit& limit);
 
+        /**
+         * @brief Waits until the latest moment the next frame can start.
+         *        Input should be sampled right after this call.
+         *        The first call hands the framerate limit over to the frame scheduler.
+         * 
+         * @return Window& Reference to self.
+         */
+        Window& latch();
+
+        /**
+         * @brief Clears the window.
+         * 
+         * @param color The color to clear the window with.
+         * @return Window& Reference to self.
+         */
+        Window& clear(const sf::Color& color = sf::Color::Black);
+
+        /**
+         * @brief Displays what was drawn to the window, destroys the textures released
+         *        during the frame (see TextureReleaseQueue) and notifies the frame scheduler
+         *        once latch() is in use.
+         * 
+         * @return Window& Reference to self.
+         */
+        Window& display();
+
+        /**
+         * @brief Ends a frame presented without display() (through get_handle().display()
+         *        or by another library): destroys the textures released during the frame.
+         *        display() calls it.
+         * 
+         * @return Window& Reference to self.
+         */
+        Window& endFrame();
+
+        /**
+         * @brief Gets the frame scheduler of the window.
+         * 
+         * @return FrameScheduler& The frame scheduler.
+         */
+        FrameScheduler& scheduler();
+
+        /**
+         * @brief Gets the stream renderer of the window, created on first use.
+         * 
+         * @return StreamRenderer* The stream renderer, null if the context is too old.
+         */
+        StreamRenderer* stream();
+
         /**
          * @brief Checks if the window has focus.
          * 
@@ -189,6 +247,9 @@ namespace kat {
 
     private:
         sf::RenderWindow m_window;
+        FrameScheduler m_scheduler;
+        std::unique_ptr<StreamRenderer> m_stream; ///< Destroyed before the window, while its context lives.
+        bool m_latching = false; ///< Whether latch() was called, the scheduler then limits the framerate.
     };
 
 }
\ No newline at end of file
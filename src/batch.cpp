@@ -1 +1,296 @@
-#include "Kat/batch.h"
\ No newline at end of file
+#include "Kat/batch.h"
+
+#include <SFML/OpenGL.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+namespace kat {
+
+    static FloatRect viewBounds(const View& view)
+    {
+        const auto center = view.getCenter();
+        const auto size = view.getSize();
+        const float angle = view.getRotation().asRadians();
+        const float c = std::abs(std::cos(angle));
+        const float s = std::abs(std::sin(angle));
+        const float half_width = (c * std::abs(size.x) + s * std::abs(size.y)) / 2;
+        const float half_height = (s * std::abs(size.x) + c * std::abs(size.y)) / 2;
+
+        return FloatRect(center.x - half_width, center.y - half_height, half_width * 2, half_height * 2);
+    }
+
+    /**
+     * @brief Does a target have a depth buffer? Render textures do not expose their
+     *        context settings, the depth bits of their framebuffer are queried instead.
+     */
+    static bool hasDepthBuffer(sf::RenderTarget& target)
+    {
+        if (const auto *window = dynamic_cast<const sf::RenderWindow *>(&target))
+            return window->getSettings().depthBits > 0;
+        if (target.setActive(true) == false)
+            return false;
+
+        GLint bits = 0;
+
+        glGetIntegerv(GL_DEPTH_BITS, &bits);
+        return bits > 0;
+    }
+
+    static bool intersects(const FloatRect& a, const FloatRect& b)
+    {
+        return a.left < b.left + b.width && b.left < a.left + a.width
+            && a.top < b.top + b.height && b.top < a.top + a.height;
+    }
+
+    ShapeBatch& BatchRenderer::shapeBatch(Batch& batch, const sf::Texture* texture, sf::Shader* shader)
+    {
+        if (m_shape_batch_count > 0 && batch.empty() == false
+            && batch.back().shapes == m_shape_batches[m_shape_batch_count - 1].get()
+            && m_shape_batches[m_shape_batch_count - 1]->getTexture() == texture
+            && m_shape_batches[m_shape_batch_count - 1]->getShader() == shader) {
+            return *m_shape_batches[m_shape_batch_count - 1];
+        }
+        if (m_shape_batch_count == m_shape_batches.size()) {
+            m_shape_batches.push_back(std::make_shared<ShapeBatch>());
+        }
+
+        auto& run = m_shape_batches[m_shape_batch_count++];
+
+        run->reset(texture, shader);
+        batch.push_back({ run, FloatRect(), true, run.get() });
+        return *run;
+    }
+
+    void BatchRenderer::add(const sf::Shape& shape, ZAxis z)
+    {
+        const ShapeMesh& mesh = m_shape_cache.get(shape);
+        Batch& batch = layer(z);
+        const sf::Transform& transform = shape.getTransform();
+
+        if (mesh.fill.empty() == false && shape.getFillColor().a != 0) {
+            const sf::Texture* texture = shape.getTexture();
+
+            if (texture) {
+                shapeBatch(batch, texture).append(mesh.fill, transform, shape.getFillColor(),
+                                                  mesh.bounds, shape.getTextureRect());
+            } else {
+                shapeBatch(batch, nullptr).append(mesh.fill, transform, shape.getFillColor());
+            }
+        }
+        if (mesh.outline.empty() == false) {
+            shapeBatch(batch, nullptr).append(mesh.outline, transform, shape.getOutlineColor());
+        }
+    }
+
+    bool BatchRenderer::addSprite(const sf::Sprite& sprite, const EffectParams& effect,
+                                  const FrameHull* hull, ZAxis z)
+    {
+        sf::Shader* shader = uberShader();
+        const sf::Texture* texture = sprite.getTexture();
+
+        if (shader == nullptr || texture == nullptr)
+            return false;
+
+        const IntRect rect = sprite.getTextureRect();
+        const float width = (float)std::abs(rect.width);
+        const float height = (float)std::abs(rect.height);
+        m_sprite_triangles.clear();
+        if (hull && hull->size() >= 3) {
+            for (usize i = 1; i + 1 < hull->size(); ++i) {
+                m_sprite_triangles.push_back((*hull)[0]);
+                m_sprite_triangles.push_back((*hull)[i]);
+                m_sprite_triangles.push_back((*hull)[i + 1]);
+            }
+        } else {
+            m_sprite_triangles.insert(m_sprite_triangles.end(), {
+                Vector2f(0, 0), Vector2f(width, 0), Vector2f(0, height),
+                Vector2f(0, height), Vector2f(width, 0), Vector2f(width, height)
+            });
+        }
+        // The vertex color is the color of the sprite, the effect goes to its own channel
+        shapeBatch(layer(z), texture, shader).append(m_sprite_triangles, sprite.getTransform(),
+                                                     sprite.getColor(), FloatRect(0, 0, width, height),
+                                                     rect, encodeEffect(effect));
+        return true;
+    }
+
+    void BatchRenderer::prepare()
+    {
+        for (auto& [_, batch] : m_batches) {
+            for (auto& entry : batch) {
+                if (entry.shapes)
+                    entry.bounds = entry.shapes->getGlobalBounds();
+            }
+        }
+
+        m_opaque.clear();
+        m_translucent_depth.clear();
+        if (m_depth_sorting == false)
+            return;
+
+        // Every layer owns a slice of the depth range, the front layer the closest one
+        const float slice = 1.0f / (m_batches.size() + 1);
+
+        for (usize i = 0; i < m_batches.size(); ++i) {
+            const Batch& batch = m_batches[i].second;
+            const float back = (m_batches.size() - i) * slice;
+            float min_y = 0.0f;
+            float max_y = 0.0f;
+
+            if (m_depth_from_y) {
+                min_y = std::numeric_limits<float>::max();
+                max_y = std::numeric_limits<float>::lowest();
+                for (const auto& entry : batch) {
+                    if (entry.bounded) {
+                        min_y = std::min(min_y, entry.bounds.top + entry.bounds.height);
+                        max_y = std::max(max_y, entry.bounds.top + entry.bounds.height);
+                    }
+                }
+            }
+            for (const auto& entry : batch) {
+                float depth = back;
+
+                if (m_depth_from_y && entry.bounded && max_y > min_y) {
+                    const float bottom = entry.bounds.top + entry.bounds.height;
+
+                    depth -= (bottom - min_y) / (max_y - min_y) * slice * 0.999f;
+                }
+                if (entry.opacity == Opacity::Translucent) {
+                    m_translucent_depth.push_back(depth);
+                } else {
+                    m_opaque.push_back({ &entry, depth });
+                }
+            }
+        }
+
+        // Grouped by texture, front to back inside of a group
+        std::sort(m_opaque.begin(), m_opaque.end(), [](const DepthEntry& a, const DepthEntry& b) {
+            if (a.entry->texture != b.entry->texture)
+                return std::less<const sf::Texture*>()(a.entry->texture, b.entry->texture);
+            return a.depth < b.depth;
+        });
+    }
+
+    void BatchRenderer::drawView(sf::RenderTarget& target, const View& view, StreamRenderer* stream) const
+    {
+        const FloatRect visible = viewBounds(view);
+        bool streamed = false;
+
+        for (const auto& [_, batch] : m_batches) {
+            for (const auto& entry : batch) {
+                if (entry.bounded && intersects(entry.bounds, visible) == false)
+                    continue;
+                if (stream && entry.shapes && entry.shapes->getShader() == nullptr) {
+                    stream->draw(target, view, entry.shapes->getVertices(), entry.shapes->getTexture());
+                    streamed = true;
+                    continue;
+                }
+                // The stream renderer bypasses the state cache of sfml
+                if (streamed) {
+                    target.resetGLStates();
+                    streamed = false;
+                }
+                target.draw(*entry.drawable);
+            }
+        }
+        if (streamed)
+            target.resetGLStates();
+    }
+
+    void BatchRenderer::drawViewDepth(sf::RenderTarget& target, const View& view) const
+    {
+        const FloatRect visible = viewBounds(view);
+        bool alpha_test = false;
+
+        if (target.setActive(true) == false)
+            return drawView(target, view);
+
+        glDepthMask(GL_TRUE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+        glAlphaFunc(GL_GREATER, 0.5f);
+
+        // The depth range is collapsed on the depth of the drawable: the 2d vertices of
+        // sfml all have a z of 0, so every fragment gets that depth, without any shader.
+        for (const auto& [entry, depth] : m_opaque) {
+            if (entry->bounded && intersects(entry->bounds, visible) == false)
+                continue;
+            if ((entry->opacity == Opacity::AlphaTested) != alpha_test) {
+                alpha_test = !alpha_test;
+                alpha_test ? glEnable(GL_ALPHA_TEST) : glDisable(GL_ALPHA_TEST);
+            }
+            glDepthRange(depth, depth);
+            target.draw(*entry->drawable);
+        }
+        glDisable(GL_ALPHA_TEST);
+
+        // Translucent drawables are tested against the opaque ones but do not hide anything
+        glDepthMask(GL_FALSE);
+        usize index = 0;
+        for (const auto& [_, batch] : m_batches) {
+            for (const auto& entry : batch) {
+                if (entry.opacity != Opacity::Translucent)
+                    continue;
+
+                const float depth = m_translucent_depth[index++];
+
+                if (entry.bounded && intersects(entry.bounds, visible) == false)
+                    continue;
+                glDepthRange(depth, depth);
+                target.draw(*entry.drawable);
+            }
+        }
+
+        glDepthRange(0.0, 1.0);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_DEPTH_TEST);
+    }
+
+    void BatchRenderer::draw(Window& window, bool clear)
+    {
+        auto& target = window.get_handle();
+        const bool depth = m_depth_sorting && target.getSettings().depthBits > 0;
+        StreamRenderer* stream = m_streaming ? window.stream() : nullptr;
+
+        prepare();
+        depth ? drawViewDepth(target, target.getView()) : drawView(target, target.getView(), stream);
+        if (clear)
+            this->clear();
+    }
+
+    void BatchRenderer::draw(Window& window, const std::vector<View>& views, bool clear)
+    {
+        auto& target = window.get_handle();
+        const View saved = target.getView();
+        const bool depth = m_depth_sorting && target.getSettings().depthBits > 0;
+        StreamRenderer* stream = m_streaming ? window.stream() : nullptr;
+
+        prepare();
+        for (const auto& view : views) {
+            target.setView(view);
+            depth ? drawViewDepth(target, view) : drawView(target, view, stream);
+        }
+        target.setView(saved);
+        if (clear)
+            this->clear();
+    }
+
+    void BatchRenderer::draw(const RenderViewList& views, bool clear)
+    {
+        prepare();
+        for (const auto& [target, view] : views) {
+            const View saved = target->getView();
+
+            target->setView(view);
+            // Without a depth buffer, opaque drawables would come out in submission order
+            m_depth_sorting && hasDepthBuffer(*target) ? drawViewDepth(*target, view) : drawView(*target, view);
+            target->setView(saved);
+        }
+        if (clear)
+            this->clear();
+    }
+}
\ No newline at end of file
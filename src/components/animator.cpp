@@ -18,6 +18,19 @@ namespace kat {
         loop = ploop;
     }
 
+    void Animation::trim(const sf::Image& image, const TrimSettings& settings) {
+        // Trim from the untrimmed frames so trimming twice is harmless
+        if (trims.size() == frames.size()) {
+            for (usize i = 0; i < frames.size(); ++i) {
+                frames[i] = trims[i].source;
+            }
+        }
+        trims = trimFrames(image, frames, settings);
+        for (usize i = 0; i < frames.size(); ++i) {
+            frames[i] = trims[i].trimmed;
+        }
+    }
+
     void Animator::_defaultAnimation() {
         auto anim = Animation();
         const auto& tx_size = m_sprite.getTexture().size();
@@ -29,6 +42,19 @@ namespace kat {
         m_current_animation = &m_animations["default"];
     }
 
+    void Animator::_applyFrame() {
+        const auto& anim = *m_current_animation;
+
+        m_sprite.setTextureRect(anim.frames[m_frame_index]);
+        if (anim.trims.size() == anim.frames.size()) {
+            m_sprite.setTrimOffset(anim.trims[m_frame_index].offset);
+            m_sprite.setMesh(anim.trims[m_frame_index].hull);
+        } else {
+            m_sprite.setTrimOffset(Position());
+            m_sprite.setMesh(nullptr);
+        }
+    }
+
     Animator::Animator(Sprite& sprite)
         : m_sprite(sprite)
     {
@@ -63,7 +89,7 @@ namespace kat {
         m_playing = AnimationState::Playing;
         m_frame_time = 0.0f;
         m_frame_index = 0;
-        m_sprite.setTextureRect(m_current_animation->frames[0]);
+        _applyFrame();
         return *this;
     }
 
@@ -88,7 +114,7 @@ namespace kat {
             if (++m_frame_index >= m_current_animation->frames.size()) {
                 m_frame_index = 0;
             }
-            m_sprite.setTextureRect(m_current_animation->frames[m_frame_index]);
+            _applyFrame();
         }
         return *this;
     }
@@ -101,6 +127,17 @@ namespace kat {
         return m_loop;
     }
 
+    Animator& Animator::trimAnimations(const TrimSettings& settings) {
+        const sf::Image image = m_sprite.getTexture().copyToImage();
+
+        for (auto& [name, anim] : m_animations) {
+            if (name != "default") {
+                anim.trim(image, settings);
+            }
+        }
+        return *this;
+    }
+
     Animator& Animator::addAnimationSpritesheet(
         const AnimationName& name,
         const FrameIndexList& frames,
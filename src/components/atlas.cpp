@@ -0,0 +1,234 @@
+#include "Kat/components/atlas.h"
+#include "Kat/components/texture_release.h"
+#include "Kat/image_format.h"
+
+#include <algorithm>
+#include <cstring>
+
+// imgui compiles its own copy of the packer with internal linkage, so does the atlas
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace kat {
+
+    struct AtlasPage {
+        shared_texture_t texture; ///< The page of a TextureAtlas.
+        sf::Image image;          ///< The page of an ImageAtlas.
+        stbrp_context context;
+        std::vector<stbrp_node> nodes;
+    };
+
+    namespace {
+
+        /**
+         * @brief Packs a rect in the first page it fits in, a page is added if none does.
+         *        The rect has to fit in an empty page.
+         */
+        usize packRect(std::vector<std::unique_ptr<AtlasPage>>& pages, const TextureSize& page_size,
+                       stbrp_rect& rect)
+        {
+            for (usize i = 0; i < pages.size(); ++i) {
+                stbrp_pack_rects(&pages[i]->context, &rect, 1);
+                if (rect.was_packed)
+                    return i;
+            }
+
+            auto page = std::make_unique<AtlasPage>();
+
+            // As many nodes as the width, so widths are not quantized
+            page->nodes.resize(page_size.x);
+            stbrp_init_target(&page->context, (int)page_size.x, (int)page_size.y,
+                              page->nodes.data(), (int)page->nodes.size());
+            stbrp_pack_rects(&page->context, &rect, 1);
+            pages.push_back(std::move(page));
+            return pages.size() - 1;
+        }
+
+        /**
+         * @brief The image with its extruded edges and its transparent padding.
+         */
+        std::vector<u8> borderedPixels(const sf::Image& image, u32 padding, u32 extrusion)
+        {
+            const auto size = image.getSize();
+            const u32 width = size.x + (padding + extrusion) * 2;
+            const u32 height = size.y + (padding + extrusion) * 2;
+            std::vector<u8> pixels((usize)width * height * 4, 0);
+            const u8 *source = image.getPixelsPtr();
+
+            for (u32 y = 0; y < size.y + extrusion * 2; ++y) {
+                const u32 source_y = (u32)std::clamp<i64>((i64)y - extrusion, 0, size.y - 1);
+                u8 *row = &pixels[((usize)(y + padding) * width + padding) * 4];
+                const u8 *source_row = &source[(usize)source_y * size.x * 4];
+
+                for (u32 x = 0; x < extrusion; ++x) {
+                    std::memcpy(&row[x * 4], source_row, 4);
+                    std::memcpy(&row[(extrusion + size.x + x) * 4], &source_row[(size.x - 1) * 4], 4);
+                }
+                std::memcpy(&row[extrusion * 4], source_row, (usize)size.x * 4);
+            }
+            return pixels;
+        }
+    }
+
+    TextureAtlas::TextureAtlas(const TextureSize& page_size, TextureCoordinate padding,
+                               TextureCoordinate extrusion)
+        : m_page_size(page_size)
+        , m_padding(padding)
+        , m_extrusion(extrusion)
+    {
+    }
+
+    TextureAtlas::~TextureAtlas() = default;
+
+    Texture TextureAtlas::add(const sf::Image& image)
+    {
+        const auto size = image.getSize();
+        const u32 border = m_padding + m_extrusion;
+        const u32 width = size.x + border * 2;
+        const u32 height = size.y + border * 2;
+
+        if (size.x == 0 || size.y == 0)
+            return Texture(nullptr);
+        if (width > m_page_size.x || height > m_page_size.y) {
+            auto texture = makeSharedTexture();
+
+            if (texture->loadFromImage(image) == false)
+                return Texture(nullptr);
+            texture->setSmooth(m_smooth);
+            return Texture(texture);
+        }
+
+        stbrp_rect rect = {};
+
+        rect.w = (stbrp_coord)width;
+        rect.h = (stbrp_coord)height;
+
+        const usize pages = m_pages.size();
+        const usize index = packRect(m_pages, m_page_size, rect);
+        AtlasPage& page = *m_pages[index];
+
+        if (index == pages) {
+            page.texture = makeSharedTexture();
+            if (page.texture->create({ m_page_size.x, m_page_size.y }) == false) {
+                m_pages.pop_back();
+                return Texture(nullptr);
+            }
+            page.texture->setSmooth(m_smooth);
+        }
+        page.texture->update(borderedPixels(image, m_padding, m_extrusion).data(), { width, height },
+                             { (u32)rect.x, (u32)rect.y });
+
+        Texture texture(page.texture);
+
+        texture.setRegion(Frame(rect.x + border, rect.y + border, size.x, size.y));
+        return texture;
+    }
+
+    Texture TextureAtlas::load(const std::string& filename)
+    {
+        const auto it = m_files.find(filename);
+
+        if (it != m_files.end())
+            return it->second;
+
+        sf::Image image;
+
+        if (image.loadFromFile(filename) == false)
+            return Texture(nullptr);
+
+        Texture texture = add(image);
+
+        if (texture.raw_handle())
+            m_files.emplace(filename, texture);
+        return texture;
+    }
+
+    Texture TextureAtlas::load(const Memory data, usize size)
+    {
+        sf::Image image;
+
+        if (decodeImage(std::span<const u8>(static_cast<const u8 *>(data), size), image) == false)
+            return Texture(nullptr);
+        return add(image);
+    }
+
+    usize TextureAtlas::pages() const
+    {
+        return m_pages.size();
+    }
+
+    Texture TextureAtlas::page(usize index) const
+    {
+        return Texture(m_pages[index]->texture);
+    }
+
+    TextureAtlas& TextureAtlas::setSmooth(bool smooth)
+    {
+        m_smooth = smooth;
+        for (auto& page : m_pages)
+            page->texture->setSmooth(smooth);
+        return *this;
+    }
+
+    void TextureAtlas::clear()
+    {
+        m_pages.clear();
+        m_files.clear();
+    }
+
+    ImageAtlas::ImageAtlas(const TextureSize& page_size, TextureCoordinate padding,
+                           TextureCoordinate extrusion)
+        : m_page_size(page_size)
+        , m_padding(padding)
+        , m_extrusion(extrusion)
+    {
+    }
+
+    ImageAtlas::~ImageAtlas() = default;
+
+    std::optional<AtlasRegion> ImageAtlas::add(const sf::Image& image)
+    {
+        const auto size = image.getSize();
+        const u32 border = m_padding + m_extrusion;
+        const u32 width = size.x + border * 2;
+        const u32 height = size.y + border * 2;
+
+        if (size.x == 0 || size.y == 0 || width > m_page_size.x || height > m_page_size.y)
+            return std::nullopt;
+
+        stbrp_rect rect = {};
+
+        rect.w = (stbrp_coord)width;
+        rect.h = (stbrp_coord)height;
+
+        const usize pages = m_pages.size();
+        const usize index = packRect(m_pages, m_page_size, rect);
+        AtlasPage& page = *m_pages[index];
+        const std::vector<u8> pixels = borderedPixels(image, m_padding, m_extrusion);
+        sf::Image bordered;
+
+        if (index == pages)
+            page.image.create({ m_page_size.x, m_page_size.y }, sf::Color::Transparent);
+        bordered.create({ width, height }, pixels.data());
+        page.image.copy(bordered, { (u32)rect.x, (u32)rect.y });
+        return AtlasRegion{ (u32)index, Frame(rect.x + border, rect.y + border, size.x, size.y) };
+    }
+
+    usize ImageAtlas::pages() const
+    {
+        return m_pages.size();
+    }
+
+    const sf::Image& ImageAtlas::page(usize index) const
+    {
+        return m_pages[index]->image;
+    }
+}
@@ -0,0 +1,397 @@
+#include "Kat/components/composite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace kat {
+
+    CompositeAtlas *CompositeAtlas::m_Instance = nullptr;
+
+    std::optional<Frame> CompositeAtlas::allocate(Page& page, const FrameSize& size)
+    {
+        for (auto& shelf : page.shelves) {
+            // Shelves much higher than the region would waste most of their height
+            if (size.y > shelf.height || shelf.height > size.y + size.y / 2)
+                continue;
+
+            for (usize i = 0; i < shelf.free.size(); ++i) {
+                Frame rect = shelf.free[i];
+
+                if ((TextureCoordinate)rect.width < size.x)
+                    continue;
+                if ((TextureCoordinate)rect.width == size.x) {
+                    shelf.free.erase(shelf.free.begin() + i);
+                } else {
+                    shelf.free[i].left += size.x;
+                    shelf.free[i].width -= size.x;
+                }
+                rect.width = size.x;
+                return rect;
+            }
+            if (shelf.cursor + size.x <= PageSize) {
+                const Frame rect(shelf.cursor, shelf.top, size.x, shelf.height);
+
+                shelf.cursor += size.x;
+                return rect;
+            }
+        }
+        if (page.bottom + size.y > PageSize)
+            return std::nullopt;
+
+        page.shelves.push_back({ page.bottom, size.y, size.x, {} });
+        page.bottom += size.y;
+        return Frame(0, page.shelves.back().top, size.x, size.y);
+    }
+
+    std::optional<CompositeRegion> CompositeAtlas::allocate(const FrameSize& size)
+    {
+        const FrameSize padded(size.x + Padding * 2, size.y + Padding * 2);
+
+        if (padded.x > PageSize || padded.y > PageSize)
+            return std::nullopt;
+
+        for (usize i = 0; i <= m_pages.size(); ++i) {
+            if (i == m_pages.size()) {
+                auto target = std::make_shared<sf::RenderTexture>();
+
+                if (target->create({ PageSize, PageSize }) == false)
+                    return std::nullopt;
+                target->clear(sf::Color::Transparent);
+                m_pages.push_back({ target, {} });
+            }
+
+            Page& page = m_pages[i];
+            const auto rect = allocate(page, padded);
+
+            if (rect) {
+                ++page.used;
+                return CompositeRegion{ i, Frame(rect->left + Padding, rect->top + Padding, size.x, size.y) };
+            }
+        }
+        return std::nullopt;
+    }
+
+    void CompositeAtlas::release(const CompositeRegion& region)
+    {
+        Page& page = m_pages[region.page];
+        const TextureCoordinate top = region.rect.top - Padding;
+
+        if (--page.used == 0) {
+            page.shelves.clear();
+            page.bottom = 0;
+            return;
+        }
+        for (auto& shelf : page.shelves) {
+            if (shelf.top == top) {
+                shelf.free.emplace_back(region.rect.left - Padding, top,
+                                        region.rect.width + Padding * 2, shelf.height);
+                return;
+            }
+        }
+    }
+
+    sf::RenderTexture& CompositeAtlas::target(usize page)
+    {
+        return *m_pages[page].target;
+    }
+
+    Texture CompositeAtlas::texture(usize page) const
+    {
+        const auto& target = m_pages[page].target;
+
+        // Shares the ownership of the render texture
+        return Texture(shared_texture_t(target, const_cast<sf::Texture *>(&target->getTexture())));
+    }
+
+    usize CompositeAtlas::pages() const
+    {
+        return m_pages.size();
+    }
+
+    CompositeAtlas& CompositeAtlas::instance()
+    {
+        if (!m_Instance)
+            m_Instance = new CompositeAtlas();
+        return *m_Instance;
+    }
+
+    void CompositeAtlas::destroy()
+    {
+        if (m_Instance)
+            delete m_Instance;
+        m_Instance = nullptr;
+    }
+
+    struct CompositeState : public sf::Drawable {
+        CompositeAtlas* atlas;
+        std::vector<Sprite> parts;
+        sf::Transformable transform;
+
+        u64 signature = 0;
+        bool dirty = true;             ///< Set when parts are added or removed.
+        std::optional<CompositeRegion> region;
+        bool baked = false;
+        Position offset;               ///< Top left of the parts, in the space of the parts.
+        FloatRect bounds;              ///< Bounds of the parts, in the space of the parts.
+        Texture texture;
+        sf::Sprite quad;
+
+        CompositeState(CompositeAtlas& atlas)
+            : atlas(&atlas)
+        {
+        }
+
+        ~CompositeState() override
+        {
+            if (region)
+                atlas->release(*region);
+        }
+
+        u64 computeSignature() const
+        {
+            u64 hash = 0xcbf29ce484222325ULL;
+            const auto add = [&hash](const void *data, usize size) {
+                const auto *bytes = static_cast<const u8 *>(data);
+
+                // FNV-1a
+                for (usize i = 0; i < size; ++i) {
+                    hash ^= bytes[i];
+                    hash *= 0x100000001b3ULL;
+                }
+            };
+
+            for (const auto& part : parts) {
+                const sf::Sprite *handle = part.raw_handle();
+                const sf::Texture *part_texture = handle->getTexture();
+                const FrameHull *mesh = part.getMesh();
+                const Frame& rect = handle->getTextureRect();
+                const Color& color = handle->getColor();
+
+                add(&part_texture, sizeof(part_texture));
+                add(&mesh, sizeof(mesh));
+                add(&rect, sizeof(rect));
+                add(&color, sizeof(color));
+                add(handle->getTransform().getMatrix(), sizeof(float) * 16);
+            }
+            return hash;
+        }
+
+        void releaseRegion()
+        {
+            if (region)
+                atlas->release(*region);
+            region = std::nullopt;
+            baked = false;
+            texture = Texture();
+        }
+
+        bool bake()
+        {
+            const u64 current = computeSignature();
+
+            if (dirty == false && current == signature)
+                return false;
+            dirty = false;
+            signature = current;
+
+            if (parts.empty()) {
+                releaseRegion();
+                bounds = FloatRect();
+                return true;
+            }
+
+            float left = std::numeric_limits<float>::max();
+            float top = std::numeric_limits<float>::max();
+            float right = std::numeric_limits<float>::lowest();
+            float bottom = std::numeric_limits<float>::lowest();
+
+            for (const auto& part : parts) {
+                const FloatRect part_bounds = part.getGlobalBounds();
+
+                left = std::min(left, part_bounds.left);
+                top = std::min(top, part_bounds.top);
+                right = std::max(right, part_bounds.left + part_bounds.width);
+                bottom = std::max(bottom, part_bounds.top + part_bounds.height);
+            }
+            offset = Position(std::floor(left), std::floor(top));
+
+            const FrameSize size((TextureCoordinate)(std::ceil(right) - offset.x),
+                                 (TextureCoordinate)(std::ceil(bottom) - offset.y));
+
+            bounds = FloatRect(offset.x, offset.y, (float)size.x, (float)size.y);
+
+            // The region is kept while the parts fit in it
+            if (region && ((TextureCoordinate)region->rect.width < size.x
+                           || (TextureCoordinate)region->rect.height < size.y)) {
+                releaseRegion();
+            }
+            if (!region) {
+                region = atlas->allocate(size);
+                if (!region) {
+                    baked = false;
+                    return false;
+                }
+            }
+
+            sf::RenderTexture& target = atlas->target(region->page);
+            const FloatRect area((float)region->rect.left - CompositeAtlas::Padding,
+                                 (float)region->rect.top - CompositeAtlas::Padding,
+                                 (float)region->rect.width + CompositeAtlas::Padding * 2,
+                                 (float)region->rect.height + CompositeAtlas::Padding * 2);
+            const sf::Vertex clear_quad[] = {
+                { { area.left, area.top }, sf::Color::Transparent },
+                { { area.left + area.width, area.top }, sf::Color::Transparent },
+                { { area.left, area.top + area.height }, sf::Color::Transparent },
+                { { area.left, area.top + area.height }, sf::Color::Transparent },
+                { { area.left + area.width, area.top }, sf::Color::Transparent },
+                { { area.left + area.width, area.top + area.height }, sf::Color::Transparent }
+            };
+            sf::RenderStates states;
+
+            target.setView(target.getDefaultView());
+            target.draw(clear_quad, 6, sf::PrimitiveType::Triangles, sf::RenderStates(sf::BlendNone));
+
+            // Alpha blending onto a transparent region gives premultiplied colors
+            states.transform.translate({ region->rect.left - offset.x, region->rect.top - offset.y });
+            for (const auto& part : parts)
+                target.draw(*part.as_drawable(), states);
+            target.display();
+
+            texture = atlas->texture(region->page);
+            quad.setTexture(*texture.raw_handle());
+            quad.setTextureRect(Frame(region->rect.left, region->rect.top, size.x, size.y));
+            baked = true;
+            return true;
+        }
+
+        void draw(sf::RenderTarget& target, const sf::RenderStates& states) const override
+        {
+            sf::RenderStates composite_states(states);
+
+            composite_states.transform *= transform.getTransform();
+            if (baked == false) {
+                for (const auto& part : parts)
+                    target.draw(*part.as_drawable(), composite_states);
+                return;
+            }
+            composite_states.transform.translate(offset);
+            composite_states.blendMode = sf::BlendMode(sf::BlendMode::One, sf::BlendMode::OneMinusSrcAlpha);
+            target.draw(quad, composite_states);
+        }
+    };
+
+    CompositeSprite::CompositeSprite(CompositeAtlas& atlas)
+        : m_state(std::make_shared<CompositeState>(atlas))
+    {
+    }
+
+    CompositeSprite& CompositeSprite::add(const Sprite& part)
+    {
+        m_state->parts.push_back(part);
+        m_state->dirty = true;
+        return *this;
+    }
+
+    CompositeSprite& CompositeSprite::remove(usize index)
+    {
+        m_state->parts.erase(m_state->parts.begin() + index);
+        m_state->dirty = true;
+        return *this;
+    }
+
+    CompositeSprite& CompositeSprite::clear()
+    {
+        m_state->parts.clear();
+        m_state->dirty = true;
+        return *this;
+    }
+
+    Sprite& CompositeSprite::part(usize index)
+    {
+        return m_state->parts[index];
+    }
+
+    usize CompositeSprite::size() const
+    {
+        return m_state->parts.size();
+    }
+
+    bool CompositeSprite::bake() const
+    {
+        return m_state->bake();
+    }
+
+    bool CompositeSprite::isBaked() const
+    {
+        return m_state->baked;
+    }
+
+    CompositeSprite& CompositeSprite::setPosition(const Position& position)
+    {
+        m_state->transform.setPosition(position);
+        return *this;
+    }
+
+    CompositeSprite& CompositeSprite::setRotation(const Angle& angle)
+    {
+        m_state->transform.setRotation(angle);
+        return *this;
+    }
+
+    CompositeSprite& CompositeSprite::setScale(const Scale& scale)
+    {
+        m_state->transform.setScale(scale);
+        return *this;
+    }
+
+    CompositeSprite& CompositeSprite::setOrigin(const Position& origin)
+    {
+        m_state->transform.setOrigin(origin);
+        return *this;
+    }
+
+    Position CompositeSprite::getPosition() const
+    {
+        return m_state->transform.getPosition();
+    }
+
+    Angle CompositeSprite::getRotation() const
+    {
+        return m_state->transform.getRotation();
+    }
+
+    Scale CompositeSprite::getScale() const
+    {
+        return m_state->transform.getScale();
+    }
+
+    Position CompositeSprite::getOrigin() const
+    {
+        return m_state->transform.getOrigin();
+    }
+
+    const Texture& CompositeSprite::getTexture() const
+    {
+        m_state->bake();
+        return m_state->texture;
+    }
+
+    GlobalBounds CompositeSprite::getGlobalBounds() const
+    {
+        m_state->bake();
+        return m_state->transform.getTransform().transformRect(m_state->bounds);
+    }
+
+    void CompositeSprite::draw(Window& window) const
+    {
+        m_state->bake();
+        window.draw(*m_state);
+    }
+
+    shared_drawable_t CompositeSprite::as_drawable() const
+    {
+        m_state->bake();
+        return m_state;
+    }
+}
@@ -0,0 +1,263 @@
+#include "Kat/components/dynamic_texture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace kat {
+
+    StagingPool *StagingPool::m_Instance = nullptr;
+
+    std::vector<u8> StagingPool::acquire(usize size)
+    {
+        auto best = m_buffers.end();
+
+        // The smallest buffer large enough
+        for (auto it = m_buffers.begin(); it != m_buffers.end(); ++it) {
+            if (it->capacity() >= size && (best == m_buffers.end() || it->capacity() < best->capacity()))
+                best = it;
+        }
+        if (best == m_buffers.end())
+            return std::vector<u8>(size);
+
+        std::vector<u8> buffer = std::move(*best);
+
+        m_buffers.erase(best);
+        buffer.resize(size);
+        return buffer;
+    }
+
+    void StagingPool::release(std::vector<u8>&& buffer)
+    {
+        if (m_buffers.size() == MaxBuffers) {
+            // The smallest buffer is the least useful
+            auto smallest = std::min_element(m_buffers.begin(), m_buffers.end(),
+                [](const auto& a, const auto& b) { return a.capacity() < b.capacity(); });
+
+            if (smallest->capacity() >= buffer.capacity())
+                return;
+            m_buffers.erase(smallest);
+        }
+        m_buffers.push_back(std::move(buffer));
+    }
+
+    void StagingPool::clear()
+    {
+        m_buffers.clear();
+    }
+
+    usize StagingPool::capacity() const
+    {
+        usize total = 0;
+
+        for (const auto& buffer : m_buffers)
+            total += buffer.capacity();
+        return total;
+    }
+
+    StagingPool& StagingPool::instance()
+    {
+        if (!m_Instance)
+            m_Instance = new StagingPool();
+        return *m_Instance;
+    }
+
+    void StagingPool::destroy()
+    {
+        if (m_Instance)
+            delete m_Instance;
+        m_Instance = nullptr;
+    }
+
+    static i64 area(const Frame& frame)
+    {
+        return (i64)frame.width * frame.height;
+    }
+
+    static Frame bounds(const Frame& a, const Frame& b)
+    {
+        const i32 left = std::min(a.left, b.left);
+        const i32 top = std::min(a.top, b.top);
+        const i32 right = std::max(a.left + a.width, b.left + b.width);
+        const i32 bottom = std::max(a.top + a.height, b.top + b.height);
+
+        return Frame(left, top, right - left, bottom - top);
+    }
+
+    static bool touches(const Frame& a, const Frame& b)
+    {
+        return a.left <= b.left + b.width && b.left <= a.left + a.width
+            && a.top <= b.top + b.height && b.top <= a.top + a.height;
+    }
+
+    DynamicTexture::DynamicTexture(StagingPool& pool)
+        : m_pool(&pool)
+    {
+    }
+
+    DynamicTexture& DynamicTexture::create(const TextureSize& size)
+    {
+        m_dirty.clear();
+        m_texture.create(size);
+        if (m_texture.raw_handle() == nullptr) {
+            m_size = TextureSize();
+            m_pixels.clear();
+            throw std::runtime_error("Failed to create texture.");
+        }
+        m_size = size;
+        m_pixels.assign((usize)size.x * size.y * 4, 0);
+        // A new texture has undefined content
+        markDirty(Frame(0, 0, size.x, size.y));
+        return *this;
+    }
+
+    TextureSize DynamicTexture::size() const
+    {
+        return m_size;
+    }
+
+    Pixels DynamicTexture::pixels()
+    {
+        return m_pixels.data();
+    }
+
+    DynamicTexture& DynamicTexture::setPixel(TextureCoordinate x, TextureCoordinate y, const Color& color)
+    {
+        if (x >= m_size.x || y >= m_size.y)
+            return *this;
+
+        u8 *pixel = m_pixels.data() + ((usize)y * m_size.x + x) * 4;
+
+        pixel[0] = color.r;
+        pixel[1] = color.g;
+        pixel[2] = color.b;
+        pixel[3] = color.a;
+        return markDirty(Frame(x, y, 1, 1));
+    }
+
+    DynamicTexture& DynamicTexture::update(const Pixels pixels, const Frame& frame)
+    {
+        // Only the part of the frame inside the texture is copied, like setPixel
+        const i32 left = std::max(frame.left, 0);
+        const i32 top = std::max(frame.top, 0);
+        const i32 right = std::min(frame.left + frame.width, (i32)m_size.x);
+        const i32 bottom = std::min(frame.top + frame.height, (i32)m_size.y);
+
+        if (right <= left || bottom <= top)
+            return *this;
+        for (i32 y = top; y < bottom; ++y) {
+            std::memcpy(m_pixels.data() + ((usize)y * m_size.x + left) * 4,
+                        pixels + ((usize)(y - frame.top) * frame.width + (left - frame.left)) * 4,
+                        (usize)(right - left) * 4);
+        }
+        return markDirty(Frame(left, top, right - left, bottom - top));
+    }
+
+    DynamicTexture& DynamicTexture::markDirty(const Frame& frame)
+    {
+        const i32 left = std::max(frame.left, 0);
+        const i32 top = std::max(frame.top, 0);
+        const i32 right = std::min(frame.left + frame.width, (i32)m_size.x);
+        const i32 bottom = std::min(frame.top + frame.height, (i32)m_size.y);
+
+        if (right <= left || bottom <= top)
+            return *this;
+
+        Frame rect(left, top, right - left, bottom - top);
+
+        // Rects are merged with the rects they touch when their bounds waste less than a quarter
+        for (bool merged = true; merged;) {
+            merged = false;
+            for (auto it = m_dirty.begin(); it != m_dirty.end(); ++it) {
+                const Frame merged_rect = bounds(*it, rect);
+
+                if (touches(*it, rect) && area(merged_rect) * 3 <= (area(*it) + area(rect)) * 4) {
+                    rect = merged_rect;
+                    m_dirty.erase(it);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+        if (m_dirty.size() == MaxDirtyRects) {
+            for (const auto& dirty : m_dirty)
+                rect = bounds(rect, dirty);
+            m_dirty.clear();
+        }
+        m_dirty.push_back(rect);
+        return *this;
+    }
+
+    DynamicTexture& DynamicTexture::setUploadBudget(usize bytes)
+    {
+        m_budget = bytes;
+        return *this;
+    }
+
+    usize DynamicTexture::getUploadBudget() const
+    {
+        return m_budget;
+    }
+
+    void DynamicTexture::upload(const Frame& frame)
+    {
+        const usize row = (usize)frame.width * 4;
+        const u8 *first = m_pixels.data() + ((usize)frame.top * m_size.x + frame.left) * 4;
+
+        if ((u32)frame.width == m_size.x) {
+            m_texture.update(const_cast<u8 *>(first), frame);
+            return;
+        }
+
+        std::vector<u8> staging = m_pool->acquire(row * frame.height);
+
+        for (i32 y = 0; y < frame.height; ++y)
+            std::memcpy(staging.data() + y * row, first + (usize)y * m_size.x * 4, row);
+        m_texture.update(staging.data(), frame);
+        m_pool->release(std::move(staging));
+    }
+
+    usize DynamicTexture::flush()
+    {
+        usize uploaded = 0;
+
+        while (m_dirty.empty() == false) {
+            Frame& rect = m_dirty.front();
+            const usize row = (usize)rect.width * 4;
+            const usize bytes = row * rect.height;
+
+            if (m_budget == 0 || uploaded + bytes <= m_budget) {
+                upload(rect);
+                uploaded += bytes;
+                m_dirty.erase(m_dirty.begin());
+                continue;
+            }
+
+            // The rows that fit in what is left of the budget, at least one per flush
+            const i32 rows = std::max<i32>((i32)((m_budget - std::min(uploaded, m_budget)) / row),
+                                           uploaded == 0 ? 1 : 0);
+
+            if (rows > 0) {
+                upload(Frame(rect.left, rect.top, rect.width, rows));
+                uploaded += row * rows;
+                rect.top += rows;
+                rect.height -= rows;
+                // The last rows of the rect may just have fit
+                if (rect.height == 0)
+                    m_dirty.erase(m_dirty.begin());
+            }
+            break;
+        }
+        return uploaded;
+    }
+
+    const std::vector<Frame>& DynamicTexture::getDirtyRects() const
+    {
+        return m_dirty;
+    }
+
+    const Texture& DynamicTexture::getTexture() const
+    {
+        return m_texture;
+    }
+}
@@ -3,10 +3,48 @@
 
 namespace kat {
 
+    SpriteMesh::SpriteMesh(const shared_sprite_t& sprite)
+        : m_sprite(sprite)
+    {
+    }
+
+    void SpriteMesh::setHull(const shared_frame_hull_t& hull)
+    {
+        m_hull = hull;
+        m_vertices.resize(hull ? hull->size() : 0);
+    }
+
+    const shared_frame_hull_t& SpriteMesh::getHull() const
+    {
+        return m_hull;
+    }
+
+    void SpriteMesh::draw(sf::RenderTarget& target, const sf::RenderStates& states) const
+    {
+        const auto rect = m_sprite->getTextureRect();
+        const auto color = m_sprite->getColor();
+        sf::RenderStates mesh_states(states);
+
+        if (m_hull == nullptr)
+            return;
+        for (usize i = 0; i < m_hull->size(); ++i) {
+            const Position& point = (*m_hull)[i];
+
+            m_vertices[i].position = point;
+            m_vertices[i].texCoords = { rect.left + point.x, rect.top + point.y };
+            m_vertices[i].color = color;
+        }
+        mesh_states.transform *= m_sprite->getTransform();
+        mesh_states.texture = m_sprite->getTexture();
+        target.draw(m_vertices.data(), m_vertices.size(), sf::PrimitiveType::TriangleFan, mesh_states);
+    }
+
     Sprite& Sprite::create(Texture& texture)
     {
         m_texture = texture;
         m_sprite->setTexture(*texture.raw_handle());
+        if (texture.hasRegion())
+            m_sprite->setTextureRect(texture.region());
         return *this;
     }
 
@@ -59,10 +97,63 @@ namespace kat {
 
     Sprite& Sprite::setOrigin(const Position& origin)
     {
-        m_sprite->setOrigin(origin);
+        m_sprite->setOrigin(origin - m_state->trim_offset);
+        return *this;
+    }
+
+    Sprite& Sprite::setTrimOffset(const Position& offset)
+    {
+        const Position origin = getOrigin();
+
+        m_state->trim_offset = offset;
+        return setOrigin(origin);
+    }
+
+    Position Sprite::getTrimOffset() const
+    {
+        return m_state->trim_offset;
+    }
+
+    Sprite& Sprite::setMesh(const FrameHull& hull)
+    {
+        const FrameHull *current = getMesh();
+
+        if (hull.empty())
+            return setMesh(nullptr);
+        if (current && *current == hull)
+            return *this;
+        return setMesh(std::make_shared<const FrameHull>(hull));
+    }
+
+    Sprite& Sprite::setMesh(const shared_frame_hull_t& hull)
+    {
+        const bool quad = hull == nullptr || hull->empty();
+
+        if (m_state->mesh == nullptr) {
+            if (quad)
+                return *this;
+            m_state->mesh = std::make_shared<SpriteMesh>(m_sprite);
+        }
+        m_state->mesh->setHull(quad ? nullptr : hull);
         return *this;
     }
 
+    Sprite& Sprite::setEffect(const SpriteEffect& effect, const EffectStrength& strength, const Color& color)
+    {
+        m_state->effect = { effect, strength, color };
+        return *this;
+    }
+
+    const EffectParams& Sprite::getEffect() const
+    {
+        return m_state->effect;
+    }
+
+    const FrameHull* Sprite::getMesh() const
+    {
+        return m_state->mesh ? m_state->mesh->getHull().get() : nullptr;
+    }
+
     Position Sprite::getPosition() const
     {
         return m_sprite->getPosition();
@@ -80,7 +171,7 @@ namespace kat {
 
     Position Sprite::getOrigin() const
     {
-        return m_sprite->getOrigin();
+        return Position(m_sprite->getOrigin()) + m_state->trim_offset;
     }
 
     Sprite& Sprite::move(const Coordinate& x, const Coordinate& y)
@@ -128,18 +219,28 @@ namespace kat {
 
     void Sprite::draw(Window& window) const
     {
-        window.draw(*m_sprite);
+        if (getMesh())
+            window.draw(*m_state->mesh);
+        else
+            window.draw(*m_sprite);
     }
 
     Sprite& Sprite::setTextureRect(const Frame& frame)
     {
-        m_sprite->setTextureRect(frame);
+        const Frame& region = m_texture.region();
+
+        // Texture rects are relative to the region of atlased textures
+        m_sprite->setTextureRect(Frame(frame.left + region.left, frame.top + region.top,
+                                       frame.width, frame.height));
         return *this;
     }
 
     Frame Sprite::getTextureRect() const
     {
-        return m_sprite->getTextureRect();
+        const Frame& region = m_texture.region();
+        const Frame& frame = m_sprite->getTextureRect();
+
+        return Frame(frame.left - region.left, frame.top - region.top, frame.width, frame.height);
     }
 
     Sprite& Sprite::setColor(const Color& color)
@@ -180,6 +281,8 @@ namespace kat {
 
     shared_drawable_t Sprite::as_drawable() const
     {
+        if (getMesh())
+            return m_state->mesh;
         return m_sprite;
     }
 }
\ No newline at end of file
@@ -1,15 +1,26 @@
 #include "Kat/components/texture.h"
+#include "Kat/components/texture_cache.h"
+#include "Kat/components/texture_release.h"
+#include "Kat/image_cache.h"
+#include "Kat/image_format.h"
+#include "Kat/pak.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 
 namespace kat {
 
     Texture& Texture::load(sf::Texture* texture)
     {
-        m_texture = std::shared_ptr<sf::Texture>(texture);
+        m_region = Frame();
+        m_texture = makeSharedTexture(texture);
         return *this;
     }
 
     Texture& Texture::load(shared_texture_t& texture)
     {
+        m_region = Frame();
         m_texture = texture;
         return *this;
     }
@@ -17,21 +28,152 @@ namespace kat {
     Texture& Texture::load(const Texture& texture)
     {
         m_texture = texture.m_texture;
+        m_region = texture.m_region;
         return *this;
     }
 
+    /**
+     * @brief Creates a texture from rgba pixels.
+     *
+     * @return bool Whether the area is inside the image and the texture was created.
+     */
+    static bool uploadPixels(sf::Texture& texture, const u8 *pixels, const TextureSize& size, const Frame& area)
+    {
+        Frame rect(0, 0, size.x, size.y);
+
+        if (area.width > 0 && area.height > 0)
+            rect = Frame(area.left, area.top, area.width, area.height);
+        if (rect.left < 0 || rect.top < 0 || (u32)(rect.left + rect.width) > size.x
+            || (u32)(rect.top + rect.height) > size.y
+            || texture.create({ (u32)rect.width, (u32)rect.height }) == false)
+            return false;
+        if ((u32)rect.width == size.x) {
+            texture.update(pixels + (usize)rect.top * size.x * 4, { (u32)rect.width, (u32)rect.height }, { 0, 0 });
+            return true;
+        }
+        for (i32 y = 0; y < rect.height; ++y) {
+            texture.update(pixels + ((usize)(rect.top + y) * size.x + rect.left) * 4,
+                           { (u32)rect.width, 1 }, { 0, (u32)y });
+        }
+        return true;
+    }
+
+    /**
+     * @brief Uploads a pre-decoded image straight from memory.
+     *
+     * @return bool Whether the data is a valid raw image.
+     */
+    static bool loadRawImage(sf::Texture& texture, const u8 *data, std::size_t size, const Frame& area)
+    {
+        RawImageHeader header;
+
+        if (size < sizeof(header))
+            return false;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, "KRAW", 4) != 0
+            || (size - sizeof(header)) / 4 / std::max(header.width, 1u) < header.height)
+            return false;
+        return uploadPixels(texture, data + sizeof(header), TextureSize(header.width, header.height), area);
+    }
+
+    /**
+     * @brief Loads an image of one of the fast formats (see ImageFormat), raw images
+     *        are uploaded as is, qoi images are decoded without sfml.
+     *
+     * @return bool Whether the data is a valid image of a fast format.
+     */
+    static bool loadFastImage(sf::Texture& texture, std::span<const u8> data, const Frame& area)
+    {
+        std::vector<u8> pixels;
+        TextureSize size;
+
+        if (imageFormat(data) == ImageFormat::Raw)
+            return loadRawImage(texture, data.data(), data.size(), area);
+        return decodeImage(data, pixels, size) && uploadPixels(texture, pixels.data(), size, area);
+    }
+
+    /**
+     * @brief Is the file a qoi image? Its content has to be read, sfml can not load it.
+     */
+    static bool isQoiFile(const std::string& filename)
+    {
+        return filename.ends_with(".qoi");
+    }
+
+    /**
+     * @brief Loads an image file, through the image cache when it is enabled.
+     *
+     * @param content The content of the file when it was already read, may be empty.
+     * @return bool Whether the texture was created.
+     */
+    static bool loadImageFile(sf::Texture& texture, const std::string& filename,
+                              const std::vector<u8>& content, const Frame& area)
+    {
+        ImageCache& cache = ImageCache::instance();
+
+        if (cache.isEnabled() == false && content.empty())
+            return texture.loadFromFile(filename, area);
+        if (cache.isEnabled() == false && imageFormat(content) != ImageFormat::Encoded)
+            return loadFastImage(texture, content, area);
+        if (cache.isEnabled()) {
+            const auto cached = cache.find(filename);
+
+            if (cached && loadRawImage(texture, cached->image.data(), cached->image.size(), area))
+                return true;
+        }
+
+        sf::Image image;
+        const bool decoded = content.empty() ? image.loadFromFile(filename)
+                                             : decodeImage(content, image);
+
+        if (decoded == false || texture.loadFromImage(image, area) == false)
+            return false;
+        if (cache.isEnabled())
+            cache.store(filename, std::move(image));
+        return true;
+    }
+
     Texture& Texture::load(const std::string& filename, const Frame& area)
     {
-        m_texture = std::make_shared<sf::Texture>();
-        if (m_texture->loadFromFile(filename, area) == false) {
+        TextureCache& textures = TextureCache::instance();
+        std::vector<u8> content;
+
+        m_region = Frame();
+        m_texture = textures.find(filename, area);
+        if (m_texture)
+            return *this;
+
+        // The content finds copies of the file, it is then decoded from memory
+        if (textures.isEnabled() || isQoiFile(filename)) {
+            std::ifstream file(filename, std::ios::binary);
+
+            content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        if (textures.isEnabled()) {
+            m_texture = textures.find(filename, content, area);
+            if (m_texture)
+                return *this;
+        }
+        m_texture = makeSharedTexture();
+        if (loadImageFile(*m_texture, filename, content, area) == false) {
             m_texture = nullptr;
+            return *this;
         }
+        textures.insert(filename, content, area, m_texture);
         return *this;
     }
 
     Texture& Texture::load(const Memory data, std::size_t size, const Frame& area)
     {
-        m_texture = std::make_shared<sf::Texture>();
+        const std::span<const u8> bytes(static_cast<const u8 *>(data), size);
+
+        m_region = Frame();
+        m_texture = makeSharedTexture();
+        if (imageFormat(bytes) != ImageFormat::Encoded) {
+            if (loadFastImage(*m_texture, bytes, area) == false)
+                m_texture = nullptr;
+            return *this;
+        }
         if (m_texture->loadFromMemory(data, size, area) == false) {
             m_texture = nullptr;
         }
@@ -40,7 +182,8 @@ namespace kat {
 
     Texture& Texture::create(const TextureSize& size)
     {
-        m_texture = std::make_shared<sf::Texture>();
+        m_region = Frame();
+        m_texture = makeSharedTexture();
         if (m_texture->create({size.x, size.y}) == false) {
             m_texture = nullptr;
         }
@@ -49,54 +192,136 @@ namespace kat {
 
     TextureSize Texture::size() const
     {
+        if (hasRegion())
+            return TextureSize(m_region.width, m_region.height);
         return m_texture->getSize();
     }
 
+    void Texture::detach()
+    {
+        // Other textures of the file and the next loads keep the pixels of the file
+        if (m_texture && TextureCache::instance().contains(m_texture))
+            m_texture = makeSharedTexture(new sf::Texture(*m_texture));
+    }
+
     Texture& Texture::update(const Pixels pixels)
     {
+        detach();
+        if (hasRegion())
+            return update(pixels, Frame(0, 0, m_region.width, m_region.height));
         m_texture->update(pixels);
         return *this;
     }
 
+    /**
+     * @brief Updates the part of a frame that lies inside a region of a texture,
+     *        so updates of atlased textures never touch their neighbours.
+     *
+     * @param pixels The pixels of the frame, row by row.
+     * @param frame The frame, relative to the region.
+     */
+    static void updateRegion(sf::Texture& texture, const Frame& region, const u8 *pixels, const Frame& frame)
+    {
+        const i32 left = std::max(frame.left, 0);
+        const i32 top = std::max(frame.top, 0);
+        const i32 right = std::min(frame.left + frame.width, region.width);
+        const i32 bottom = std::min(frame.top + frame.height, region.height);
+
+        if (right <= left || bottom <= top)
+            return;
+
+        const u8 *source = pixels + ((usize)(top - frame.top) * frame.width + (left - frame.left)) * 4;
+
+        if (right - left == frame.width) {
+            texture.update(source, { (u32)(right - left), (u32)(bottom - top) },
+                           { (u32)(region.left + left), (u32)(region.top + top) });
+            return;
+        }
+        for (i32 y = top; y < bottom; ++y, source += (usize)frame.width * 4) {
+            texture.update(source, { (u32)(right - left), 1 },
+                           { (u32)(region.left + left), (u32)(region.top + y) });
+        }
+    }
+
+    /**
+     * @brief Updates a region of a texture from an image.
+     */
+    static void updateRegion(sf::Texture& texture, const Frame& region, const sf::Image& image,
+                             const TextureCoordinate& x, const TextureCoordinate& y)
+    {
+        const auto size = image.getSize();
+
+        if (image.getPixelsPtr())
+            updateRegion(texture, region, image.getPixelsPtr(), Frame((i32)x, (i32)y, (i32)size.x, (i32)size.y));
+    }
+
     Texture& Texture::update(const Pixels pixels, const Frame& frame)
     {
-        m_texture->update(pixels, {(u32)frame.width, (u32)frame.height},    
-                                  {(u32)frame.left, (u32)frame.top});
+        detach();
+        if (hasRegion()) {
+            updateRegion(*m_texture, m_region, pixels, frame);
+            return *this;
+        }
+        m_texture->update(pixels, {(u32)frame.width, (u32)frame.height}, {(u32)frame.left, (u32)frame.top});
         return *this;
     }
 
     Texture& Texture::update(const sf::Texture *sfml_texture)
     {
-        m_texture->update(*sfml_texture);
-        return *this;
+        return update(sfml_texture, 0, 0);
     }
 
     Texture& Texture::update(const sf::Texture *sfml_texture, const TextureCoordinate& x, const TextureCoordinate& y)
     {
+        detach();
+
+        // The gpu copy of sfml can not be clipped, region textures go through an image
+        if (hasRegion()) {
+            updateRegion(*m_texture, m_region, sfml_texture->copyToImage(), x, y);
+            return *this;
+        }
         m_texture->update(*sfml_texture, {x, y});
         return *this;
     }
 
     Texture& Texture::update(const Texture& texture)
     {
-        m_texture->update(*texture.m_texture);
-        return *this;
+        return update(texture, 0, 0);
     }
 
     Texture& Texture::update(const Texture& texture, const TextureCoordinate& x, const TextureCoordinate& y)
     {
+        detach();
+        if (hasRegion() || texture.hasRegion()) {
+            const sf::Image image = texture.copyToImage();
+
+            if (hasRegion())
+                updateRegion(*m_texture, m_region, image, x, y);
+            else
+                m_texture->update(image, {x, y});
+            return *this;
+        }
         m_texture->update(*texture.m_texture, {x, y});
         return *this;
     }
 
     Texture& Texture::update(const sf::Window& sfml_window)
     {
-        m_texture->update(sfml_window);
-        return *this;
+        return update(sfml_window, 0, 0);
     }
 
     Texture& Texture::update(const sf::Window& sfml_window, const TextureCoordinate& x, const TextureCoordinate& y)
     {
+        detach();
+        if (hasRegion()) {
+            sf::Texture capture;
+
+            if (capture.create(sfml_window.getSize()) == false)
+                return *this;
+            capture.update(sfml_window);
+            updateRegion(*m_texture, m_region, capture.copyToImage(), x, y);
+            return *this;
+        }
         m_texture->update(sfml_window, {x, y});
         return *this;
     }
@@ -113,6 +338,9 @@ namespace kat {
 
     Texture& Texture::setSmooth(bool smooth)
     {
+        if (smooth == isSmooth())
+            return *this;
+        detach();
         m_texture->setSmooth(smooth);
         return *this;
     }
@@ -123,25 +351,55 @@ namespace kat {
 
     bool Texture::repeated(bool rep)
     {
+        if (rep == repeated())
+            return rep;
+        detach();
         m_texture->setRepeated(rep);
         return repeated();
     }
 
+    Texture& Texture::setRegion(const Frame& region)
+    {
+        m_region = region;
+        return *this;
+    }
+
+    bool Texture::hasRegion() const { return m_region.width != 0 && m_region.height != 0; }
+
+    const Frame& Texture::region() const { return m_region; }
+
+    sf::Image Texture::copyToImage() const
+    {
+        if (hasRegion() == false)
+            return m_texture->copyToImage();
+
+        sf::Image region;
+
+        region.create({ (u32)m_region.width, (u32)m_region.height });
+        region.copy(m_texture->copyToImage(), { 0, 0 }, m_region);
+        return region;
+    }
+
     sf::Texture* Texture::raw_handle() { return m_texture.get(); }
 
+    const sf::Texture* Texture::raw_handle() const { return m_texture.get(); }
+
+    const shared_texture_t& Texture::shared_handle() const { return m_texture; }
+
     Texture::Texture()
-        : m_texture(std::make_shared<sf::Texture>())
+        : m_texture(makeSharedTexture())
     {
     }
 
     Texture::Texture(sf::Texture* texture)
-        : m_texture(texture)
+        : m_texture(makeSharedTexture(texture))
     {
     }
 
     Texture& Texture::operator=(sf::Texture* texture)
     {
-        m_texture = shared_texture_t(texture);
+        m_texture = makeSharedTexture(texture);
+        m_region = Frame();
         return *this;
     }
 
@@ -153,6 +411,7 @@ namespace kat {
     Texture& Texture::operator=(const shared_texture_t& texture)
     {
         m_texture = texture;
+        m_region = Frame();
         return *this;
     }
 
@@ -164,6 +423,7 @@ namespace kat {
     Texture& Texture::operator=(shared_texture_t&& texture)
     {
         m_texture = std::move(texture);
+        m_region = Frame();
         return *this;
     }
 
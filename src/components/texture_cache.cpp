@@ -0,0 +1,228 @@
+#include "Kat/components/texture_cache.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace kat {
+
+    TextureCache *TextureCache::m_Instance = nullptr;
+
+    std::string TextureCache::pathKey(const std::string& filename, const Frame& area)
+    {
+        std::error_code error;
+        const auto path = std::filesystem::weakly_canonical(filename, error);
+        std::string key = error ? filename : path.generic_string();
+
+        if (area.width > 0 && area.height > 0) {
+            key += '#' + std::to_string(area.left) + ',' + std::to_string(area.top)
+                 + ',' + std::to_string(area.width) + ',' + std::to_string(area.height);
+        }
+        return key;
+    }
+
+    u64 TextureCache::contentKey(std::span<const u8> content, const Frame& area)
+    {
+        constexpr u64 Multiplier = 0x9e3779b97f4a7c15ULL;
+        u64 hash = content.size() * Multiplier;
+        usize i = 0;
+        const auto mix = [&hash](u64 word) {
+            word *= 0xbf58476d1ce4e5b9ULL;
+            word ^= word >> 31;
+            hash = (hash ^ word) * Multiplier;
+            hash ^= hash >> 29;
+        };
+
+        // Eight bytes at a time, files are often several megabytes
+        for (; i + sizeof(u64) <= content.size(); i += sizeof(u64)) {
+            u64 word;
+
+            std::memcpy(&word, content.data() + i, sizeof(word));
+            mix(word);
+        }
+        if (i < content.size()) {
+            u64 word = 0;
+
+            std::memcpy(&word, content.data() + i, content.size() - i);
+            mix(word);
+        }
+        mix((u64)(u32)area.left << 32 | (u32)area.top);
+        mix((u64)(u32)area.width << 32 | (u32)area.height);
+        return hash;
+    }
+
+    bool TextureCache::hasContent(const std::string& filename, std::span<const u8> content)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        std::array<char, 64 * 1024> buffer;
+        usize offset = 0;
+
+        while (file) {
+            file.read(buffer.data(), buffer.size());
+
+            const usize count = (usize)file.gcount();
+
+            if (count > content.size() - offset
+                || std::memcmp(buffer.data(), content.data() + offset, count) != 0)
+                return false;
+            offset += count;
+        }
+        return file.eof() && offset == content.size();
+    }
+
+    shared_texture_t TextureCache::find(const std::string& filename, const Frame& area)
+    {
+        const std::string key = pathKey(filename, area);
+        std::lock_guard lock(m_mutex);
+
+        if (m_enabled == false)
+            return nullptr;
+
+        const auto it = m_paths.find(key);
+
+        if (it != m_paths.end()) {
+            if (auto texture = it->second.lock()) {
+                ++m_hits;
+                return texture;
+            }
+        }
+        return nullptr;
+    }
+
+    shared_texture_t TextureCache::find(const std::string& filename, std::span<const u8> content, const Frame& area)
+    {
+        const u64 content_key = contentKey(content, area);
+        const std::string key = pathKey(filename, area);
+        shared_texture_t texture;
+        std::string source;
+        {
+            std::lock_guard lock(m_mutex);
+
+            if (m_enabled == false)
+                return nullptr;
+
+            const auto it = m_contents.find(content_key);
+
+            if (it != m_contents.end() && it->second.area == area && it->second.size == content.size()) {
+                texture = it->second.texture.lock();
+                source = it->second.filename;
+            }
+        }
+
+        // The file is read outside the lock, it may be large
+        const bool hit = texture && hasContent(source, content);
+        std::lock_guard lock(m_mutex);
+
+        if (hit == false) {
+            ++m_misses;
+            return nullptr;
+        }
+        ++m_content_hits;
+        m_paths[key] = texture;
+        return texture;
+    }
+
+    void TextureCache::insert(const std::string& filename, std::span<const u8> content, const Frame& area,
+                              const shared_texture_t& texture)
+    {
+        const std::string key = pathKey(filename, area);
+        const u64 content_key = content.empty() ? 0 : contentKey(content, area);
+        std::lock_guard lock(m_mutex);
+
+        if (m_enabled == false || texture == nullptr)
+            return;
+        m_paths[key] = texture;
+        m_textures[texture.get()] = texture;
+        if (content.empty() == false)
+            m_contents[content_key] = { texture, filename, content.size(), area };
+        if (++m_inserted % PruneInterval == 0)
+            prune();
+    }
+
+    void TextureCache::prune()
+    {
+        std::erase_if(m_paths, [](const auto& entry) { return entry.second.expired(); });
+        std::erase_if(m_contents, [](const auto& entry) { return entry.second.texture.expired(); });
+        std::erase_if(m_textures, [](const auto& entry) { return entry.second.expired(); });
+    }
+
+    bool TextureCache::contains(const shared_texture_t& texture) const
+    {
+        std::lock_guard lock(m_mutex);
+        const auto it = m_textures.find(texture.get());
+
+        // The address may belong to a freed texture
+        return it != m_textures.end() && it->second.lock() == texture;
+    }
+
+    TextureCache& TextureCache::setEnabled(bool enabled)
+    {
+        std::lock_guard lock(m_mutex);
+
+        m_enabled = enabled;
+        return *this;
+    }
+
+    bool TextureCache::isEnabled() const
+    {
+        std::lock_guard lock(m_mutex);
+
+        return m_enabled;
+    }
+
+    void TextureCache::clear()
+    {
+        std::lock_guard lock(m_mutex);
+
+        m_paths.clear();
+        m_contents.clear();
+        m_textures.clear();
+    }
+
+    usize TextureCache::size() const
+    {
+        std::lock_guard lock(m_mutex);
+        usize alive = 0;
+
+        for (const auto& [key, texture] : m_paths)
+            alive += texture.expired() == false;
+        return alive;
+    }
+
+    usize TextureCache::hits() const
+    {
+        std::lock_guard lock(m_mutex);
+
+        return m_hits;
+    }
+
+    usize TextureCache::contentHits() const
+    {
+        std::lock_guard lock(m_mutex);
+
+        return m_content_hits;
+    }
+
+    usize TextureCache::misses() const
+    {
+        std::lock_guard lock(m_mutex);
+
+        return m_misses;
+    }
+
+    TextureCache& TextureCache::instance()
+    {
+        if (!m_Instance)
+            m_Instance = new TextureCache();
+        return *m_Instance;
+    }
+
+    void TextureCache::destroy()
+    {
+        if (m_Instance)
+            delete m_Instance;
+        m_Instance = nullptr;
+    }
+}
@@ -0,0 +1,128 @@
+#include "Kat/components/texture_release.h"
+
+namespace kat {
+
+    TextureReleaseQueue *TextureReleaseQueue::m_Instance = nullptr;
+
+    void TextureReleaseQueue::push(sf::Texture *texture)
+    {
+        {
+            std::lock_guard lock(m_mutex);
+
+            if (m_deferred) {
+                m_queue.push_back(texture);
+                return;
+            }
+            ++m_destroyed;
+        }
+        delete texture;
+    }
+
+    usize TextureReleaseQueue::flush()
+    {
+        std::vector<sf::Texture *> batch;
+        {
+            std::lock_guard lock(m_mutex);
+
+            if (m_queue.empty()) {
+                m_last_batch = 0;
+                return 0;
+            }
+            batch.swap(m_queue);
+        }
+
+        const usize count = batch.size();
+
+        // Textures released while the batch is destroyed wait for the next flush
+        for (sf::Texture *texture : batch)
+            delete texture;
+
+        std::lock_guard lock(m_mutex);
+
+        m_destroyed += count;
+        m_last_batch = count;
+        return count;
+    }
+
+    TextureReleaseQueue& TextureReleaseQueue::setDeferred(bool deferred)
+    {
+        {
+            std::lock_guard lock(m_mutex);
+
+            m_deferred = deferred;
+        }
+        if (deferred == false)
+            flush();
+        return *this;
+    }
+
+    bool TextureReleaseQueue::isDeferred() const
+    {
+        std::lock_guard lock(m_mutex);
+
+        return m_deferred;
+    }
+
+    usize TextureReleaseQueue::pending() const
+    {
+        std::lock_guard lock(m_mutex);
+
+        return m_queue.size();
+    }
+
+    usize TextureReleaseQueue::destroyed() const
+    {
+        std::lock_guard lock(m_mutex);
+
+        return m_destroyed;
+    }
+
+    usize TextureReleaseQueue::lastBatch() const
+    {
+        std::lock_guard lock(m_mutex);
+
+        return m_last_batch;
+    }
+
+    TextureReleaseQueue::~TextureReleaseQueue()
+    {
+        for (sf::Texture *texture : m_queue)
+            delete texture;
+    }
+
+    TextureReleaseQueue& TextureReleaseQueue::instance()
+    {
+        // Textures are released by workers too
+        static std::mutex creation;
+        std::lock_guard lock(creation);
+
+        if (!m_Instance)
+            m_Instance = new TextureReleaseQueue();
+        return *m_Instance;
+    }
+
+    void TextureReleaseQueue::destroy()
+    {
+        if (m_Instance)
+            delete m_Instance;
+        m_Instance = nullptr;
+    }
+
+    void TextureDeleter::operator()(sf::Texture *texture) const
+    {
+        if (texture)
+            TextureReleaseQueue::instance().push(texture);
+    }
+
+    shared_texture_t makeSharedTexture()
+    {
+        return shared_texture_t(new sf::Texture(), TextureDeleter());
+    }
+
+    shared_texture_t makeSharedTexture(sf::Texture *texture)
+    {
+        if (texture == nullptr)
+            return nullptr;
+        return shared_texture_t(texture, TextureDeleter());
+    }
+}
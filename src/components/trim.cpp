@@ -0,0 +1,190 @@
+#include "Kat/components/trim.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace kat {
+
+    static float cross(const Position& o, const Position& a, const Position& b)
+    {
+        return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+    }
+
+    static float polygonArea(const FrameHull& hull)
+    {
+        float area = 0.0f;
+
+        for (usize i = 0; i < hull.size(); ++i) {
+            const auto& a = hull[i];
+            const auto& b = hull[(i + 1) % hull.size()];
+            area += a.x * b.y - b.x * a.y;
+        }
+        return std::abs(area) / 2.0f;
+    }
+
+    // Andrew's monotone chain, the points are sorted in place
+    static FrameHull convexHull(std::vector<Position>& points)
+    {
+        std::sort(points.begin(), points.end(), [](const Position& a, const Position& b) {
+            return a.x < b.x || (a.x == b.x && a.y < b.y);
+        });
+
+        FrameHull hull(points.size() * 2);
+        usize k = 0;
+
+        for (usize i = 0; i < points.size(); ++i) {
+            while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0)
+                --k;
+            hull[k++] = points[i];
+        }
+        for (usize i = points.size() - 1, t = k + 1; i > 0; --i) {
+            while (k >= t && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0)
+                --k;
+            hull[k++] = points[i - 1];
+        }
+        hull.resize(k - 1);
+        return hull;
+    }
+
+    // Removes edges of the hull by extending their neighbours until they meet,
+    // the polygon only ever grows so it still covers every opaque pixel.
+    static bool reduceHull(FrameHull& hull, usize max_points, const Position& size)
+    {
+        constexpr float epsilon = 1e-3f;
+
+        while (hull.size() > max_points) {
+            const usize n = hull.size();
+            float best_area = std::numeric_limits<float>::max();
+            usize best = n;
+            Position best_point;
+
+            for (usize i = 0; i < n; ++i) {
+                const auto& p = hull[(i + n - 1) % n];
+                const auto& a = hull[i];
+                const auto& b = hull[(i + 1) % n];
+                const auto& q = hull[(i + 2) % n];
+                const Position d1(a.x - p.x, a.y - p.y);
+                const Position d2(b.x - q.x, b.y - q.y);
+                const float denom = d1.x * d2.y - d1.y * d2.x;
+
+                if (std::abs(denom) < epsilon)
+                    continue;
+
+                const float t = ((b.x - a.x) * d2.y - (b.y - a.y) * d2.x) / denom;
+                const float s = ((b.x - a.x) * d1.y - (b.y - a.y) * d1.x) / denom;
+
+                if (t < 0.0f || s < 0.0f)
+                    continue;
+
+                const Position x(a.x + d1.x * t, a.y + d1.y * t);
+
+                if (x.x < -epsilon || x.y < -epsilon
+                    || x.x > size.x + epsilon || x.y > size.y + epsilon)
+                    continue;
+
+                const float area = std::abs(cross(a, x, b)) / 2.0f;
+
+                if (area < best_area) {
+                    best_area = area;
+                    best = i;
+                    best_point = x;
+                }
+            }
+            if (best == n)
+                return false;
+            hull[best] = best_point;
+            hull.erase(hull.begin() + (best + 1) % n);
+        }
+        return true;
+    }
+
+    static FrameHull buildHull(const sf::Image& image, const Frame& trimmed,
+                               const TrimSettings& settings)
+    {
+        const u8 *pixels = image.getPixelsPtr();
+        const usize stride = image.getSize().x * 4;
+        std::vector<Position> points;
+
+        for (i32 y = 0; y < trimmed.height; ++y) {
+            const u8 *row = pixels + (trimmed.top + y) * stride + trimmed.left * 4;
+            i32 min_x = trimmed.width;
+            i32 max_x = -1;
+
+            for (i32 x = 0; x < trimmed.width; ++x) {
+                if (row[x * 4 + 3] > settings.alpha_threshold) {
+                    min_x = std::min(min_x, x);
+                    max_x = x;
+                }
+            }
+            if (max_x < 0)
+                continue;
+            points.emplace_back((Coordinate)min_x, (Coordinate)y);
+            points.emplace_back((Coordinate)min_x, (Coordinate)(y + 1));
+            points.emplace_back((Coordinate)(max_x + 1), (Coordinate)y);
+            points.emplace_back((Coordinate)(max_x + 1), (Coordinate)(y + 1));
+        }
+
+        const Position size((Coordinate)trimmed.width, (Coordinate)trimmed.height);
+        FrameHull hull = convexHull(points);
+
+        if (hull.size() < 3 || reduceHull(hull, std::max<usize>(settings.hull_max_points, 3), size) == false)
+            return FrameHull();
+        if (polygonArea(hull) > size.x * size.y * settings.hull_max_coverage)
+            return FrameHull();
+        return hull;
+    }
+
+    FrameTrim trimFrame(const sf::Image& image, const Frame& frame, const TrimSettings& settings)
+    {
+        const u8 *pixels = image.getPixelsPtr();
+        const auto image_size = image.getSize();
+        const usize stride = image_size.x * 4;
+        const i32 right = std::min<i32>(frame.left + frame.width, image_size.x);
+        const i32 bottom = std::min<i32>(frame.top + frame.height, image_size.y);
+        i32 min_x = right, min_y = bottom, max_x = frame.left - 1, max_y = frame.top - 1;
+        FrameTrim trim;
+
+        trim.source = frame;
+        for (i32 y = std::max(frame.top, 0); y < bottom; ++y) {
+            const u8 *row = pixels + y * stride;
+
+            for (i32 x = std::max(frame.left, 0); x < right; ++x) {
+                if (row[x * 4 + 3] > settings.alpha_threshold) {
+                    min_x = std::min(min_x, x);
+                    max_x = std::max(max_x, x);
+                    min_y = std::min(min_y, y);
+                    max_y = y;
+                }
+            }
+        }
+
+        // Fully transparent frame, keep an empty rect at the frame origin
+        if (max_x < min_x) {
+            trim.trimmed = Frame(frame.left, frame.top, 0, 0);
+            return trim;
+        }
+
+        trim.trimmed = Frame(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+        trim.offset = Position((Coordinate)(min_x - frame.left), (Coordinate)(min_y - frame.top));
+        if (settings.build_hull
+            && (TextureCoordinate)(trim.trimmed.width * trim.trimmed.height) >= settings.hull_min_area) {
+            FrameHull hull = buildHull(image, trim.trimmed, settings);
+
+            if (hull.empty() == false)
+                trim.hull = std::make_shared<const FrameHull>(std::move(hull));
+        }
+        return trim;
+    }
+
+    FrameTrimList trimFrames(const sf::Image& image, const std::vector<Frame>& frames,
+                             const TrimSettings& settings)
+    {
+        FrameTrimList trims;
+
+        trims.reserve(frames.size());
+        for (const auto& frame : frames)
+            trims.push_back(trimFrame(image, frame, settings));
+        return trims;
+    }
+}
@@ -0,0 +1,96 @@
+#include "Kat/effects.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace kat {
+
+    // The effect of each vertex is a texel of the effect texture of its run, the vertex
+    // color is left to the color of the sprite
+    static const char *uber_vertex_shader = R"(
+        #version 130
+
+        uniform sampler2D kat_effects;
+
+        flat out vec4 kat_effect;
+
+        void main()
+        {
+            int width = textureSize(kat_effects, 0).x;
+
+            gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
+            gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;
+            gl_FrontColor = gl_Color;
+            kat_effect = texelFetch(kat_effects, ivec2(gl_VertexID % width, gl_VertexID / width), 0);
+        }
+    )";
+
+    static const char *uber_fragment_shader = R"(
+        #version 130
+
+        uniform sampler2D kat_texture;
+        uniform vec2 kat_texel;
+
+        flat in vec4 kat_effect;
+
+        void main()
+        {
+            vec2 uv = gl_TexCoord[0].xy;
+            vec4 base = texture2D(kat_texture, uv);
+            float bits = floor(kat_effect.a * 255.0 + 0.5);
+            float effect = floor(bits / 32.0);
+            float strength = mod(bits, 32.0) / 31.0;
+            vec3 color = kat_effect.rgb;
+            vec4 result = base;
+
+            if (effect < 0.5) {
+                result = base * vec4(color, strength);
+            } else if (effect < 1.5) {
+                result.rgb = mix(base.rgb, base.rgb * color, strength);
+            } else if (effect < 2.5) {
+                result.rgb = mix(base.rgb, color, strength);
+            } else if (effect < 3.5) {
+                float noise = fract(sin(dot(floor(uv / kat_texel), vec2(12.9898, 78.233))) * 43758.5453);
+                if (noise < strength)
+                    discard;
+                if (noise < strength + 0.05 && strength > 0.0)
+                    result.rgb = color;
+            } else if (effect < 4.5) {
+                float around = max(
+                    max(texture2D(kat_texture, uv + vec2(kat_texel.x, 0.0)).a,
+                        texture2D(kat_texture, uv - vec2(kat_texel.x, 0.0)).a),
+                    max(texture2D(kat_texture, uv + vec2(0.0, kat_texel.y)).a,
+                        texture2D(kat_texture, uv - vec2(0.0, kat_texel.y)).a));
+                if (base.a < 0.5)
+                    result = vec4(color, around * strength);
+            } else {
+                float gray = dot(base.rgb, vec3(0.299, 0.587, 0.114));
+                result.rgb = mix(base.rgb, vec3(gray) * color, strength);
+            }
+            // Modulated by the color of the sprite whatever the effect, like sfml does
+            gl_FragColor = result * gl_Color;
+        }
+    )";
+
+    sf::Color encodeEffect(const EffectParams& params)
+    {
+        const u8 strength = (u8)std::lround(std::clamp(params.strength, 0.0f, 1.0f) * 31.0f);
+
+        return sf::Color(params.color.r, params.color.g, params.color.b,
+                         (u8)(((u8)params.effect & 0x7) << 5 | strength));
+    }
+
+    sf::Shader* uberShader()
+    {
+        static sf::Shader shader;
+        static const bool loaded = [] {
+            if (sf::Shader::isAvailable() == false
+                || shader.loadFromMemory(uber_vertex_shader, uber_fragment_shader) == false)
+                return false;
+            shader.setUniform("kat_texture", sf::Shader::CurrentTexture);
+            return true;
+        }();
+
+        return loaded ? &shader : nullptr;
+    }
+}
@@ -0,0 +1,193 @@
+#include "Kat/gpu_batch.h"
+
+#include <SFML/Graphics/RenderTarget.hpp>
+
+#include <bit>
+#include <cstring>
+
+namespace kat {
+
+    static const char *gpu_batch_vertex_shader = R"(
+        #version 130
+
+        uniform sampler2D kat_data;
+        uniform vec2 kat_texture_size;
+
+        out vec4 kat_color;
+        out vec2 kat_uv;
+
+        const int data_width = 1024;
+
+        vec4 katTexel(int index)
+        {
+            return texelFetch(kat_data, ivec2(index % data_width, index / data_width), 0);
+        }
+
+        float katFloat(int index)
+        {
+            uvec4 b = uvec4(katTexel(index) * 255.0 + 0.5);
+            return uintBitsToFloat(b.r | (b.g << 8u) | (b.b << 16u) | (b.a << 24u));
+        }
+
+        void main()
+        {
+            int corner = int(gl_Vertex.x + 0.5);
+            int base = int(gl_Vertex.y + 0.5) * 12;
+
+            vec2 position = vec2(katFloat(base), katFloat(base + 1));
+            float rotation = katFloat(base + 2);
+            vec2 scale = vec2(katFloat(base + 4), katFloat(base + 5));
+            vec2 origin = vec2(katFloat(base + 6), katFloat(base + 7));
+            vec4 rect = vec4(katFloat(base + 8), katFloat(base + 9),
+                             katFloat(base + 10), katFloat(base + 11));
+
+            // Two triangles: (0, 0) (1, 0) (0, 1) / (0, 1) (1, 0) (1, 1)
+            vec2 unit = vec2(corner == 1 || corner >= 4 ? 1.0 : 0.0,
+                             corner == 2 || corner == 3 || corner == 5 ? 1.0 : 0.0);
+            vec2 local = (unit * abs(rect.zw) - origin) * scale;
+            float c = cos(rotation);
+            float s = sin(rotation);
+            vec2 world = position + vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+
+            gl_Position = gl_ModelViewProjectionMatrix * vec4(world, 0.0, 1.0);
+            kat_color = katTexel(base + 3);
+            kat_uv = (rect.xy + unit * rect.zw) / kat_texture_size;
+        }
+    )";
+
+    static const char *gpu_batch_fragment_shader = R"(
+        #version 130
+
+        uniform sampler2D kat_texture;
+
+        in vec4 kat_color;
+        in vec2 kat_uv;
+
+        void main()
+        {
+            gl_FragColor = texture(kat_texture, kat_uv) * kat_color;
+        }
+    )";
+
+    // Loaded on first use, a gl context has to be active
+    static sf::Shader *gpuBatchShader()
+    {
+        static sf::Shader shader;
+        static const bool loaded = shader.loadFromMemory(gpu_batch_vertex_shader, gpu_batch_fragment_shader);
+
+        return loaded ? &shader : nullptr;
+    }
+
+    bool GpuSpriteBatch::isAvailable()
+    {
+        return std::endian::native == std::endian::little
+            && sf::Shader::isAvailable() && sf::VertexBuffer::isAvailable();
+    }
+
+    GpuSpriteBatch::GpuSpriteBatch()
+        : m_template(sf::PrimitiveType::Triangles, sf::VertexBuffer::Static)
+    {
+    }
+
+    GpuSpriteBatch& GpuSpriteBatch::setTexture(const Texture& texture)
+    {
+        m_texture = texture;
+        return *this;
+    }
+
+    GpuSpriteBatch& GpuSpriteBatch::reserve(usize count)
+    {
+        if (count <= m_capacity)
+            return *this;
+
+        std::vector<sf::Vertex> vertices(count * 6);
+
+        for (usize i = 0; i < count; ++i) {
+            for (usize corner = 0; corner < 6; ++corner) {
+                vertices[i * 6 + corner].position = { (f32)corner, (f32)i };
+            }
+        }
+        m_template.create(vertices.size());
+        m_template.update(vertices.data());
+
+        const u32 rows = (u32)((count * FloatsPerSprite + DataWidth - 1) / DataWidth);
+
+        m_data.resize(rows * DataWidth);
+        m_data_texture.create({ DataWidth, rows });
+        m_capacity = count;
+        m_dirty = true;
+        return *this;
+    }
+
+    GpuSpriteBatch& GpuSpriteBatch::add(const Position& position, const Angle& rotation,
+                                        const Scale& scale, const Position& origin,
+                                        const Frame& rect, const Color& color)
+    {
+        if (m_count == m_capacity)
+            reserve(m_capacity ? m_capacity * 2 : 1024);
+
+        f32 *data = m_data.data() + m_count * FloatsPerSprite;
+        const u32 packed_color = (u32)color.r | (u32)color.g << 8 | (u32)color.b << 16 | (u32)color.a << 24;
+
+        data[0] = position.x;
+        data[1] = position.y;
+        data[2] = rotation.asRadians();
+        std::memcpy(&data[3], &packed_color, sizeof(packed_color));
+        data[4] = scale.x;
+        data[5] = scale.y;
+        data[6] = origin.x;
+        data[7] = origin.y;
+        data[8] = (f32)rect.left;
+        data[9] = (f32)rect.top;
+        data[10] = (f32)rect.width;
+        data[11] = (f32)rect.height;
+        ++m_count;
+        m_dirty = true;
+        return *this;
+    }
+
+    GpuSpriteBatch& GpuSpriteBatch::add(const Sprite& sprite)
+    {
+        const sf::Sprite *handle = sprite.raw_handle();
+
+        return add(handle->getPosition(), handle->getRotation(), handle->getScale(),
+                   handle->getOrigin(), handle->getTextureRect(), handle->getColor());
+    }
+
+    GpuSpriteBatch& GpuSpriteBatch::clear()
+    {
+        m_count = 0;
+        return *this;
+    }
+
+    usize GpuSpriteBatch::size() const
+    {
+        return m_count;
+    }
+
+    void GpuSpriteBatch::draw(sf::RenderTarget& target, const sf::RenderStates& states) const
+    {
+        sf::Shader *shader = gpuBatchShader();
+        const sf::Texture *texture = m_texture.raw_handle();
+
+        if (m_count == 0 || shader == nullptr || texture == nullptr)
+            return;
+        if (m_dirty) {
+            // Only the rows holding sprites are uploaded
+            const u32 rows = (u32)((m_count * FloatsPerSprite + DataWidth - 1) / DataWidth);
+
+            m_data_texture.update(reinterpret_cast<const u8 *>(m_data.data()), { DataWidth, rows }, { 0, 0 });
+            m_dirty = false;
+        }
+
+        const auto texture_size = texture->getSize();
+        sf::RenderStates batch_states(states);
+
+        shader->setUniform("kat_data", m_data_texture);
+        shader->setUniform("kat_texture", *texture);
+        shader->setUniform("kat_texture_size", sf::Glsl::Vec2((f32)texture_size.x, (f32)texture_size.y));
+        batch_states.shader = shader;
+        batch_states.texture = nullptr;
+        target.draw(m_template, 0, m_count * 6, batch_states);
+    }
+}
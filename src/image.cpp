@@ -0,0 +1,575 @@
+#include "Kat/image.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KAT_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace kat {
+
+    namespace {
+
+        /**
+         * @brief The kernels of an instruction set.
+         */
+        struct Kernels {
+            void (*premultiply)(u8 *pixels, usize count);
+            void (*colorKey)(u8 *pixels, usize count, u32 key);
+            void (*swizzle)(u8 *pixels, usize count, const Swizzle& order);
+            void (*reverse)(u8 *row, usize count);
+            void (*halveRow)(const u8 *top, const u8 *bottom, u8 *output, usize width);
+        };
+
+        /**
+         * @brief Divides by 255 with rounding, exactly, for values up to 255 * 255.
+         */
+        inline u32 divide255(u32 value)
+        {
+            value += 128;
+            return (value + (value >> 8)) >> 8;
+        }
+
+        void premultiplyScalar(u8 *pixels, usize count)
+        {
+            for (usize i = 0; i < count; ++i, pixels += 4) {
+                const u32 alpha = pixels[3];
+
+                pixels[0] = (u8)divide255(pixels[0] * alpha);
+                pixels[1] = (u8)divide255(pixels[1] * alpha);
+                pixels[2] = (u8)divide255(pixels[2] * alpha);
+            }
+        }
+
+        void colorKeyScalar(u8 *pixels, usize count, u32 key)
+        {
+            for (usize i = 0; i < count; ++i, pixels += 4) {
+                u32 pixel;
+
+                std::memcpy(&pixel, pixels, sizeof(pixel));
+                if ((pixel & 0x00ffffff) == key)
+                    std::memset(pixels, 0, 4);
+            }
+        }
+
+        void swizzleScalar(u8 *pixels, usize count, const Swizzle& order)
+        {
+            for (usize i = 0; i < count; ++i, pixels += 4) {
+                const u8 source[4] = { pixels[0], pixels[1], pixels[2], pixels[3] };
+
+                pixels[0] = source[order[0]];
+                pixels[1] = source[order[1]];
+                pixels[2] = source[order[2]];
+                pixels[3] = source[order[3]];
+            }
+        }
+
+        void reverseScalar(u8 *row, usize count)
+        {
+            auto *pixels = reinterpret_cast<u32 *>(row);
+
+            std::reverse(pixels, pixels + count);
+        }
+
+        void halveRowScalar(const u8 *top, const u8 *bottom, u8 *output, usize width)
+        {
+            for (usize x = 0; x < width; ++x, top += 8, bottom += 8, output += 4) {
+                for (usize c = 0; c < 4; ++c)
+                    output[c] = (u8)((top[c] + top[c + 4] + bottom[c] + bottom[c + 4] + 2) >> 2);
+            }
+        }
+
+        constexpr Kernels ScalarKernels = {
+            premultiplyScalar, colorKeyScalar, swizzleScalar, reverseScalar, halveRowScalar
+        };
+
+#ifdef KAT_X86_SIMD
+        /**
+         * @brief Premultiplies two pixels widened to 16-bit channels.
+         */
+        __attribute__((target("sse2"), always_inline))
+        inline __m128i multiplyAlphaSSE2(__m128i colors)
+        {
+            const __m128i color_mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+            const __m128i alpha_one = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+            __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(colors, 0xff), 0xff);
+
+            // The alpha is multiplied by 255, which keeps it
+            alpha = _mm_or_si128(_mm_and_si128(alpha, color_mask), alpha_one);
+
+            const __m128i product = _mm_add_epi16(_mm_mullo_epi16(colors, alpha), _mm_set1_epi16(128));
+
+            return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+        }
+
+        __attribute__((target("sse2")))
+        void premultiplySSE2(u8 *pixels, usize count)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            usize i = 0;
+
+            for (; i + 4 <= count; i += 4) {
+                auto *address = reinterpret_cast<__m128i *>(pixels + i * 4);
+                const __m128i block = _mm_loadu_si128(address);
+                const __m128i low = multiplyAlphaSSE2(_mm_unpacklo_epi8(block, zero));
+                const __m128i high = multiplyAlphaSSE2(_mm_unpackhi_epi8(block, zero));
+
+                _mm_storeu_si128(address, _mm_packus_epi16(low, high));
+            }
+            premultiplyScalar(pixels + i * 4, count - i);
+        }
+
+        __attribute__((target("sse2")))
+        void colorKeySSE2(u8 *pixels, usize count, u32 key)
+        {
+            const __m128i mask = _mm_set1_epi32(0x00ffffff);
+            const __m128i keys = _mm_set1_epi32((int)key);
+            usize i = 0;
+
+            for (; i + 4 <= count; i += 4) {
+                auto *address = reinterpret_cast<__m128i *>(pixels + i * 4);
+                const __m128i block = _mm_loadu_si128(address);
+                const __m128i keyed = _mm_cmpeq_epi32(_mm_and_si128(block, mask), keys);
+
+                _mm_storeu_si128(address, _mm_andnot_si128(keyed, block));
+            }
+            colorKeyScalar(pixels + i * 4, count - i, key);
+        }
+
+        __attribute__((target("sse2")))
+        void reverseSSE2(u8 *row, usize count)
+        {
+            usize left = 0;
+            usize right = count;
+
+            // Swaps blocks of 4 pixels from both ends, reversing them
+            while (right - left >= 8) {
+                auto *left_address = reinterpret_cast<__m128i *>(row + left * 4);
+                auto *right_address = reinterpret_cast<__m128i *>(row + (right - 4) * 4);
+                const __m128i left_block = _mm_loadu_si128(left_address);
+                const __m128i right_block = _mm_loadu_si128(right_address);
+
+                _mm_storeu_si128(left_address, _mm_shuffle_epi32(right_block, _MM_SHUFFLE(0, 1, 2, 3)));
+                _mm_storeu_si128(right_address, _mm_shuffle_epi32(left_block, _MM_SHUFFLE(0, 1, 2, 3)));
+                left += 4;
+                right -= 4;
+            }
+            reverseScalar(row + left * 4, right - left);
+        }
+
+        __attribute__((target("sse2")))
+        void halveRowSSE2(const u8 *top, const u8 *bottom, u8 *output, usize width)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i two = _mm_set1_epi16(2);
+            usize x = 0;
+
+            for (; x + 2 <= width; x += 2) {
+                const __m128i top_block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + x * 8));
+                const __m128i bottom_block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + x * 8));
+                const __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top_block, zero), _mm_unpacklo_epi8(bottom_block, zero));
+                const __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top_block, zero), _mm_unpackhi_epi8(bottom_block, zero));
+                // The low half of each sum holds the sum of a pair of columns
+                const __m128i first = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+                const __m128i second = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+                const __m128i sums = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(first, second), two), 2);
+
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(output + x * 4), _mm_packus_epi16(sums, zero));
+            }
+            halveRowScalar(top + x * 8, bottom + x * 8, output + x * 4, width - x);
+        }
+
+        __attribute__((target("ssse3")))
+        void swizzleSSSE3(u8 *pixels, usize count, const Swizzle& order)
+        {
+            alignas(16) u8 indices[16];
+            usize i = 0;
+
+            for (usize p = 0; p < 4; ++p) {
+                for (usize c = 0; c < 4; ++c)
+                    indices[p * 4 + c] = (u8)(p * 4 + (order[c] & 3));
+            }
+
+            const __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i *>(indices));
+
+            for (; i + 4 <= count; i += 4) {
+                auto *address = reinterpret_cast<__m128i *>(pixels + i * 4);
+
+                _mm_storeu_si128(address, _mm_shuffle_epi8(_mm_loadu_si128(address), shuffle));
+            }
+            swizzleScalar(pixels + i * 4, count - i, order);
+        }
+
+        /**
+         * @brief Premultiplies four pixels widened to 16-bit channels.
+         */
+        __attribute__((target("avx2"), always_inline))
+        inline __m256i multiplyAlphaAVX2(__m256i colors)
+        {
+            const __m256i color_mask = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1);
+            const __m256i alpha_one = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+            __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(colors, 0xff), 0xff);
+
+            alpha = _mm256_or_si256(_mm256_and_si256(alpha, color_mask), alpha_one);
+
+            const __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(colors, alpha), _mm256_set1_epi16(128));
+
+            return _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+        }
+
+        __attribute__((target("avx2")))
+        void premultiplyAVX2(u8 *pixels, usize count)
+        {
+            const __m256i zero = _mm256_setzero_si256();
+            usize i = 0;
+
+            // Unpacking and packing work within 128-bit lanes, so the order is kept
+            for (; i + 8 <= count; i += 8) {
+                auto *address = reinterpret_cast<__m256i *>(pixels + i * 4);
+                const __m256i block = _mm256_loadu_si256(address);
+                const __m256i low = multiplyAlphaAVX2(_mm256_unpacklo_epi8(block, zero));
+                const __m256i high = multiplyAlphaAVX2(_mm256_unpackhi_epi8(block, zero));
+
+                _mm256_storeu_si256(address, _mm256_packus_epi16(low, high));
+            }
+            premultiplySSE2(pixels + i * 4, count - i);
+        }
+
+        __attribute__((target("avx2")))
+        void colorKeyAVX2(u8 *pixels, usize count, u32 key)
+        {
+            const __m256i mask = _mm256_set1_epi32(0x00ffffff);
+            const __m256i keys = _mm256_set1_epi32((int)key);
+            usize i = 0;
+
+            for (; i + 8 <= count; i += 8) {
+                auto *address = reinterpret_cast<__m256i *>(pixels + i * 4);
+                const __m256i block = _mm256_loadu_si256(address);
+                const __m256i keyed = _mm256_cmpeq_epi32(_mm256_and_si256(block, mask), keys);
+
+                _mm256_storeu_si256(address, _mm256_andnot_si256(keyed, block));
+            }
+            colorKeySSE2(pixels + i * 4, count - i, key);
+        }
+
+        __attribute__((target("avx2")))
+        void swizzleAVX2(u8 *pixels, usize count, const Swizzle& order)
+        {
+            alignas(32) u8 indices[32];
+            usize i = 0;
+
+            // The shuffle works within 128-bit lanes, indices are relative to the lane
+            for (usize p = 0; p < 8; ++p) {
+                for (usize c = 0; c < 4; ++c)
+                    indices[p * 4 + c] = (u8)((p % 4) * 4 + (order[c] & 3));
+            }
+
+            const __m256i shuffle = _mm256_load_si256(reinterpret_cast<const __m256i *>(indices));
+
+            for (; i + 8 <= count; i += 8) {
+                auto *address = reinterpret_cast<__m256i *>(pixels + i * 4);
+
+                _mm256_storeu_si256(address, _mm256_shuffle_epi8(_mm256_loadu_si256(address), shuffle));
+            }
+            swizzleSSSE3(pixels + i * 4, count - i, order);
+        }
+
+        constexpr Kernels SSE2Kernels = {
+            premultiplySSE2, colorKeySSE2, swizzleScalar, reverseSSE2, halveRowSSE2
+        };
+
+        constexpr Kernels SSSE3Kernels = {
+            premultiplySSE2, colorKeySSE2, swizzleSSSE3, reverseSSE2, halveRowSSE2
+        };
+
+        constexpr Kernels AVX2Kernels = {
+            premultiplyAVX2, colorKeyAVX2, swizzleAVX2, reverseSSE2, halveRowSSE2
+        };
+#endif
+
+        SimdLevel detectSimdLevel()
+        {
+#ifdef KAT_X86_SIMD
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return SimdLevel::AVX2;
+            if (__builtin_cpu_supports("ssse3"))
+                return SimdLevel::SSSE3;
+            if (__builtin_cpu_supports("sse2"))
+                return SimdLevel::SSE2;
+#endif
+            return SimdLevel::Scalar;
+        }
+
+        const Kernels& kernelsOf(SimdLevel level)
+        {
+            switch (level) {
+#ifdef KAT_X86_SIMD
+            case SimdLevel::AVX2:
+                return AVX2Kernels;
+            case SimdLevel::SSSE3:
+                return SSSE3Kernels;
+            case SimdLevel::SSE2:
+                return SSE2Kernels;
+#endif
+            default:
+                return ScalarKernels;
+            }
+        }
+
+        const SimdLevel SupportedLevel = detectSimdLevel();
+        SimdLevel CurrentLevel = SupportedLevel;
+        const Kernels *CurrentKernels = &kernelsOf(SupportedLevel);
+    }
+
+    SimdLevel simdLevel()
+    {
+        return CurrentLevel;
+    }
+
+    SimdLevel setSimdLevel(SimdLevel level)
+    {
+        CurrentLevel = std::min(level, SupportedLevel);
+        CurrentKernels = &kernelsOf(CurrentLevel);
+        return CurrentLevel;
+    }
+
+    void premultiply(Pixels pixels, usize count)
+    {
+        const Kernels& kernels = *CurrentKernels;
+
+        parallelFor(count, Image::ParallelThreshold, [&](usize begin, usize end) {
+            kernels.premultiply(pixels + begin * 4, end - begin);
+        });
+    }
+
+    void unpremultiply(Pixels pixels, usize count)
+    {
+        // A division per channel, the reciprocal of each alpha is computed once
+        u32 reciprocals[256];
+
+        reciprocals[0] = 0;
+        for (u32 alpha = 1; alpha < 256; ++alpha)
+            reciprocals[alpha] = (255u * 65536u + alpha / 2) / alpha;
+
+        parallelFor(count, Image::ParallelThreshold, [&](usize begin, usize end) {
+            for (u8 *pixel = pixels + begin * 4; pixel != pixels + end * 4; pixel += 4) {
+                const u32 reciprocal = reciprocals[pixel[3]];
+
+                for (usize c = 0; c < 3; ++c)
+                    pixel[c] = (u8)std::min<u32>(255, (pixel[c] * reciprocal + 32768) >> 16);
+            }
+        });
+    }
+
+    void colorKey(Pixels pixels, usize count, const Color& key)
+    {
+        const Kernels& kernels = *CurrentKernels;
+        const u8 bytes[4] = { key.r, key.g, key.b, 0 };
+        u32 packed;
+
+        std::memcpy(&packed, bytes, sizeof(packed));
+        parallelFor(count, Image::ParallelThreshold, [&](usize begin, usize end) {
+            kernels.colorKey(pixels + begin * 4, end - begin, packed);
+        });
+    }
+
+    void swizzle(Pixels pixels, usize count, const Swizzle& order)
+    {
+        const Kernels& kernels = *CurrentKernels;
+
+        parallelFor(count, Image::ParallelThreshold, [&](usize begin, usize end) {
+            kernels.swizzle(pixels + begin * 4, end - begin, order);
+        });
+    }
+
+    Image& Image::create(const TextureSize& size, const Color& color)
+    {
+        const u8 bytes[4] = { color.r, color.g, color.b, color.a };
+
+        m_size = size;
+        m_pixels.resize((usize)size.x * size.y * 4);
+        for (usize i = 0; i < m_pixels.size(); i += 4)
+            std::memcpy(m_pixels.data() + i, bytes, 4);
+        return *this;
+    }
+
+    Image& Image::load(const u8 *pixels, const TextureSize& size)
+    {
+        m_size = size;
+        m_pixels.assign(pixels, pixels + (usize)size.x * size.y * 4);
+        return *this;
+    }
+
+    Image& Image::load(const sf::Image& image)
+    {
+        const auto size = image.getSize();
+
+        if (image.getPixelsPtr() == nullptr)
+            return create(TextureSize(0, 0));
+        return load(image.getPixelsPtr(), TextureSize(size.x, size.y));
+    }
+
+    TextureSize Image::size() const
+    {
+        return m_size;
+    }
+
+    Pixels Image::pixels()
+    {
+        return m_pixels.data();
+    }
+
+    const u8 *Image::pixels() const
+    {
+        return m_pixels.data();
+    }
+
+    Image& Image::premultiply()
+    {
+        kat::premultiply(m_pixels.data(), m_pixels.size() / 4);
+        return *this;
+    }
+
+    Image& Image::unpremultiply()
+    {
+        kat::unpremultiply(m_pixels.data(), m_pixels.size() / 4);
+        return *this;
+    }
+
+    Image& Image::colorKey(const Color& key)
+    {
+        kat::colorKey(m_pixels.data(), m_pixels.size() / 4, key);
+        return *this;
+    }
+
+    Image& Image::swizzle(const Swizzle& order)
+    {
+        kat::swizzle(m_pixels.data(), m_pixels.size() / 4, order);
+        return *this;
+    }
+
+    Image& Image::flipHorizontally()
+    {
+        const Kernels& kernels = *CurrentKernels;
+        const usize rows_per_grain = ParallelThreshold / std::max<usize>(m_size.x, 1);
+
+        parallelFor(m_size.y, rows_per_grain, [&](usize begin, usize end) {
+            for (usize y = begin; y < end; ++y)
+                kernels.reverse(m_pixels.data() + y * m_size.x * 4, m_size.x);
+        });
+        return *this;
+    }
+
+    Image& Image::flipVertically()
+    {
+        const usize row = (usize)m_size.x * 4;
+        const usize rows_per_grain = ParallelThreshold / std::max<usize>(m_size.x, 1);
+
+        // Each range of the top half swaps with its mirror in the bottom half
+        parallelFor(m_size.y / 2, rows_per_grain, [&](usize begin, usize end) {
+            std::vector<u8> swap(row);
+
+            for (usize y = begin; y < end; ++y) {
+                u8 *top = m_pixels.data() + y * row;
+                u8 *bottom = m_pixels.data() + (m_size.y - 1 - y) * row;
+
+                std::memcpy(swap.data(), top, row);
+                std::memcpy(top, bottom, row);
+                std::memcpy(bottom, swap.data(), row);
+            }
+        });
+        return *this;
+    }
+
+    Image Image::halve(DownscaleFilter filter) const
+    {
+        const TextureSize size(std::max<TextureCoordinate>(m_size.x / 2, 1),
+                               std::max<TextureCoordinate>(m_size.y / 2, 1));
+        const usize rows_per_grain = ParallelThreshold / std::max<usize>(size.x * 4, 1);
+        Image result;
+
+        result.m_size = size;
+        result.m_pixels.resize((usize)size.x * size.y * 4);
+        if (m_pixels.empty())
+            return result;
+
+        const auto at = [this](i64 x, i64 y) {
+            x = std::clamp<i64>(x, 0, m_size.x - 1);
+            y = std::clamp<i64>(y, 0, m_size.y - 1);
+            return m_pixels.data() + ((usize)y * m_size.x + x) * 4;
+        };
+
+        if (filter == DownscaleFilter::Box && m_size.x >= 2 && m_size.y >= 2) {
+            const Kernels& kernels = *CurrentKernels;
+
+            parallelFor(size.y, rows_per_grain, [&](usize begin, usize end) {
+                for (usize y = begin; y < end; ++y)
+                    kernels.halveRow(at(0, y * 2), at(0, y * 2 + 1), result.m_pixels.data() + y * size.x * 4, size.x);
+            });
+            return result;
+        }
+
+        // 1 3 3 1 in both directions, the box filter of 1 pixel wide images lands here too
+        static constexpr u32 GaussianWeights[4] = { 1, 3, 3, 1 };
+        static constexpr u32 BoxWeights[4] = { 0, 1, 1, 0 };
+        const u32 *weights = filter == DownscaleFilter::Gaussian ? GaussianWeights : BoxWeights;
+        const u32 total = filter == DownscaleFilter::Gaussian ? 64 : 4;
+
+        parallelFor(size.y, rows_per_grain, [&](usize begin, usize end) {
+            for (usize y = begin; y < end; ++y) {
+                for (usize x = 0; x < size.x; ++x) {
+                    u32 sums[4] = {};
+
+                    for (i64 j = 0; j < 4; ++j) {
+                        for (i64 i = 0; i < 4; ++i) {
+                            const u32 weight = weights[i] * weights[j];
+                            const u8 *pixel = at((i64)x * 2 - 1 + i, (i64)y * 2 - 1 + j);
+
+                            for (usize c = 0; c < 4; ++c)
+                                sums[c] += pixel[c] * weight;
+                        }
+                    }
+
+                    u8 *output = result.m_pixels.data() + (y * size.x + x) * 4;
+
+                    for (usize c = 0; c < 4; ++c)
+                        output[c] = (u8)((sums[c] + total / 2) / total);
+                }
+            }
+        });
+        return result;
+    }
+
+    Image Image::downscale(const TextureSize& max_size, DownscaleFilter filter) const
+    {
+        Image result = *this;
+
+        while ((result.m_size.x > max_size.x && result.m_size.x > 1)
+               || (result.m_size.y > max_size.y && result.m_size.y > 1))
+            result = result.halve(filter);
+        return result;
+    }
+
+    sf::Image Image::toSfml() const
+    {
+        sf::Image image;
+
+        if (m_pixels.empty() == false)
+            image.create({ m_size.x, m_size.y }, m_pixels.data());
+        return image;
+    }
+
+    Texture Image::toTexture() const
+    {
+        Texture texture;
+
+        texture.create(m_size);
+        if (texture.raw_handle() && m_pixels.empty() == false)
+            texture.update(const_cast<u8 *>(m_pixels.data()));
+        return texture;
+    }
+}
@@ -0,0 +1,237 @@
+#include "Kat/image_cache.h"
+#include "Kat/pak.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace kat {
+
+    namespace {
+
+        /// FNV-1a
+        u64 hashBytes(const void *data, usize size, u64 hash = 0xcbf29ce484222325ULL)
+        {
+            const auto *bytes = static_cast<const u8 *>(data);
+
+            for (usize i = 0; i < size; ++i) {
+                hash ^= bytes[i];
+                hash *= 0x100000001b3ULL;
+            }
+            return hash;
+        }
+
+        std::string hexName(u64 hash)
+        {
+            char name[17];
+
+            std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+            return name;
+        }
+    }
+
+    ImageCache *ImageCache::m_Instance = nullptr;
+
+    ImageCache& ImageCache::setDirectory(const std::string& directory)
+    {
+        flush();
+
+        std::lock_guard lock(m_mutex);
+        std::error_code error;
+
+        if (directory.empty() == false)
+            std::filesystem::create_directories(directory, error);
+        m_directory = error ? std::string() : directory;
+        return *this;
+    }
+
+    const std::string& ImageCache::getDirectory() const
+    {
+        return m_directory;
+    }
+
+    bool ImageCache::isEnabled() const
+    {
+        return m_directory.empty() == false;
+    }
+
+    std::optional<ImageCache::Source> ImageCache::source(const std::string& filename)
+    {
+        std::error_code error;
+        const auto path = std::filesystem::weakly_canonical(filename, error);
+        const auto time = std::filesystem::last_write_time(path, error);
+
+        if (error)
+            return std::nullopt;
+
+        const auto size = std::filesystem::file_size(path, error);
+
+        if (error)
+            return std::nullopt;
+        return Source{ path.generic_string(), (i64)time.time_since_epoch().count(), (u64)size };
+    }
+
+    std::string ImageCache::prefix(const Source& source)
+    {
+        return hexName(hashBytes(source.path.data(), source.path.size())) + "-";
+    }
+
+    std::string ImageCache::path(const Source& source) const
+    {
+        u64 hash = hashBytes(source.path.data(), source.path.size());
+
+        hash = hashBytes(&source.time, sizeof(source.time), hash);
+        hash = hashBytes(&source.size, sizeof(source.size), hash);
+        return m_directory + "/" + prefix(source) + hexName(hash) + ".kimg";
+    }
+
+    std::optional<CachedImage> ImageCache::find(const std::string& filename)
+    {
+        const auto file = source(filename);
+        CachedImage cached;
+        FileHeader header;
+
+        if (!file || cached.file.open(path(*file)) == false) {
+            ++m_misses;
+            return std::nullopt;
+        }
+
+        const auto bytes = cached.file.bytes();
+
+        if (bytes.size() >= sizeof(header))
+            std::memcpy(&header, bytes.data(), sizeof(header));
+        // The name of the cache file is a hash, the version of the image file is checked in full
+        if (bytes.size() < sizeof(header) || std::memcmp(header.magic, "KIMC", 4) != 0
+            || header.version != 2 || header.time != file->time || header.size != file->size
+            || header.path_size != file->path.size() || bytes.size() - sizeof(header) < header.path_size
+            || std::memcmp(bytes.data() + sizeof(header), file->path.data(), header.path_size) != 0) {
+            ++m_misses;
+            return std::nullopt;
+        }
+        cached.image = bytes.subspan(sizeof(header) + header.path_size);
+        ++m_hits;
+        return cached;
+    }
+
+    void ImageCache::store(const std::string& filename, sf::Image image)
+    {
+        auto file = source(filename);
+
+        if (!file || isEnabled() == false)
+            return;
+        {
+            std::lock_guard lock(m_mutex);
+
+            m_writes.push_back({ std::move(*file), std::move(image) });
+            if (m_thread.joinable() == false)
+                m_thread = std::thread(&ImageCache::work, this);
+        }
+        m_wake.notify_one();
+    }
+
+    void ImageCache::flush()
+    {
+        std::unique_lock lock(m_mutex);
+
+        m_idle.wait(lock, [this] { return m_writes.empty() && m_writing == false; });
+    }
+
+    usize ImageCache::hits() const
+    {
+        return m_hits;
+    }
+
+    usize ImageCache::misses() const
+    {
+        return m_misses;
+    }
+
+    void ImageCache::work()
+    {
+        std::unique_lock lock(m_mutex);
+
+        while (true) {
+            m_wake.wait(lock, [this] { return m_stop || m_writes.empty() == false; });
+            if (m_writes.empty())
+                break;
+
+            Write write = std::move(m_writes.front());
+            const std::string target = path(write.source);
+            const std::string directory = m_directory;
+
+            m_writes.pop_front();
+            m_writing = true;
+            lock.unlock();
+
+            FileHeader header;
+            const std::vector<u8> image = encodeRawImage(write.image);
+            // Written aside then renamed, so readers never map a partial file
+            const std::string temporary = target + ".tmp";
+            bool written;
+
+            header.time = write.source.time;
+            header.size = write.source.size;
+            header.path_size = (u32)write.source.path.size();
+            {
+                std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+                file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+                file.write(write.source.path.data(), (std::streamsize)write.source.path.size());
+                file.write(reinterpret_cast<const char *>(image.data()), (std::streamsize)image.size());
+                written = (bool)file;
+            }
+
+            std::error_code error;
+
+            if (written)
+                std::filesystem::rename(temporary, target, error);
+            if (written == false || error) {
+                std::filesystem::remove(temporary, error);
+            } else {
+                // The older versions of the file will never be read again
+                const std::string name = prefix(write.source);
+                const std::string own = std::filesystem::path(target).filename().string();
+
+                for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+                    const std::string other = entry.path().filename().string();
+                    std::error_code ignored;
+
+                    if (other.starts_with(name) && other.ends_with(".kimg") && other != own)
+                        std::filesystem::remove(entry.path(), ignored);
+                }
+            }
+
+            lock.lock();
+            m_writing = false;
+            if (m_writes.empty())
+                m_idle.notify_all();
+        }
+    }
+
+    ImageCache::~ImageCache()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    ImageCache& ImageCache::instance()
+    {
+        if (!m_Instance)
+            m_Instance = new ImageCache();
+        return *m_Instance;
+    }
+
+    void ImageCache::destroy()
+    {
+        if (m_Instance)
+            delete m_Instance;
+        m_Instance = nullptr;
+    }
+}
@@ -0,0 +1,354 @@
+#include "Kat/image_format.h"
+#include "Kat/image.h"
+#include "Kat/pak.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace kat {
+
+    namespace {
+
+        constexpr u8 OpIndex = 0x00;
+        constexpr u8 OpDiff = 0x40;
+        constexpr u8 OpLuma = 0x80;
+        constexpr u8 OpRun = 0xc0;
+        constexpr u8 OpRgb = 0xfe;
+        constexpr u8 OpRgba = 0xff;
+        constexpr u8 OpMask = 0xc0;
+
+        constexpr usize QoiHeaderSize = 14;
+        constexpr u8 QoiEnd[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+        /**
+         * @brief The most pixels a byte of qoi can hold (a run), bounds the size of the
+         *        image a header may claim for its data.
+         */
+        constexpr usize MaxPixelsPerByte = 62;
+
+        struct Pixel {
+            u8 r = 0, g = 0, b = 0, a = 255;
+
+            bool operator==(const Pixel&) const = default;
+
+            u8 hash() const
+            {
+                return (u8)((r * 3 + g * 5 + b * 7 + a * 11) % 64);
+            }
+        };
+
+        void appendBigEndian(std::vector<u8>& output, u32 value)
+        {
+            const u8 bytes[4] = { (u8)(value >> 24), (u8)(value >> 16), (u8)(value >> 8), (u8)value };
+
+            output.insert(output.end(), bytes, bytes + 4);
+        }
+
+        u32 readBigEndian(const u8 *data)
+        {
+            return (u32)data[0] << 24 | (u32)data[1] << 16 | (u32)data[2] << 8 | data[3];
+        }
+
+        /**
+         * @brief Encodes pixels as a qoi stream, starting from a fresh state.
+         */
+        void encodePixels(const u8 *pixels, usize count, std::vector<u8>& output)
+        {
+            Pixel index[64];
+            Pixel previous;
+            usize run = 0;
+
+            // The spec starts the index at transparent black, unlike the previous pixel
+            std::fill(index, index + 64, Pixel{ 0, 0, 0, 0 });
+
+            for (usize i = 0; i < count; ++i) {
+                const u8 *source = pixels + i * 4;
+                const Pixel pixel{ source[0], source[1], source[2], source[3] };
+
+                if (pixel == previous) {
+                    if (++run == MaxPixelsPerByte || i + 1 == count) {
+                        output.push_back(OpRun | (u8)(run - 1));
+                        run = 0;
+                    }
+                    continue;
+                }
+                if (run > 0) {
+                    output.push_back(OpRun | (u8)(run - 1));
+                    run = 0;
+                }
+
+                const u8 slot = pixel.hash();
+
+                if (index[slot] == pixel) {
+                    output.push_back(OpIndex | slot);
+                    previous = pixel;
+                    continue;
+                }
+                index[slot] = pixel;
+                if (pixel.a != previous.a) {
+                    output.insert(output.end(), { OpRgba, pixel.r, pixel.g, pixel.b, pixel.a });
+                } else {
+                    const i8 dr = (i8)(pixel.r - previous.r);
+                    const i8 dg = (i8)(pixel.g - previous.g);
+                    const i8 db = (i8)(pixel.b - previous.b);
+                    const i8 dr_dg = (i8)(dr - dg);
+                    const i8 db_dg = (i8)(db - dg);
+
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        output.push_back(OpDiff | (u8)((dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                    } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                        output.push_back(OpLuma | (u8)(dg + 32));
+                        output.push_back((u8)((dr_dg + 8) << 4 | (db_dg + 8)));
+                    } else {
+                        output.insert(output.end(), { OpRgb, pixel.r, pixel.g, pixel.b });
+                    }
+                }
+                previous = pixel;
+            }
+        }
+
+        /**
+         * @brief Decodes a qoi stream, starting from a fresh state.
+         *
+         * @return bool Whether the stream filled the pixels without running out of data.
+         */
+        bool decodePixels(const u8 *data, usize size, u8 *pixels, usize count)
+        {
+            Pixel index[64];
+            Pixel pixel;
+            const u8 *end = data + size;
+            u8 *output = pixels;
+            u8 *const last = pixels + count * 4;
+
+            std::fill(index, index + 64, Pixel{ 0, 0, 0, 0 });
+
+            while (output != last) {
+                if (data == end)
+                    return false;
+
+                const u8 op = *data++;
+
+                if (op == OpRgb || op == OpRgba) {
+                    const usize channels = op == OpRgb ? 3 : 4;
+
+                    if ((usize)(end - data) < channels)
+                        return false;
+                    pixel.r = data[0];
+                    pixel.g = data[1];
+                    pixel.b = data[2];
+                    if (op == OpRgba)
+                        pixel.a = data[3];
+                    data += channels;
+                } else if ((op & OpMask) == OpIndex) {
+                    pixel = index[op];
+                } else if ((op & OpMask) == OpDiff) {
+                    pixel.r += ((op >> 4) & 3) - 2;
+                    pixel.g += ((op >> 2) & 3) - 2;
+                    pixel.b += (op & 3) - 2;
+                } else if ((op & OpMask) == OpLuma) {
+                    if (data == end)
+                        return false;
+
+                    const int dg = (op & 0x3f) - 32;
+                    const u8 second = *data++;
+
+                    pixel.r += dg - 8 + (second >> 4);
+                    pixel.g += dg;
+                    pixel.b += dg - 8 + (second & 0x0f);
+                } else {
+                    const usize run = (usize)(op & 0x3f) + 1;
+
+                    if ((usize)(last - output) / 4 < run)
+                        return false;
+                    // Every pixel goes to the index like in the reference decoder, the
+                    // encoder may start a stream with a run of the initial pixel
+                    index[pixel.hash()] = pixel;
+                    for (usize i = 0; i < run; ++i, output += 4)
+                        std::memcpy(output, &pixel, 4);
+                    continue;
+                }
+                index[pixel.hash()] = pixel;
+                std::memcpy(output, &pixel, 4);
+                output += 4;
+            }
+            return true;
+        }
+
+        bool isValidSize(u32 width, u32 height, usize data_size, usize pixels_per_byte)
+        {
+            return width > 0 && height > 0 && (u64)width * height / pixels_per_byte <= data_size;
+        }
+
+        bool decodeRaw(std::span<const u8> data, std::vector<u8>& pixels, TextureSize& size)
+        {
+            RawImageHeader header;
+
+            std::memcpy(&header, data.data(), sizeof(header));
+            if (isValidSize(header.width, header.height, (data.size() - sizeof(header)) / 4, 1) == false)
+                return false;
+            size = TextureSize(header.width, header.height);
+            pixels.assign(data.begin() + sizeof(header), data.begin() + sizeof(header) + (usize)size.x * size.y * 4);
+            return true;
+        }
+
+        bool decodeQoi(std::span<const u8> data, std::vector<u8>& pixels, TextureSize& size)
+        {
+            const u32 width = readBigEndian(data.data() + 4);
+            const u32 height = readBigEndian(data.data() + 8);
+            const usize stream = data.size() - QoiHeaderSize;
+
+            if (isValidSize(width, height, stream, MaxPixelsPerByte) == false)
+                return false;
+            pixels.resize((usize)width * height * 4);
+            if (decodePixels(data.data() + QoiHeaderSize, stream, pixels.data(), (usize)width * height) == false)
+                return false;
+            size = TextureSize(width, height);
+            return true;
+        }
+
+        bool decodeQoiBands(std::span<const u8> data, std::vector<u8>& pixels, TextureSize& size)
+        {
+            QoiBandsHeader header;
+
+            std::memcpy(&header, data.data(), sizeof(header));
+            if (header.band_rows == 0)
+                return false;
+
+            const usize bands = ((usize)header.height + header.band_rows - 1) / header.band_rows;
+            const usize offsets_size = bands * sizeof(u32);
+
+            if (data.size() - sizeof(header) < offsets_size
+                || isValidSize(header.width, header.height, data.size() - sizeof(header) - offsets_size,
+                               MaxPixelsPerByte) == false)
+                return false;
+
+            const u8 *offsets = data.data() + sizeof(header);
+            const u8 *streams = offsets + offsets_size;
+            const usize streams_size = data.size() - sizeof(header) - offsets_size;
+            std::vector<u32> ends(bands);
+
+            std::memcpy(ends.data(), offsets, offsets_size);
+            for (usize i = 0; i < bands; ++i) {
+                if (ends[i] > streams_size || (i > 0 && ends[i] < ends[i - 1]))
+                    return false;
+            }
+
+            const usize row = (usize)header.width * 4;
+            const usize band_pixels = (usize)header.width * header.band_rows;
+            std::atomic<bool> valid = true;
+
+            pixels.resize(row * header.height);
+            parallelFor(bands, Image::ParallelThreshold / band_pixels, [&](usize begin, usize end) {
+                for (usize i = begin; i < end && valid; ++i) {
+                    const usize start = i > 0 ? ends[i - 1] : 0;
+                    const usize rows = std::min<usize>(header.band_rows, header.height - i * header.band_rows);
+
+                    if (decodePixels(streams + start, ends[i] - start, pixels.data() + i * header.band_rows * row,
+                                     rows * header.width) == false)
+                        valid = false;
+                }
+            });
+            if (valid == false)
+                return false;
+            size = TextureSize(header.width, header.height);
+            return true;
+        }
+    }
+
+    ImageFormat imageFormat(std::span<const u8> data)
+    {
+        if (data.size() >= sizeof(RawImageHeader) && std::memcmp(data.data(), "KRAW", 4) == 0)
+            return ImageFormat::Raw;
+        if (data.size() >= QoiHeaderSize && std::memcmp(data.data(), "qoif", 4) == 0)
+            return ImageFormat::Qoi;
+        if (data.size() >= sizeof(QoiBandsHeader) && std::memcmp(data.data(), "KQOI", 4) == 0)
+            return ImageFormat::QoiBands;
+        return ImageFormat::Encoded;
+    }
+
+    std::vector<u8> encodeImage(const sf::Image& image, ImageFormat format)
+    {
+        const auto size = image.getSize();
+
+        switch (format) {
+        case ImageFormat::Raw:
+            return encodeRawImage(image);
+        case ImageFormat::Qoi:
+            return encodeQoi(image.getPixelsPtr(), TextureSize(size.x, size.y));
+        case ImageFormat::QoiBands:
+            return encodeQoiBands(image.getPixelsPtr(), TextureSize(size.x, size.y));
+        default:
+            return {};
+        }
+    }
+
+    std::vector<u8> encodeQoi(const u8 *pixels, const TextureSize& size)
+    {
+        std::vector<u8> output;
+        const usize count = pixels ? (usize)size.x * size.y : 0;
+
+        output.reserve(QoiHeaderSize + count + sizeof(QoiEnd));
+        output.insert(output.end(), { 'q', 'o', 'i', 'f' });
+        appendBigEndian(output, size.x);
+        appendBigEndian(output, size.y);
+        output.push_back(4); // rgba
+        output.push_back(0); // srgb with linear alpha
+        encodePixels(pixels, count, output);
+        output.insert(output.end(), QoiEnd, QoiEnd + sizeof(QoiEnd));
+        return output;
+    }
+
+    std::vector<u8> encodeQoiBands(const u8 *pixels, const TextureSize& size, u32 band_rows)
+    {
+        QoiBandsHeader header;
+        const usize row = (usize)size.x * 4;
+
+        header.width = size.x;
+        header.height = pixels ? size.y : 0;
+        header.band_rows = std::max(band_rows, 1u);
+
+        const usize bands = ((usize)header.height + header.band_rows - 1) / header.band_rows;
+        std::vector<u8> output(sizeof(header) + bands * sizeof(u32));
+        std::vector<u32> ends(bands);
+
+        std::memcpy(output.data(), &header, sizeof(header));
+        for (usize i = 0; i < bands; ++i) {
+            const usize rows = std::min<usize>(header.band_rows, header.height - i * header.band_rows);
+
+            encodePixels(pixels + i * header.band_rows * row, rows * size.x, output);
+            ends[i] = (u32)(output.size() - sizeof(header) - bands * sizeof(u32));
+        }
+        if (bands > 0)
+            std::memcpy(output.data() + sizeof(header), ends.data(), bands * sizeof(u32));
+        return output;
+    }
+
+    bool decodeImage(std::span<const u8> data, std::vector<u8>& pixels, TextureSize& size)
+    {
+        switch (imageFormat(data)) {
+        case ImageFormat::Raw:
+            return decodeRaw(data, pixels, size);
+        case ImageFormat::Qoi:
+            return decodeQoi(data, pixels, size);
+        case ImageFormat::QoiBands:
+            return decodeQoiBands(data, pixels, size);
+        default:
+            return false;
+        }
+    }
+
+    bool decodeImage(std::span<const u8> data, sf::Image& image)
+    {
+        std::vector<u8> pixels;
+        TextureSize size;
+
+        if (imageFormat(data) == ImageFormat::Encoded)
+            return image.loadFromMemory(data.data(), data.size());
+        if (decodeImage(data, pixels, size) == false)
+            return false;
+        image.create({ size.x, size.y }, pixels.data());
+        return true;
+    }
+}
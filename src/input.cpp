@@ -113,6 +113,12 @@ namespace kat {
         m_Instance->updateEvent(window);
     }
 
+    void InputManager::updateLatched(Window& window)
+    {
+        window.latch();
+        update(window);
+    }
+
     void InputManager::nextFrame()
     {
         m_Instance->_nextFrame();
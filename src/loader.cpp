@@ -0,0 +1,490 @@
+#include "Kat/loader.h"
+#include "Kat/components/texture_cache.h"
+#include "Kat/components/texture_release.h"
+#include "Kat/image_format.h"
+#include "Kat/preload.h"
+#include "Kat/vfs.h"
+
+#include <SFML/Graphics/Image.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+namespace kat {
+
+    struct BundleState {
+        std::vector<std::shared_ptr<BundleState>> dependencies;
+        std::vector<std::weak_ptr<LoadTask>> tasks; ///< Only touched by the main thread.
+        std::atomic<usize> total = 0;
+        std::atomic<usize> finished = 0;
+        std::atomic<usize> failed = 0;
+        LoadProgress on_progress;
+
+        bool isOver() const
+        {
+            return finished == total;
+        }
+
+        bool hasFailed() const
+        {
+            if (failed > 0)
+                return true;
+            return std::any_of(dependencies.begin(), dependencies.end(),
+                               [](const auto& dependency) { return dependency->hasFailed(); });
+        }
+
+        bool isReady() const
+        {
+            if (isOver() == false || failed > 0)
+                return false;
+            return std::all_of(dependencies.begin(), dependencies.end(),
+                               [](const auto& dependency) { return dependency->isReady(); });
+        }
+    };
+
+    static sf::Image decodeImage(const std::string& filename, VirtualFileSystem* files)
+    {
+        sf::Image image;
+
+        if (files) {
+            const VfsBuffer buffer = files->readNow(filename);
+
+            if (buffer.empty() == false && decodeImage(buffer.bytes(), image))
+                return image;
+        } else if (filename.ends_with(".qoi")) {
+            std::ifstream file(filename, std::ios::binary);
+            const std::vector<u8> content(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+
+            if (decodeImage(content, image))
+                return image;
+        } else if (image.loadFromFile(filename)) {
+            return image;
+        }
+        throw std::runtime_error("Failed to load image: " + filename);
+    }
+
+    /**
+     * @brief Gets the decoder of an image. Reads through a file system are submitted right
+     *        away, so the loads queued together share the batches of its io_uring instead of
+     *        each worker blocking on its own file. Reloads after an eviction read the file again.
+     */
+    static std::function<sf::Image()> imageDecoder(const std::string& filename, VirtualFileSystem* files)
+    {
+        if (files == nullptr)
+            return [filename]() { return decodeImage(filename, nullptr); };
+
+        auto prefetch = std::make_shared<std::optional<VfsRead>>(files->read(filename));
+
+        return [filename, files, prefetch]() {
+            if (prefetch->has_value() == false)
+                return decodeImage(filename, files);
+
+            const VfsRead read = std::move(**prefetch);
+            sf::Image image;
+
+            prefetch->reset();
+            if (read.wait() && decodeImage(read.buffer().bytes(), image))
+                return image;
+            throw std::runtime_error("Failed to load image: " + filename);
+        };
+    }
+
+    static Texture createTexture(const std::string& filename, const sf::Image& image)
+    {
+        auto texture = makeSharedTexture();
+
+        if (texture->loadFromImage(image) == false)
+            throw std::runtime_error("Failed to create texture.");
+        TextureCache::instance().insert(filename, {}, Frame(), texture);
+        return Texture(texture);
+    }
+
+    static bool isOver(LoadState state)
+    {
+        return state == LoadState::Ready || state == LoadState::Failed || state == LoadState::Cancelled;
+    }
+
+    LoadHandle::LoadHandle(const std::shared_ptr<LoadTask>& task)
+        : m_task(task)
+    {
+    }
+
+    LoadState LoadHandle::state() const
+    {
+        return m_task->state;
+    }
+
+    bool LoadHandle::isReady() const
+    {
+        return m_task && m_task->state == LoadState::Ready;
+    }
+
+    bool LoadHandle::isDone() const
+    {
+        return m_task == nullptr || isOver(m_task->state);
+    }
+
+    void LoadHandle::cancel()
+    {
+        if (m_task == nullptr)
+            return;
+
+        LoadState state = m_task->state;
+
+        // The loader notices the cancellation the next time it touches the load
+        while (isOver(state) == false
+               && m_task->state.compare_exchange_weak(state, LoadState::Cancelled) == false) {
+        }
+    }
+
+    const ResourceName& LoadHandle::name() const
+    {
+        return m_task->name;
+    }
+
+    const std::string& LoadHandle::error() const
+    {
+        return m_task->error;
+    }
+
+    LoadBundle::LoadBundle(const std::shared_ptr<BundleState>& state)
+        : m_state(state)
+    {
+    }
+
+    usize LoadBundle::finished() const
+    {
+        return m_state->finished;
+    }
+
+    usize LoadBundle::size() const
+    {
+        return m_state->total;
+    }
+
+    float LoadBundle::progress() const
+    {
+        const usize total = m_state->total;
+
+        return total ? (float)m_state->finished / total : 1.0f;
+    }
+
+    bool LoadBundle::isReady() const
+    {
+        return m_state->isReady();
+    }
+
+    bool LoadBundle::hasFailed() const
+    {
+        return m_state->hasFailed();
+    }
+
+    void LoadBundle::cancel()
+    {
+        // The tasks are only appended by the main thread, like this call
+        for (const auto& weak : m_state->tasks) {
+            if (auto task = weak.lock())
+                LoadHandle(task).cancel();
+        }
+    }
+
+    LoadBundle& LoadBundle::onProgress(const LoadProgress& callback)
+    {
+        m_state->on_progress = callback;
+        return *this;
+    }
+
+    const std::shared_ptr<BundleState>& LoadBundle::state() const
+    {
+        return m_state;
+    }
+
+    ResourceLoader::ResourceLoader(ResourceManager& resources, usize threads)
+        : m_resources(resources)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        threads = std::max<usize>(threads, 1);
+        for (usize i = 0; i < threads; ++i)
+            m_workers.emplace_back(&ResourceLoader::work, this);
+    }
+
+    ResourceLoader::~ResourceLoader()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+
+            m_stop = true;
+            for (auto& task : m_queue)
+                LoadHandle(task).cancel();
+        }
+        m_wake.notify_all();
+        for (auto& worker : m_workers)
+            worker.join();
+    }
+
+    LoadBundle ResourceLoader::bundle(const std::vector<LoadBundle>& dependencies)
+    {
+        auto state = std::make_shared<BundleState>();
+
+        for (const auto& dependency : dependencies)
+            state->dependencies.push_back(dependency.state());
+        return LoadBundle(state);
+    }
+
+    LoadHandle ResourceLoader::submit(const std::shared_ptr<LoadTask>& task, const LoadBundle* bundle)
+    {
+        if (bundle) {
+            task->bundle = bundle->state();
+            task->bundle->tasks.push_back(task);
+            ++task->bundle->total;
+        }
+        {
+            std::lock_guard lock(m_mutex);
+
+            m_queue.push_back(task);
+            ++m_total;
+        }
+        m_wake.notify_one();
+        return LoadHandle(task);
+    }
+
+    LoadHandle ResourceLoader::loadTexture(const ResourceName& name, const std::string& filename,
+                                           LoadPriority priority, const LoadBundle* bundle)
+    {
+        if (m_recorder)
+            m_recorder->setSource("texture", name, filename);
+
+        // Files already loaded share their texture, like Texture::load. The cache is looked
+        // up again on the main thread, so the reloader holds no texture and can be evicted
+        if (TextureCache::instance().find(filename)) {
+            return load<std::string, Texture>(name,
+                [filename]() { return filename; },
+                [files = m_files](std::string&& filename) {
+                    if (auto cached = TextureCache::instance().find(filename))
+                        return Texture(cached);
+                    return createTexture(filename, decodeImage(filename, files));
+                },
+                priority, bundle);
+        }
+        const auto decode = imageDecoder(filename, m_files);
+
+        if (m_uploader) {
+            return load<Texture>(name,
+                std::function<Texture()>([filename, uploader = m_uploader, decode]() {
+                    const UploadHandle upload = uploader->create(decode());
+
+                    if (upload.wait() == false)
+                        throw std::runtime_error("Failed to create texture.");
+                    TextureCache::instance().insert(filename, {}, Frame(), upload.texture().shared_handle());
+                    return upload.texture();
+                }),
+                priority, bundle);
+        }
+        return load<sf::Image, Texture>(name,
+            decode,
+            [filename](sf::Image&& image) { return createTexture(filename, image); },
+            priority, bundle);
+    }
+
+    std::shared_ptr<LoadTask> ResourceLoader::next()
+    {
+        auto best = m_queue.end();
+
+        for (auto it = m_queue.begin(); it != m_queue.end();) {
+            LoadTask& task = **it;
+            const auto& bundle = task.bundle;
+
+            // Cancelled loads and loads of failed dependencies are over right away
+            if (task.state == LoadState::Cancelled
+                || (bundle && std::any_of(bundle->dependencies.begin(), bundle->dependencies.end(),
+                                          [](const auto& dependency) { return dependency->hasFailed(); }))) {
+                if (task.state != LoadState::Cancelled) {
+                    task.error = "A bundle it depends on failed.";
+                    task.state = LoadState::Failed;
+                }
+                m_decoded.push_back(*it);
+                m_queue.erase(it);
+                it = m_queue.begin();
+                best = m_queue.end();
+                continue;
+            }
+
+            const bool can_start = bundle == nullptr
+                || std::all_of(bundle->dependencies.begin(), bundle->dependencies.end(),
+                               [](const auto& dependency) { return dependency->isReady(); });
+
+            if (can_start && (best == m_queue.end() || task.priority > (*best)->priority))
+                best = it;
+            ++it;
+        }
+        if (best == m_queue.end())
+            return nullptr;
+
+        auto task = *best;
+
+        m_queue.erase(best);
+        return task;
+    }
+
+    void ResourceLoader::work()
+    {
+        std::unique_lock lock(m_mutex);
+
+        while (m_stop == false) {
+            const usize decoded = m_decoded.size();
+            auto task = next();
+
+            if (m_decoded.size() != decoded)
+                m_decoded_cv.notify_all();
+            if (task == nullptr) {
+                m_wake.wait(lock);
+                continue;
+            }
+
+            LoadState state = LoadState::Queued;
+
+            if (task->state.compare_exchange_strong(state, LoadState::Loading) == false) {
+                m_decoded.push_back(task);
+                continue;
+            }
+            lock.unlock();
+            try {
+                task->result = task->decode();
+                state = LoadState::Loading;
+                task->state.compare_exchange_strong(state, LoadState::Decoded);
+            } catch (const std::exception& error) {
+                task->error = error.what();
+                state = LoadState::Loading;
+                task->state.compare_exchange_strong(state, LoadState::Failed);
+            }
+            lock.lock();
+            m_decoded.push_back(task);
+            m_decoded_cv.notify_all();
+        }
+    }
+
+    void ResourceLoader::complete(LoadTask& task)
+    {
+        const auto& bundle = task.bundle;
+
+        if (bundle) {
+            if (task.state != LoadState::Ready)
+                ++bundle->failed;
+            ++bundle->finished;
+            if (bundle->on_progress)
+                bundle->on_progress(bundle->finished, bundle->total);
+        }
+
+        usize finished;
+        usize total;
+        {
+            std::lock_guard lock(m_mutex);
+
+            finished = ++m_finished;
+            total = m_total;
+            if (m_finished == m_total) {
+                m_finished = 0;
+                m_total = 0;
+            }
+        }
+        if (m_on_progress)
+            m_on_progress(finished, total);
+    }
+
+    usize ResourceLoader::pump(std::optional<LoadBudget> budget)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        usize count = 0;
+
+        // Cancelled loads waiting in the queue are collected by the workers
+        m_wake.notify_all();
+        while (count == 0 || !budget || std::chrono::steady_clock::now() - start < *budget) {
+            std::shared_ptr<LoadTask> task;
+            {
+                std::lock_guard lock(m_mutex);
+
+                if (m_decoded.empty())
+                    break;
+
+                const auto best = std::max_element(m_decoded.begin(), m_decoded.end(),
+                    [](const auto& a, const auto& b) { return a->priority < b->priority; });
+
+                task = *best;
+                m_decoded.erase(best);
+            }
+
+            LoadState state = LoadState::Decoded;
+
+            if (task->state == LoadState::Decoded) {
+                try {
+                    if (task->finish)
+                        task->finish(task->result);
+                    task->store(m_resources, task->result);
+                    task->state.compare_exchange_strong(state, LoadState::Ready);
+                } catch (const std::exception& error) {
+                    task->error = error.what();
+                    task->state.compare_exchange_strong(state, LoadState::Failed);
+                }
+            }
+            if (task->state != LoadState::Ready)
+                task->result.reset();
+            complete(*task);
+            ++count;
+        }
+        // Loads waiting for the bundles that just got ready can start
+        if (count)
+            m_wake.notify_all();
+        return count;
+    }
+
+    void ResourceLoader::wait(const LoadHandle& handle)
+    {
+        while (handle.isDone() == false) {
+            if (pump(std::nullopt) == 0) {
+                std::unique_lock lock(m_mutex);
+
+                m_decoded_cv.wait(lock, [this] { return m_decoded.empty() == false; });
+            }
+        }
+    }
+
+    void ResourceLoader::wait(const LoadBundle& bundle)
+    {
+        for (const auto& weak : bundle.state()->tasks) {
+            if (auto task = weak.lock())
+                wait(LoadHandle(task));
+        }
+    }
+
+    ResourceLoader& ResourceLoader::onProgress(const LoadProgress& callback)
+    {
+        m_on_progress = callback;
+        return *this;
+    }
+
+    ResourceLoader& ResourceLoader::setUploader(TextureUploader* uploader)
+    {
+        m_uploader = uploader;
+        return *this;
+    }
+
+    ResourceLoader& ResourceLoader::setRecorder(PreloadRecorder* recorder)
+    {
+        m_recorder = recorder;
+        return *this;
+    }
+
+    ResourceLoader& ResourceLoader::setFileSystem(VirtualFileSystem* files)
+    {
+        m_files = files;
+        return *this;
+    }
+
+    usize ResourceLoader::pending() const
+    {
+        std::lock_guard lock(m_mutex);
+
+        return m_total - m_finished;
+    }
+}
@@ -0,0 +1,117 @@
+#include "Kat/mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kat {
+
+    bool MappedFile::open(const std::string& filename)
+    {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size;
+
+        if (GetFileSizeEx(file, &size) == FALSE) {
+            CloseHandle(file);
+            return false;
+        }
+        m_size = (usize)size.QuadPart;
+        if (m_size) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+            if (mapping)
+                m_data = static_cast<const u8 *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            // The view keeps the mapping alive
+            if (mapping)
+                CloseHandle(mapping);
+        }
+        CloseHandle(file);
+#else
+        const int file = ::open(filename.c_str(), O_RDONLY);
+
+        if (file < 0)
+            return false;
+
+        struct stat status;
+
+        if (fstat(file, &status) != 0) {
+            ::close(file);
+            return false;
+        }
+        m_size = (usize)status.st_size;
+        if (m_size) {
+            void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+            m_data = data == MAP_FAILED ? nullptr : static_cast<const u8 *>(data);
+        }
+        ::close(file);
+#endif
+        if (m_size && m_data == nullptr) {
+            m_size = 0;
+            return false;
+        }
+        m_open = true;
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (m_data) {
+#ifdef _WIN32
+            UnmapViewOfFile(m_data);
+#else
+            munmap(const_cast<u8 *>(m_data), m_size);
+#endif
+        }
+        m_data = nullptr;
+        m_size = 0;
+        m_open = false;
+    }
+
+    bool MappedFile::isOpen() const
+    {
+        return m_open;
+    }
+
+    std::span<const u8> MappedFile::bytes() const
+    {
+        return { m_data, m_size };
+    }
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr))
+        , m_size(std::exchange(other.m_size, 0))
+        , m_open(std::exchange(other.m_open, false))
+    {
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other) {
+            close();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+            m_open = std::exchange(other.m_open, false);
+        }
+        return *this;
+    }
+}
@@ -0,0 +1,570 @@
+#include "Kat/pak.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace kat {
+
+    namespace {
+
+        constexpr usize MinMatch = 4;
+        constexpr usize MaxOffset = 0xffff;
+        constexpr usize HashBits = 14;
+        constexpr usize Alignment = 16;
+
+        u32 read32(const u8 *data)
+        {
+            u32 value;
+
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+
+        void writeLength(std::vector<u8>& output, usize length)
+        {
+            for (; length >= 255; length -= 255)
+                output.push_back(255);
+            output.push_back((u8)length);
+        }
+
+        bool readLength(std::span<const u8> input, usize& position, usize& length)
+        {
+            u8 byte;
+
+            do {
+                if (position >= input.size())
+                    return false;
+                byte = input[position++];
+                length += byte;
+            } while (byte == 255);
+            return true;
+        }
+
+        void emitSequence(std::vector<u8>& output, const u8 *literals, usize literal_count,
+                          usize offset, usize match)
+        {
+            const usize match_code = match ? match - MinMatch : 0;
+            const u8 token = (u8)(std::min<usize>(literal_count, 15) << 4 | std::min<usize>(match_code, 15));
+
+            output.push_back(token);
+            if (literal_count >= 15)
+                writeLength(output, literal_count - 15);
+            output.insert(output.end(), literals, literals + literal_count);
+            if (match == 0)
+                return;
+            output.push_back((u8)offset);
+            output.push_back((u8)(offset >> 8));
+            if (match_code >= 15)
+                writeLength(output, match_code - 15);
+        }
+
+        template<typename T>
+        void append(std::vector<u8>& output, const T& value)
+        {
+            const auto *bytes = reinterpret_cast<const u8 *>(&value);
+
+            output.insert(output.end(), bytes, bytes + sizeof(T));
+        }
+
+        template<typename T>
+        T take(std::span<const u8> data, usize& position)
+        {
+            T value;
+
+            if (position + sizeof(T) > data.size())
+                throw std::runtime_error("Truncated pak entry.");
+            std::memcpy(&value, data.data() + position, sizeof(T));
+            position += sizeof(T);
+            return value;
+        }
+
+        std::string takeString(std::span<const u8> data, usize& position)
+        {
+            const u32 size = take<u32>(data, position);
+
+            if (size > data.size() - position)
+                throw std::runtime_error("Truncated pak entry.");
+
+            std::string value(reinterpret_cast<const char *>(data.data() + position), size);
+
+            position += size;
+            return value;
+        }
+    }
+
+    std::vector<u8> lzCompress(std::span<const u8> input)
+    {
+        std::vector<u8> output;
+        std::vector<u32> table(1 << HashBits, 0); ///< Position + 1 of the last sequence of each hash.
+        const u8 *data = input.data();
+        const usize size = input.size();
+        usize anchor = 0;
+        usize i = 0;
+
+        output.reserve(size / 2 + 16);
+        while (i + MinMatch <= size) {
+            const u32 sequence = read32(data + i);
+            const u32 hash = (sequence * 2654435761u) >> (32 - HashBits);
+            const usize candidate = table[hash];
+
+            table[hash] = (u32)(i + 1);
+            if (candidate == 0 || i - (candidate - 1) > MaxOffset || read32(data + candidate - 1) != sequence) {
+                ++i;
+                continue;
+            }
+
+            const usize match_start = candidate - 1;
+            usize match = MinMatch;
+
+            while (i + match < size && data[match_start + match] == data[i + match])
+                ++match;
+            emitSequence(output, data + anchor, i - anchor, i - match_start, match);
+            i += match;
+            anchor = i;
+        }
+        if (anchor < size)
+            emitSequence(output, data + anchor, size - anchor, 0, 0);
+        return output;
+    }
+
+    bool lzDecompress(std::span<const u8> input, std::span<u8> output)
+    {
+        usize in = 0;
+        usize out = 0;
+
+        while (in < input.size()) {
+            const u8 token = input[in++];
+            usize literals = token >> 4;
+
+            if (literals == 15 && readLength(input, in, literals) == false)
+                return false;
+            if (in + literals > input.size() || out + literals > output.size())
+                return false;
+            std::memcpy(output.data() + out, input.data() + in, literals);
+            in += literals;
+            out += literals;
+
+            // The last sequence has no match
+            if (in == input.size())
+                break;
+            if (in + 2 > input.size())
+                return false;
+
+            const usize offset = input[in] | (usize)input[in + 1] << 8;
+            usize match = token & 15;
+
+            in += 2;
+            if (match == 15 && readLength(input, in, match) == false)
+                return false;
+            match += MinMatch;
+            if (offset == 0 || offset > out || out + match > output.size())
+                return false;
+            // Matches may overlap the bytes they produce
+            for (usize j = 0; j < match; ++j, ++out)
+                output[out] = output[out - offset];
+        }
+        return out == output.size();
+    }
+
+    std::vector<u8> encodeRawImage(const sf::Image& image)
+    {
+        RawImageHeader header;
+        const auto size = image.getSize();
+        const u8 *pixels = image.getPixelsPtr();
+        std::vector<u8> output;
+
+        header.width = size.x;
+        header.height = size.y;
+        output.reserve(sizeof(header) + (usize)size.x * size.y * 4);
+        append(output, header);
+        if (pixels)
+            output.insert(output.end(), pixels, pixels + (usize)size.x * size.y * 4);
+        return output;
+    }
+
+    std::vector<u8> encodeAnimations(const AnimationRegistry& animations)
+    {
+        std::vector<u8> output;
+
+        append(output, (u32)animations.size());
+        for (const auto& [name, animation] : animations) {
+            append(output, (u32)name.size());
+            output.insert(output.end(), name.begin(), name.end());
+            append(output, (f32)animation.speed);
+            append(output, (u8)animation.loop);
+            append(output, (u32)animation.frames.size());
+            for (const auto& frame : animation.frames) {
+                append(output, (i32)frame.left);
+                append(output, (i32)frame.top);
+                append(output, (i32)frame.width);
+                append(output, (i32)frame.height);
+            }
+        }
+        return output;
+    }
+
+    AnimationRegistry decodeAnimations(std::span<const u8> data)
+    {
+        AnimationRegistry animations;
+        usize position = 0;
+        const u32 count = take<u32>(data, position);
+
+        for (u32 i = 0; i < count; ++i) {
+            const u32 name_size = take<u32>(data, position);
+
+            if (position + name_size > data.size())
+                throw std::runtime_error("Invalid animations.");
+
+            const AnimationName name(reinterpret_cast<const char *>(data.data() + position), name_size);
+            Animation animation;
+
+            position += name_size;
+            animation.speed = take<f32>(data, position);
+            animation.loop = take<u8>(data, position) != 0;
+
+            const u32 frames = take<u32>(data, position);
+
+            for (u32 j = 0; j < frames; ++j) {
+                const i32 left = take<i32>(data, position);
+                const i32 top = take<i32>(data, position);
+                const i32 width = take<i32>(data, position);
+                const i32 height = take<i32>(data, position);
+
+                animation.addFrame(Frame(left, top, width, height));
+            }
+            animations[name] = std::move(animation);
+        }
+        return animations;
+    }
+
+    std::vector<u8> encodeAtlas(const AtlasTable& atlas)
+    {
+        std::vector<u8> output;
+
+        append(output, (u32)atlas.pages.size());
+        for (const auto& page : atlas.pages) {
+            append(output, (u32)page.size());
+            output.insert(output.end(), page.begin(), page.end());
+        }
+        append(output, (u32)atlas.regions.size());
+        for (const auto& [name, region] : atlas.regions) {
+            append(output, (u32)name.size());
+            output.insert(output.end(), name.begin(), name.end());
+            append(output, (u32)region.page);
+            append(output, (i32)region.region.left);
+            append(output, (i32)region.region.top);
+            append(output, (i32)region.region.width);
+            append(output, (i32)region.region.height);
+        }
+        return output;
+    }
+
+    AtlasTable decodeAtlas(std::span<const u8> data)
+    {
+        AtlasTable atlas;
+        usize position = 0;
+        const u32 pages = take<u32>(data, position);
+
+        for (u32 i = 0; i < pages; ++i)
+            atlas.pages.push_back(takeString(data, position));
+
+        const u32 count = take<u32>(data, position);
+
+        for (u32 i = 0; i < count; ++i) {
+            std::string name = takeString(data, position);
+            AtlasRegion region;
+
+            region.page = take<u32>(data, position);
+            if (region.page >= atlas.pages.size())
+                throw std::runtime_error("Invalid atlas.");
+
+            const i32 left = take<i32>(data, position);
+            const i32 top = take<i32>(data, position);
+            const i32 width = take<i32>(data, position);
+            const i32 height = take<i32>(data, position);
+
+            region.region = Frame(left, top, width, height);
+            atlas.regions[std::move(name)] = region;
+        }
+        return atlas;
+    }
+
+    PakWriter& PakWriter::add(const std::string& name, PakEntryType type, std::vector<u8> data)
+    {
+        auto it = std::find_if(m_entries.begin(), m_entries.end(),
+                               [&name](const Entry& entry) { return entry.name == name; });
+
+        if (it != m_entries.end())
+            *it = Entry{ name, type, std::move(data) };
+        else
+            m_entries.push_back(Entry{ name, type, std::move(data) });
+        return *this;
+    }
+
+    usize PakWriter::size() const
+    {
+        return m_entries.size();
+    }
+
+    bool PakWriter::save(const std::string& filename, bool compress) const
+    {
+        std::vector<const Entry *> sorted;
+
+        for (const auto& entry : m_entries)
+            sorted.push_back(&entry);
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const Entry *a, const Entry *b) { return a->name < b->name; });
+
+        PakHeader header;
+        std::vector<PakIndexEntry> index;
+        std::string names;
+        std::vector<u8> body(sizeof(PakHeader), 0);
+
+        header.entries = (u32)sorted.size();
+        header.block_size = BlockSize;
+        for (const Entry *entry : sorted) {
+            PakIndexEntry indexed;
+
+            body.resize((body.size() + Alignment - 1) / Alignment * Alignment, 0);
+            indexed.offset = body.size();
+            indexed.size = entry->data.size();
+            indexed.name_offset = (u32)names.size();
+            indexed.name_size = (u32)entry->name.size();
+            indexed.type = entry->type;
+            names += entry->name;
+
+            if (compress && entry->data.size() > 0) {
+                const usize blocks = (entry->data.size() + BlockSize - 1) / BlockSize;
+                std::vector<u32> sizes;
+                std::vector<u8> stored;
+
+                for (usize i = 0; i < blocks; ++i) {
+                    const usize start = i * BlockSize;
+                    const std::span<const u8> block(entry->data.data() + start,
+                                                    std::min<usize>(BlockSize, entry->data.size() - start));
+                    const std::vector<u8> packed = lzCompress(block);
+
+                    // Blocks that do not shrink are stored as is
+                    if (packed.size() < block.size()) {
+                        sizes.push_back((u32)packed.size());
+                        stored.insert(stored.end(), packed.begin(), packed.end());
+                    } else {
+                        sizes.push_back((u32)block.size());
+                        stored.insert(stored.end(), block.begin(), block.end());
+                    }
+                }
+                if (stored.size() + sizes.size() * sizeof(u32) < entry->data.size()) {
+                    indexed.blocks = (u32)blocks;
+                    for (u32 block_size : sizes)
+                        append(body, block_size);
+                    body.insert(body.end(), stored.begin(), stored.end());
+                }
+            }
+            if (indexed.blocks == 0)
+                body.insert(body.end(), entry->data.begin(), entry->data.end());
+            indexed.stored = body.size() - indexed.offset;
+            index.push_back(indexed);
+        }
+
+        body.resize((body.size() + Alignment - 1) / Alignment * Alignment, 0);
+        header.index_offset = body.size();
+        for (const auto& indexed : index)
+            append(body, indexed);
+        header.names_offset = body.size();
+        body.insert(body.end(), names.begin(), names.end());
+        std::memcpy(body.data(), &header, sizeof(header));
+
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+
+        if (!file)
+            return false;
+        file.write(reinterpret_cast<const char *>(body.data()), (std::streamsize)body.size());
+        return (bool)file;
+    }
+
+    bool Pak::open(const std::string& filename)
+    {
+        close();
+        if (m_file.open(filename) == false)
+            return false;
+
+        const auto bytes = m_file.bytes();
+        const auto *header = reinterpret_cast<const PakHeader *>(bytes.data());
+
+        if (bytes.size() < sizeof(PakHeader) || std::memcmp(header->magic, "KPAK", 4) != 0
+            || header->version != 1 || header->index_offset % alignof(PakIndexEntry) != 0
+            || header->index_offset > bytes.size()
+            || (bytes.size() - header->index_offset) / sizeof(PakIndexEntry) < header->entries
+            || header->names_offset > bytes.size()) {
+            close();
+            return false;
+        }
+
+        const std::span<const PakIndexEntry> entries(
+            reinterpret_cast<const PakIndexEntry *>(bytes.data() + header->index_offset), header->entries);
+        const std::string_view names(reinterpret_cast<const char *>(bytes.data() + header->names_offset),
+                                     bytes.size() - header->names_offset);
+
+        for (const auto& entry : entries) {
+            if (entry.offset > bytes.size() || entry.stored > bytes.size() - entry.offset
+                || (u64)entry.name_offset + entry.name_size > names.size()
+                || (entry.blocks == 0 && entry.stored != entry.size)
+                || (entry.blocks && (header->block_size == 0
+                                     || entry.blocks != (entry.size + header->block_size - 1) / header->block_size))) {
+                close();
+                return false;
+            }
+        }
+        m_header = header;
+        m_entries = entries;
+        m_names = names;
+
+        // The page indices of each table are offset by the pages of the tables before it
+        try {
+            for (const auto& entry : m_entries) {
+                if (entry.type != PakEntryType::Atlas)
+                    continue;
+
+                std::vector<u8> scratch;
+                AtlasTable atlas = decodeAtlas(data(name(entry), scratch));
+                const u32 first = (u32)m_atlas.pages.size();
+
+                m_atlas.pages.insert(m_atlas.pages.end(), atlas.pages.begin(), atlas.pages.end());
+                for (auto& [image, region] : atlas.regions)
+                    m_atlas.regions[image] = AtlasRegion{ region.page + first, region.region };
+            }
+        } catch (const std::runtime_error&) {
+            close();
+            return false;
+        }
+        m_pages.assign(m_atlas.pages.size(), Texture(nullptr));
+        return true;
+    }
+
+    void Pak::close()
+    {
+        m_file.close();
+        m_header = nullptr;
+        m_entries = {};
+        m_names = {};
+        m_atlas = AtlasTable();
+        m_pages.clear();
+    }
+
+    usize Pak::size() const
+    {
+        return m_entries.size();
+    }
+
+    const PakIndexEntry* Pak::find(std::string_view name) const
+    {
+        const auto it = std::lower_bound(m_entries.begin(), m_entries.end(), name,
+            [this](const PakIndexEntry& entry, std::string_view key) { return this->name(entry) < key; });
+
+        if (it == m_entries.end() || this->name(*it) != name)
+            return nullptr;
+        return &*it;
+    }
+
+    bool Pak::contains(std::string_view name) const
+    {
+        return find(name) != nullptr;
+    }
+
+    std::string_view Pak::name(const PakIndexEntry& entry) const
+    {
+        return m_names.substr(entry.name_offset, entry.name_size);
+    }
+
+    std::span<const PakIndexEntry> Pak::entries() const
+    {
+        return m_entries;
+    }
+
+    std::span<const u8> Pak::data(std::string_view name, std::vector<u8>& scratch) const
+    {
+        const PakIndexEntry *entry = find(name);
+
+        if (entry == nullptr)
+            throw std::runtime_error("Pak entry not found: " + std::string(name));
+
+        const std::span<const u8> stored = m_file.bytes().subspan(entry->offset, entry->stored);
+
+        if (entry->blocks == 0)
+            return stored;
+
+        const usize table_size = (usize)entry->blocks * sizeof(u32);
+        usize position = table_size;
+
+        if (table_size > stored.size())
+            throw std::runtime_error("Corrupted pak entry: " + std::string(name));
+        scratch.resize(entry->size);
+        for (u32 i = 0; i < entry->blocks; ++i) {
+            const usize start = (usize)i * m_header->block_size;
+            const usize block_size = std::min<usize>(m_header->block_size, entry->size - start);
+            const u32 packed_size = read32(stored.data() + i * sizeof(u32));
+            const std::span<u8> block(scratch.data() + start, block_size);
+
+            if (packed_size > stored.size() - position)
+                throw std::runtime_error("Corrupted pak entry: " + std::string(name));
+
+            const std::span<const u8> packed = stored.subspan(position, packed_size);
+
+            if (packed_size == block_size)
+                std::memcpy(block.data(), packed.data(), block_size);
+            else if (lzDecompress(packed, block) == false)
+                throw std::runtime_error("Corrupted pak entry: " + std::string(name));
+            position += packed_size;
+        }
+        return scratch;
+    }
+
+    const AtlasRegion* Pak::region(std::string_view name) const
+    {
+        const auto it = m_atlas.regions.find(name);
+
+        return it == m_atlas.regions.end() ? nullptr : &it->second;
+    }
+
+    Texture Pak::texture(std::string_view name) const
+    {
+        const AtlasRegion *packed = region(name);
+
+        if (packed == nullptr)
+            return loadTexture(name);
+
+        Texture texture(nullptr);
+
+        {
+            std::lock_guard lock(m_pages_mutex);
+            Texture& page = m_pages[packed->page];
+
+            if (page.raw_handle() == nullptr)
+                page = loadTexture(m_atlas.pages[packed->page]);
+            texture = page;
+        }
+        if (texture.raw_handle())
+            texture.setRegion(packed->region);
+        return texture;
+    }
+
+    Texture Pak::loadTexture(std::string_view name) const
+    {
+        std::vector<u8> scratch;
+        const auto image = data(name, scratch);
+        Texture texture;
+
+        // The mapping is read only, loading from memory only reads it
+        texture.load(const_cast<u8 *>(image.data()), image.size());
+        return texture;
+    }
+
+    AnimationRegistry Pak::animations(std::string_view name) const
+    {
+        std::vector<u8> scratch;
+
+        return decodeAnimations(data(name, scratch));
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Kat/meta.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace kat {
+
+    /**
+     * @brief Runs a function over ranges of [0, count), on several threads
+     *        when there are at least two grains of work.
+     *        Internal to the library, shared by the image kernels and decoders.
+     *
+     * @param count The number of items.
+     * @param grain The number of items worth a thread.
+     * @param function Called with the begin and end of each range.
+     */
+    template<typename Function>
+    void parallelFor(usize count, usize grain, const Function& function)
+    {
+        const usize hardware = std::max(1u, std::thread::hardware_concurrency());
+        const usize threads = std::min(hardware, count / std::max<usize>(grain, 1));
+
+        if (threads < 2) {
+            function(0, count);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        const usize chunk = (count + threads - 1) / threads;
+
+        for (usize t = 1; t < threads; ++t) {
+            const usize begin = std::min(count, t * chunk);
+            const usize end = std::min(count, begin + chunk);
+
+            if (begin < end)
+                workers.emplace_back(function, begin, end);
+        }
+        function(0, std::min(count, chunk));
+        for (auto& worker : workers)
+            worker.join();
+    }
+}
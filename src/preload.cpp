@@ -0,0 +1,161 @@
+#include "Kat/preload.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace kat {
+
+    static std::unordered_map<std::string, Preloader>& preloaders()
+    {
+        static std::unordered_map<std::string, Preloader> registry = {
+            { "texture", [](ResourceLoader& loader, const PreloadEntry& entry,
+                            LoadPriority priority, const LoadBundle* bundle) {
+                return loader.loadTexture(entry.name, entry.source, priority, bundle);
+            } }
+        };
+
+        return registry;
+    }
+
+    bool PreloadManifest::load(const std::string& filename)
+    {
+        std::ifstream file(filename);
+        std::string line;
+
+        if (!file)
+            return false;
+
+        m_entries.clear();
+        while (std::getline(file, line)) {
+            if (line.empty() == false && line.back() == '\r')
+                line.pop_back();
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::istringstream fields(line);
+            std::string time;
+            PreloadEntry entry;
+
+            if (!std::getline(fields, time, '\t') || !std::getline(fields, entry.kind, '\t')
+                || !std::getline(fields, entry.name, '\t') || !std::getline(fields, entry.source))
+                continue;
+            entry.time = (u32)std::strtoul(time.c_str(), nullptr, 10);
+            m_entries.push_back(std::move(entry));
+        }
+        return true;
+    }
+
+    bool PreloadManifest::save(const std::string& filename) const
+    {
+        std::ofstream file(filename, std::ios::trunc);
+
+        if (!file)
+            return false;
+
+        file << "# time\tkind\tname\tsource\n";
+        for (const auto& entry : m_entries)
+            file << entry.time << '\t' << entry.kind << '\t' << entry.name << '\t' << entry.source << '\n';
+        return (bool)file;
+    }
+
+    PreloadManifest& PreloadManifest::add(const PreloadEntry& entry)
+    {
+        m_entries.push_back(entry);
+        return *this;
+    }
+
+    PreloadManifest& PreloadManifest::clear()
+    {
+        m_entries.clear();
+        return *this;
+    }
+
+    const std::vector<PreloadEntry>& PreloadManifest::entries() const
+    {
+        return m_entries;
+    }
+
+    usize PreloadManifest::size() const
+    {
+        return m_entries.size();
+    }
+
+    PreloadRecorder::PreloadRecorder(ResourceManager& resources, std::chrono::milliseconds duration)
+        : m_resources(resources), m_start(std::chrono::steady_clock::now()), m_duration(duration)
+    {
+        m_resources.onFirstUse([this](const ResourceName& name) { access(name); });
+    }
+
+    PreloadRecorder::~PreloadRecorder()
+    {
+        m_resources.onFirstUse(nullptr);
+    }
+
+    PreloadRecorder& PreloadRecorder::setSource(const std::string& kind, const ResourceName& name,
+                                                const std::string& source)
+    {
+        Source& entry = m_sources[name];
+
+        entry.kind = kind;
+        entry.source = source;
+        return *this;
+    }
+
+    void PreloadRecorder::access(const ResourceName& name)
+    {
+        if (isRecording() == false)
+            return;
+
+        const auto it = m_sources.find(name);
+
+        // Resources of unknown source can not be preloaded
+        if (it == m_sources.end() || it->second.recorded)
+            return;
+        it->second.recorded = true;
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - m_start);
+
+        m_manifest.add({ (u32)elapsed.count(), it->second.kind, name, it->second.source });
+    }
+
+    bool PreloadRecorder::isRecording() const
+    {
+        return m_duration.count() == 0 || std::chrono::steady_clock::now() - m_start < m_duration;
+    }
+
+    const PreloadManifest& PreloadRecorder::manifest() const
+    {
+        return m_manifest;
+    }
+
+    bool PreloadRecorder::save(const std::string& filename) const
+    {
+        return m_manifest.save(filename);
+    }
+
+    void setPreloader(const std::string& kind, const Preloader& preloader)
+    {
+        preloaders()[kind] = preloader;
+    }
+
+    LoadBundle preload(ResourceLoader& loader, const PreloadManifest& manifest, LoadPriority priority,
+                       std::string_view prefix)
+    {
+        LoadBundle bundle = loader.bundle();
+        const auto& registry = preloaders();
+
+        for (const auto& entry : manifest.entries()) {
+            if (entry.name.starts_with(prefix) == false)
+                continue;
+
+            const auto it = registry.find(entry.kind);
+
+            if (it == registry.end())
+                continue;
+            it->second(loader, entry, priority--, &bundle);
+        }
+        return bundle;
+    }
+}
@@ -1 +1,38 @@
-#include "Kat/resource.h"
\ No newline at end of file
+#include "Kat/resource.h"
+
+#include <atomic>
+#include <cstdlib>
+
+namespace kat {
+
+    ResourceBytes resourceBytes(const Texture& texture)
+    {
+        const sf::Texture *handle = texture.raw_handle();
+
+        if (handle == nullptr)
+            return { sizeof(Texture), 0 };
+
+        // Regions share the page of their atlas, each one is charged for its own pixels
+        if (texture.hasRegion()) {
+            const Frame& region = texture.region();
+
+            return { sizeof(Texture), (usize)std::abs(region.width) * std::abs(region.height) * 4 };
+        }
+
+        const TextureSize size = handle->getSize();
+
+        return { sizeof(Texture) + sizeof(sf::Texture), (usize)size.x * size.y * 4 };
+    }
+
+    bool isResourceShared(const Texture& texture)
+    {
+        return texture.shared_handle().use_count() > 1;
+    }
+
+    usize nextResourceTypeIndex()
+    {
+        static std::atomic<usize> next = 0;
+
+        return next++;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "Kat/scheduler.h"
+
+#include <SFML/System/Sleep.hpp>
+
+#include <algorithm>
+#include <thread>
+
+namespace kat {
+
+    // Under this amount the os sleep is too coarse, the remaining time is spent yielding.
+    static const FrameDuration spin_threshold = sf::microseconds(1500);
+
+    FrameScheduler& FrameScheduler::setFps(const FpsLimit& limit)
+    {
+        m_period = limit ? sf::microseconds(1000000 / limit) : FrameDuration::Zero;
+        m_started = false;
+        return *this;
+    }
+
+    FpsLimit FrameScheduler::getFps() const
+    {
+        if (m_period == FrameDuration::Zero)
+            return 0;
+        return (FpsLimit)(1000000 / m_period.asMicroseconds());
+    }
+
+    FrameScheduler& FrameScheduler::setSafetyMargin(const FrameDuration& margin)
+    {
+        m_margin = margin;
+        return *this;
+    }
+
+    void FrameScheduler::latch()
+    {
+        const FrameDuration now = m_clock.getElapsedTime();
+
+        if (m_period == FrameDuration::Zero) {
+            m_latched = now;
+            return;
+        }
+        if (m_started == false) {
+            m_deadline = now + m_period;
+            m_started = true;
+        }
+
+        const FrameDuration wake = m_deadline - predictedCost() - m_margin;
+
+        if (wake - now > spin_threshold)
+            sf::sleep(wake - now - spin_threshold);
+        while (m_clock.getElapsedTime() < wake)
+            std::this_thread::yield();
+        m_latched = m_clock.getElapsedTime();
+    }
+
+    void FrameScheduler::present()
+    {
+        const FrameDuration now = m_clock.getElapsedTime();
+
+        m_history[m_history_index] = now - m_latched;
+        m_history_index = (m_history_index + 1) % HistorySize;
+
+        if (m_period == FrameDuration::Zero)
+            return;
+        m_deadline += m_period;
+        // The frame missed its deadline, resynchronize instead of trying to catch up
+        if (m_deadline < now)
+            m_deadline = now + m_period;
+    }
+
+    FrameDuration FrameScheduler::predictedCost() const
+    {
+        FrameDuration prediction = FrameDuration::Zero;
+
+        for (const auto& cost : m_history)
+            prediction = std::max(prediction, cost);
+        // Never plan more than a whole frame of work
+        return std::min(prediction, m_period);
+    }
+
+    FrameDuration FrameScheduler::lastCost() const
+    {
+        return m_history[(m_history_index + HistorySize - 1) % HistorySize];
+    }
+}
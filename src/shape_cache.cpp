@@ -0,0 +1,289 @@
+#include "Kat/shape_cache.h"
+#include "Kat/effects.h"
+
+#include <SFML/Graphics/CircleShape.hpp>
+#include <SFML/Graphics/RectangleShape.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace kat {
+
+    namespace {
+
+        /// The width of the effect textures, in texels (one per vertex).
+        constexpr u32 EffectTextureWidth = 1024;
+
+        enum class ShapeKind {
+            Circle = 1,
+            Rectangle,
+            Generic
+        };
+
+        /**
+         * @brief Gets the parameters of a shape that its tessellation depends on.
+         */
+        void shapeParameters(const sf::Shape& shape, std::vector<float>& parameters)
+        {
+            parameters.clear();
+            if (const auto *circle = dynamic_cast<const sf::CircleShape *>(&shape)) {
+                parameters.insert(parameters.end(), { (float)ShapeKind::Circle, circle->getRadius() });
+            } else if (const auto *rect = dynamic_cast<const sf::RectangleShape *>(&shape)) {
+                parameters.insert(parameters.end(), { (float)ShapeKind::Rectangle, rect->getSize().x, rect->getSize().y });
+            } else {
+                parameters.push_back((float)ShapeKind::Generic);
+                for (usize i = 0; i < shape.getPointCount(); ++i) {
+                    const auto point = shape.getPoint(i);
+                    parameters.insert(parameters.end(), { point.x, point.y });
+                }
+            }
+            parameters.insert(parameters.end(), { (float)shape.getPointCount(), shape.getOutlineThickness() });
+        }
+
+        ShapeKey shapeKey(const std::vector<float>& parameters)
+        {
+            const auto *bytes = reinterpret_cast<const u8 *>(parameters.data());
+            ShapeKey hash = 0xcbf29ce484222325ULL;
+
+            // FNV-1a
+            for (usize i = 0; i < parameters.size() * sizeof(float); ++i) {
+                hash ^= bytes[i];
+                hash *= 0x100000001b3ULL;
+            }
+            return hash;
+        }
+
+        Vector2f computeNormal(const Vector2f& p1, const Vector2f& p2)
+        {
+            Vector2f normal(p1.y - p2.y, p2.x - p1.x);
+            const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y);
+
+            if (length != 0.0f) {
+                normal.x /= length;
+                normal.y /= length;
+            }
+            return normal;
+        }
+
+        float dot(const Vector2f& a, const Vector2f& b)
+        {
+            return a.x * b.x + a.y * b.y;
+        }
+
+        // Same tessellation as sf::Shape, as triangle lists instead of fans and strips
+        ShapeMesh tessellate(const sf::Shape& shape)
+        {
+            const usize count = shape.getPointCount();
+            const float thickness = shape.getOutlineThickness();
+            std::vector<Vector2f> points(count);
+            ShapeMesh mesh;
+
+            if (count < 3)
+                return mesh;
+
+            Vector2f min(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+            Vector2f max(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+
+            for (usize i = 0; i < count; ++i) {
+                points[i] = shape.getPoint(i);
+                min = Vector2f(std::min(min.x, points[i].x), std::min(min.y, points[i].y));
+                max = Vector2f(std::max(max.x, points[i].x), std::max(max.y, points[i].y));
+            }
+            mesh.bounds = FloatRect(min.x, min.y, max.x - min.x, max.y - min.y);
+
+            const Vector2f center(min.x + mesh.bounds.width / 2, min.y + mesh.bounds.height / 2);
+
+            mesh.fill.reserve(count * 3);
+            for (usize i = 0; i < count; ++i) {
+                mesh.fill.push_back(center);
+                mesh.fill.push_back(points[i]);
+                mesh.fill.push_back(points[(i + 1) % count]);
+            }
+
+            if (thickness == 0.0f)
+                return mesh;
+
+            std::vector<Vector2f> outer(count);
+
+            for (usize i = 0; i < count; ++i) {
+                const Vector2f& p0 = points[(i + count - 1) % count];
+                const Vector2f& p1 = points[i];
+                const Vector2f& p2 = points[(i + 1) % count];
+                const Vector2f to_center(center.x - p1.x, center.y - p1.y);
+                Vector2f n1 = computeNormal(p0, p1);
+                Vector2f n2 = computeNormal(p1, p2);
+
+                // Make sure that the normals point towards the outside of the shape
+                if (dot(n1, to_center) > 0)
+                    n1 = Vector2f(-n1.x, -n1.y);
+                if (dot(n2, to_center) > 0)
+                    n2 = Vector2f(-n2.x, -n2.y);
+
+                const float factor = 1.0f + dot(n1, n2);
+
+                outer[i] = Vector2f(p1.x + (n1.x + n2.x) / factor * thickness,
+                                    p1.y + (n1.y + n2.y) / factor * thickness);
+            }
+
+            mesh.outline.reserve(count * 6);
+            for (usize i = 0; i < count; ++i) {
+                const usize next = (i + 1) % count;
+
+                mesh.outline.push_back(points[i]);
+                mesh.outline.push_back(outer[i]);
+                mesh.outline.push_back(points[next]);
+                mesh.outline.push_back(outer[i]);
+                mesh.outline.push_back(outer[next]);
+                mesh.outline.push_back(points[next]);
+            }
+            return mesh;
+        }
+    }
+
+    const ShapeMesh& ShapeCache::get(const sf::Shape& shape)
+    {
+        shapeParameters(shape, m_parameters);
+
+        const ShapeKey key = shapeKey(m_parameters);
+        const auto it = m_meshes.find(key);
+
+        if (it != m_meshes.end() && it->second.parameters == m_parameters) {
+            ++m_hits;
+            return it->second.mesh;
+        }
+        ++m_misses;
+        // A colliding shape takes the place of the cached one
+        if (it != m_meshes.end()) {
+            it->second = { m_parameters, tessellate(shape) };
+            return it->second.mesh;
+        }
+        if (m_meshes.size() >= MaxEntries)
+            m_meshes.clear();
+        return m_meshes.emplace(key, Entry{ m_parameters, tessellate(shape) }).first->second.mesh;
+    }
+
+    usize ShapeCache::size() const
+    {
+        return m_meshes.size();
+    }
+
+    usize ShapeCache::hits() const
+    {
+        return m_hits;
+    }
+
+    usize ShapeCache::misses() const
+    {
+        return m_misses;
+    }
+
+    void ShapeCache::clear()
+    {
+        m_meshes.clear();
+        m_hits = 0;
+        m_misses = 0;
+    }
+
+    ShapeBatch::ShapeBatch(const sf::Texture* texture)
+    {
+        reset(texture);
+    }
+
+    void ShapeBatch::append(std::span<const Vector2f> triangles, const sf::Transform& transform,
+                            const sf::Color& color)
+    {
+        for (const auto& point : triangles) {
+            const Vector2f position = transform.transformPoint(point);
+
+            m_min = Vector2f(std::min(m_min.x, position.x), std::min(m_min.y, position.y));
+            m_max = Vector2f(std::max(m_max.x, position.x), std::max(m_max.y, position.y));
+            m_vertices.emplace_back(position, color);
+        }
+    }
+
+    void ShapeBatch::append(std::span<const Vector2f> triangles, const sf::Transform& transform,
+                            const sf::Color& color, const FloatRect& bounds,
+                            const IntRect& texture_rect)
+    {
+        const usize first = m_vertices.size();
+
+        append(triangles, transform, color);
+        for (usize i = 0; i < triangles.size(); ++i) {
+            const float x = bounds.width > 0 ? (triangles[i].x - bounds.left) / bounds.width : 0;
+            const float y = bounds.height > 0 ? (triangles[i].y - bounds.top) / bounds.height : 0;
+
+            m_vertices[first + i].texCoords = Vector2f(texture_rect.left + texture_rect.width * x,
+                                                       texture_rect.top + texture_rect.height * y);
+        }
+    }
+
+    void ShapeBatch::append(std::span<const Vector2f> triangles, const sf::Transform& transform,
+                            const sf::Color& color, const FloatRect& bounds,
+                            const IntRect& texture_rect, const sf::Color& effect)
+    {
+        const usize first = m_vertices.size();
+
+        append(triangles, transform, color, bounds, texture_rect);
+        m_effects.resize(first, encodeEffect(EffectParams()));
+        m_effects.resize(m_vertices.size(), effect);
+    }
+
+    void ShapeBatch::reset(const sf::Texture* texture, sf::Shader* shader)
+    {
+        m_texture = texture;
+        m_shader = shader;
+        m_vertices.clear();
+        m_effects.clear();
+        m_min = Vector2f(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+        m_max = Vector2f(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+    }
+
+    const sf::Texture* ShapeBatch::getTexture() const
+    {
+        return m_texture;
+    }
+
+    sf::Shader* ShapeBatch::getShader() const
+    {
+        return m_shader;
+    }
+
+    std::span<const sf::Vertex> ShapeBatch::getVertices() const
+    {
+        return m_vertices;
+    }
+
+    FloatRect ShapeBatch::getGlobalBounds() const
+    {
+        if (m_vertices.empty())
+            return FloatRect();
+        return FloatRect(m_min.x, m_min.y, m_max.x - m_min.x, m_max.y - m_min.y);
+    }
+
+    void ShapeBatch::draw(sf::RenderTarget& target, const sf::RenderStates& states) const
+    {
+        sf::RenderStates batch_states(states);
+
+        batch_states.texture = m_texture;
+        if (m_shader && m_texture) {
+            const auto size = m_texture->getSize();
+
+            m_shader->setUniform("kat_texel", sf::Glsl::Vec2(1.0f / size.x, 1.0f / size.y));
+            batch_states.shader = m_shader;
+            if (m_vertices.empty() == false) {
+                // Vertices appended without an effect are drawn as they are
+                const u32 rows = (u32)((m_vertices.size() + EffectTextureWidth - 1) / EffectTextureWidth);
+
+                m_effects.resize((usize)rows * EffectTextureWidth, encodeEffect(EffectParams()));
+                if (m_effect_texture.getSize().y < rows
+                    && m_effect_texture.create({ EffectTextureWidth, std::max(rows, m_effect_texture.getSize().y * 2) }) == false)
+                    return;
+                m_effect_texture.update(reinterpret_cast<const u8 *>(m_effects.data()), { EffectTextureWidth, rows }, { 0, 0 });
+                m_effects.resize(m_vertices.size());
+                m_shader->setUniform("kat_effects", m_effect_texture);
+            }
+        }
+        target.draw(m_vertices.data(), m_vertices.size(), sf::PrimitiveType::Triangles, batch_states);
+    }
+}
@@ -0,0 +1,485 @@
+#include "Kat/stream_renderer.h"
+
+#include <SFML/OpenGL.hpp>
+#include <SFML/Window/Context.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <optional>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+namespace kat {
+
+    namespace {
+
+        // Only the gl 1.1 entry points are exported everywhere, the others are loaded
+        // through sfml. Types and enums are declared here so no loader is needed.
+        using GlSync = void *;
+
+        constexpr GLenum GlArrayBuffer = 0x8892;
+        constexpr GLenum GlStreamDraw = 0x88E0;
+        constexpr GLbitfield GlMapWrite = 0x0002;
+        constexpr GLbitfield GlMapPersistent = 0x0040;
+        constexpr GLbitfield GlMapCoherent = 0x0080;
+        constexpr GLenum GlSyncGpuCommandsComplete = 0x9117;
+        constexpr GLbitfield GlSyncFlushCommands = 0x0001;
+        constexpr GLenum GlAlreadySignaled = 0x911A;
+        constexpr GLenum GlConditionSatisfied = 0x911C;
+        constexpr GLenum GlWaitFailed = 0x911D;
+        constexpr GLenum GlFragmentShader = 0x8B30;
+        constexpr GLenum GlVertexShader = 0x8B31;
+        constexpr GLenum GlCompileStatus = 0x8B81;
+        constexpr GLenum GlLinkStatus = 0x8B82;
+        constexpr GLenum GlTexture0 = 0x84C0;
+        constexpr GLenum GlFuncAdd = 0x8006;
+
+        struct GlFunctions {
+            void (APIENTRY *GenBuffers)(GLsizei, GLuint *) = nullptr;
+            void (APIENTRY *DeleteBuffers)(GLsizei, const GLuint *) = nullptr;
+            void (APIENTRY *BindBuffer)(GLenum, GLuint) = nullptr;
+            void (APIENTRY *BufferData)(GLenum, std::ptrdiff_t, const void *, GLenum) = nullptr;
+            void (APIENTRY *BufferSubData)(GLenum, std::ptrdiff_t, std::ptrdiff_t, const void *) = nullptr;
+            void (APIENTRY *BufferStorage)(GLenum, std::ptrdiff_t, const void *, GLbitfield) = nullptr;
+            void *(APIENTRY *MapBufferRange)(GLenum, std::ptrdiff_t, std::ptrdiff_t, GLbitfield) = nullptr;
+            GlSync (APIENTRY *FenceSync)(GLenum, GLbitfield) = nullptr;
+            GLenum (APIENTRY *ClientWaitSync)(GlSync, GLbitfield, u64) = nullptr;
+            void (APIENTRY *DeleteSync)(GlSync) = nullptr;
+            void (APIENTRY *GenVertexArrays)(GLsizei, GLuint *) = nullptr;
+            void (APIENTRY *DeleteVertexArrays)(GLsizei, const GLuint *) = nullptr;
+            void (APIENTRY *BindVertexArray)(GLuint) = nullptr;
+            void (APIENTRY *VertexAttribPointer)(GLuint, GLint, GLenum, GLboolean, GLsizei, const void *) = nullptr;
+            void (APIENTRY *EnableVertexAttribArray)(GLuint) = nullptr;
+            GLuint (APIENTRY *CreateShader)(GLenum) = nullptr;
+            void (APIENTRY *ShaderSource)(GLuint, GLsizei, const char *const *, const GLint *) = nullptr;
+            void (APIENTRY *CompileShader)(GLuint) = nullptr;
+            void (APIENTRY *GetShaderiv)(GLuint, GLenum, GLint *) = nullptr;
+            void (APIENTRY *DeleteShader)(GLuint) = nullptr;
+            GLuint (APIENTRY *CreateProgram)() = nullptr;
+            void (APIENTRY *AttachShader)(GLuint, GLuint) = nullptr;
+            void (APIENTRY *BindAttribLocation)(GLuint, GLuint, const char *) = nullptr;
+            void (APIENTRY *LinkProgram)(GLuint) = nullptr;
+            void (APIENTRY *GetProgramiv)(GLuint, GLenum, GLint *) = nullptr;
+            void (APIENTRY *UseProgram)(GLuint) = nullptr;
+            void (APIENTRY *DeleteProgram)(GLuint) = nullptr;
+            GLint (APIENTRY *GetUniformLocation)(GLuint, const char *) = nullptr;
+            void (APIENTRY *Uniform1i)(GLint, GLint) = nullptr;
+            void (APIENTRY *Uniform1f)(GLint, GLfloat) = nullptr;
+            void (APIENTRY *Uniform2f)(GLint, GLfloat, GLfloat) = nullptr;
+            void (APIENTRY *UniformMatrix4fv)(GLint, GLsizei, GLboolean, const GLfloat *) = nullptr;
+            void (APIENTRY *ActiveTexture)(GLenum) = nullptr;
+            void (APIENTRY *BlendFuncSeparate)(GLenum, GLenum, GLenum, GLenum) = nullptr;
+            void (APIENTRY *BlendEquation)(GLenum) = nullptr;
+        };
+
+        GlFunctions gl;
+
+        template<typename Function>
+        bool loadFunction(Function& function, const char *name)
+        {
+            function = reinterpret_cast<Function>(sf::Context::getFunction(name));
+            return function != nullptr;
+        }
+
+        bool loadFunctions()
+        {
+            // Buffer storage and fences are optional, the buffer is orphaned without them
+            loadFunction(gl.BufferStorage, "glBufferStorage");
+            loadFunction(gl.MapBufferRange, "glMapBufferRange");
+            loadFunction(gl.FenceSync, "glFenceSync");
+            loadFunction(gl.ClientWaitSync, "glClientWaitSync");
+            loadFunction(gl.DeleteSync, "glDeleteSync");
+
+            return loadFunction(gl.GenBuffers, "glGenBuffers")
+                && loadFunction(gl.DeleteBuffers, "glDeleteBuffers")
+                && loadFunction(gl.BindBuffer, "glBindBuffer")
+                && loadFunction(gl.BufferData, "glBufferData")
+                && loadFunction(gl.BufferSubData, "glBufferSubData")
+                && loadFunction(gl.GenVertexArrays, "glGenVertexArrays")
+                && loadFunction(gl.DeleteVertexArrays, "glDeleteVertexArrays")
+                && loadFunction(gl.BindVertexArray, "glBindVertexArray")
+                && loadFunction(gl.VertexAttribPointer, "glVertexAttribPointer")
+                && loadFunction(gl.EnableVertexAttribArray, "glEnableVertexAttribArray")
+                && loadFunction(gl.CreateShader, "glCreateShader")
+                && loadFunction(gl.ShaderSource, "glShaderSource")
+                && loadFunction(gl.CompileShader, "glCompileShader")
+                && loadFunction(gl.GetShaderiv, "glGetShaderiv")
+                && loadFunction(gl.DeleteShader, "glDeleteShader")
+                && loadFunction(gl.CreateProgram, "glCreateProgram")
+                && loadFunction(gl.AttachShader, "glAttachShader")
+                && loadFunction(gl.BindAttribLocation, "glBindAttribLocation")
+                && loadFunction(gl.LinkProgram, "glLinkProgram")
+                && loadFunction(gl.GetProgramiv, "glGetProgramiv")
+                && loadFunction(gl.UseProgram, "glUseProgram")
+                && loadFunction(gl.DeleteProgram, "glDeleteProgram")
+                && loadFunction(gl.GetUniformLocation, "glGetUniformLocation")
+                && loadFunction(gl.Uniform1i, "glUniform1i")
+                && loadFunction(gl.Uniform1f, "glUniform1f")
+                && loadFunction(gl.Uniform2f, "glUniform2f")
+                && loadFunction(gl.UniformMatrix4fv, "glUniformMatrix4fv")
+                && loadFunction(gl.ActiveTexture, "glActiveTexture")
+                && loadFunction(gl.BlendFuncSeparate, "glBlendFuncSeparate")
+                && loadFunction(gl.BlendEquation, "glBlendEquation");
+        }
+
+        const char *stream_vertex_shader = R"(
+            #version 130
+
+            uniform mat4 kat_projection;
+            uniform mat4 kat_texture_matrix;
+            uniform vec2 kat_origin;
+            uniform float kat_scale;
+
+            in vec2 kat_position;
+            in vec4 kat_color;
+            in vec2 kat_uv;
+
+            out vec4 kat_frag_color;
+            out vec2 kat_frag_uv;
+
+            void main()
+            {
+                gl_Position = kat_projection * vec4(kat_origin + kat_position * kat_scale, 0.0, 1.0);
+                kat_frag_color = kat_color;
+                kat_frag_uv = (kat_texture_matrix * vec4(kat_uv, 0.0, 1.0)).xy;
+            }
+        )";
+
+        const char *stream_fragment_shader = R"(
+            #version 130
+
+            uniform sampler2D kat_texture;
+            uniform float kat_textured;
+
+            in vec4 kat_frag_color;
+            in vec2 kat_frag_uv;
+
+            void main()
+            {
+                gl_FragColor = mix(vec4(1.0), texture(kat_texture, kat_frag_uv), kat_textured) * kat_frag_color;
+            }
+        )";
+
+        GLuint compileShader(GLenum type, const char *source)
+        {
+            const GLuint shader = gl.CreateShader(type);
+            GLint status = GL_FALSE;
+
+            gl.ShaderSource(shader, 1, &source, nullptr);
+            gl.CompileShader(shader);
+            gl.GetShaderiv(shader, GlCompileStatus, &status);
+            if (status == GL_FALSE) {
+                gl.DeleteShader(shader);
+                return 0;
+            }
+            return shader;
+        }
+
+        enum Attribute : GLuint {
+            PositionAttribute = 0,
+            ColorAttribute,
+            UvAttribute
+        };
+    }
+
+    bool StreamRenderer::create(sf::RenderTarget& target)
+    {
+        if (m_available)
+            return true;
+        if (target.setActive(true) == false || loadFunctions() == false)
+            return false;
+
+        const GLuint vertex = compileShader(GlVertexShader, stream_vertex_shader);
+        const GLuint fragment = compileShader(GlFragmentShader, stream_fragment_shader);
+        GLint status = GL_FALSE;
+
+        if (vertex && fragment) {
+            m_program = gl.CreateProgram();
+            gl.AttachShader(m_program, vertex);
+            gl.AttachShader(m_program, fragment);
+            gl.BindAttribLocation(m_program, PositionAttribute, "kat_position");
+            gl.BindAttribLocation(m_program, ColorAttribute, "kat_color");
+            gl.BindAttribLocation(m_program, UvAttribute, "kat_uv");
+            gl.LinkProgram(m_program);
+            gl.GetProgramiv(m_program, GlLinkStatus, &status);
+        }
+        if (vertex)
+            gl.DeleteShader(vertex);
+        if (fragment)
+            gl.DeleteShader(fragment);
+        if (status == GL_FALSE) {
+            if (m_program)
+                gl.DeleteProgram(m_program);
+            m_program = 0;
+            return false;
+        }
+
+        m_projection_location = gl.GetUniformLocation(m_program, "kat_projection");
+        m_texture_matrix_location = gl.GetUniformLocation(m_program, "kat_texture_matrix");
+        m_origin_location = gl.GetUniformLocation(m_program, "kat_origin");
+        m_scale_location = gl.GetUniformLocation(m_program, "kat_scale");
+        m_textured_location = gl.GetUniformLocation(m_program, "kat_textured");
+        gl.UseProgram(m_program);
+        gl.Uniform1i(gl.GetUniformLocation(m_program, "kat_texture"), 0);
+        gl.UseProgram(0);
+
+        const usize size = SectionSize * Sections;
+
+        gl.GenVertexArrays(1, &m_vao);
+        gl.GenBuffers(1, &m_buffer);
+        gl.BindBuffer(GlArrayBuffer, m_buffer);
+        m_persistent = gl.BufferStorage && gl.MapBufferRange && gl.FenceSync
+                    && gl.ClientWaitSync && gl.DeleteSync;
+        if (m_persistent) {
+            const GLbitfield flags = GlMapWrite | GlMapPersistent | GlMapCoherent;
+
+            gl.BufferStorage(GlArrayBuffer, size, nullptr, flags);
+            m_mapped = static_cast<u8 *>(gl.MapBufferRange(GlArrayBuffer, 0, size, flags));
+            m_persistent = m_mapped != nullptr;
+        }
+        if (m_persistent == false) {
+            // Immutable storage can not be respecified, start over with a mutable buffer
+            gl.DeleteBuffers(1, &m_buffer);
+            gl.GenBuffers(1, &m_buffer);
+            gl.BindBuffer(GlArrayBuffer, m_buffer);
+            gl.BufferData(GlArrayBuffer, size, nullptr, GlStreamDraw);
+        }
+        gl.BindBuffer(GlArrayBuffer, 0);
+
+        m_offset = 0;
+        m_target = &target;
+        m_available = true;
+        return true;
+    }
+
+    bool StreamRenderer::isAvailable() const
+    {
+        return m_available;
+    }
+
+    bool StreamRenderer::isPersistent() const
+    {
+        return m_persistent;
+    }
+
+    StreamRenderer& StreamRenderer::setVertexFormat(VertexFormat format)
+    {
+        m_format = format;
+        return *this;
+    }
+
+    VertexFormat StreamRenderer::getVertexFormat() const
+    {
+        return m_format;
+    }
+
+    usize StreamRenderer::uploaded() const
+    {
+        return m_uploaded;
+    }
+
+    usize StreamRenderer::reserve(usize size)
+    {
+        // The section being written, a full section is still the current one
+        const usize section = m_offset == 0 ? 0 : (m_offset - 1) / SectionSize;
+
+        if (m_offset - section * SectionSize + size > SectionSize) {
+            const usize next = (section + 1) % Sections;
+
+            if (m_persistent) {
+                // The gpu may still read the section that is left until the commands
+                // issued so far complete, the next one is waited for before writing it
+                m_fences[section] = gl.FenceSync(GlSyncGpuCommandsComplete, 0);
+                if (m_fences[next]) {
+                    GLenum result;
+
+                    do {
+                        result = gl.ClientWaitSync(m_fences[next], GlSyncFlushCommands, 1000000000ULL);
+                    } while (result != GlAlreadySignaled && result != GlConditionSatisfied
+                             && result != GlWaitFailed);
+                    gl.DeleteSync(m_fences[next]);
+                    m_fences[next] = nullptr;
+                }
+            } else if (next == 0) {
+                // Orphaned: the driver hands out new storage, the old one is freed
+                // once the gpu is done with it
+                gl.BufferData(GlArrayBuffer, SectionSize * Sections, nullptr, GlStreamDraw);
+            }
+            m_offset = next * SectionSize;
+        }
+
+        const usize offset = m_offset;
+
+        m_offset += size;
+        m_uploaded += size;
+        return offset;
+    }
+
+    void StreamRenderer::upload(usize offset, const void *data, usize size)
+    {
+        if (m_persistent) {
+            std::memcpy(m_mapped + offset, data, size);
+        } else {
+            gl.BufferSubData(GlArrayBuffer, offset, size, data);
+        }
+    }
+
+    void StreamRenderer::draw(sf::RenderTarget& target, const sf::View& view,
+                              std::span<const sf::Vertex> triangles, const sf::Texture* texture)
+    {
+        if (m_available == false || triangles.empty())
+            return;
+        // The vertex array only exists in the context of the target the renderer was created for
+        if (&target != m_target) {
+            const sf::View saved = target.getView();
+
+            target.setView(view);
+            target.draw(triangles.data(), triangles.size(), sf::PrimitiveType::Triangles, sf::RenderStates(texture));
+            target.setView(saved);
+            return;
+        }
+        if (target.setActive(true) == false)
+            return;
+
+        const auto viewport = target.getViewport(view);
+        const auto target_size = target.getSize();
+        const sf::Vector2f texture_size = texture ? sf::Vector2f(texture->getSize()) : sf::Vector2f(1.0f, 1.0f);
+
+        glViewport(viewport.left, (GLint)target_size.y - (viewport.top + viewport.height),
+                   viewport.width, viewport.height);
+        glEnable(GL_BLEND);
+        gl.BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        gl.BlendEquation(GlFuncAdd);
+
+        gl.UseProgram(m_program);
+        gl.UniformMatrix4fv(m_projection_location, 1, GL_FALSE, view.getTransform().getMatrix());
+        gl.ActiveTexture(GlTexture0);
+        if (texture == nullptr) {
+            const GLfloat identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+            sf::Texture::bind(nullptr);
+            gl.UniformMatrix4fv(m_texture_matrix_location, 1, GL_FALSE, identity);
+        }
+        gl.Uniform1f(m_textured_location, texture ? 1.0f : 0.0f);
+        gl.BindVertexArray(m_vao);
+        gl.BindBuffer(GlArrayBuffer, m_buffer);
+        gl.EnableVertexAttribArray(PositionAttribute);
+        gl.EnableVertexAttribArray(ColorAttribute);
+        gl.EnableVertexAttribArray(UvAttribute);
+
+        const usize max_count = SectionSize / sizeof(sf::Vertex) / 3 * 3;
+        std::optional<bool> bound_compact;
+
+        for (usize first = 0; first < triangles.size(); first += max_count) {
+            const auto chunk = triangles.subspan(first, std::min(max_count, triangles.size() - first));
+            sf::Vector2f min(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+            sf::Vector2f max(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+            bool normalized = true;
+
+            for (const auto& vertex : chunk) {
+                min = sf::Vector2f(std::min(min.x, vertex.position.x), std::min(min.y, vertex.position.y));
+                max = sf::Vector2f(std::max(max.x, vertex.position.x), std::max(max.y, vertex.position.y));
+                normalized = normalized && vertex.texCoords.x >= 0 && vertex.texCoords.x <= texture_size.x
+                                        && vertex.texCoords.y >= 0 && vertex.texCoords.y <= texture_size.y;
+            }
+
+            // Texture coordinates outside of the texture (repeated textures) need the full format
+            const float limit = 65535.0f / PositionScale;
+            const bool compact = m_format == VertexFormat::Compact && texture_size.x > 0 && texture_size.y > 0
+                              && normalized && max.x - min.x <= limit && max.y - min.y <= limit;
+
+            if (texture && bound_compact != compact) {
+                GLfloat texture_matrix[16];
+
+                // sfml folds the flipping of render textures in the texture matrix
+                sf::Texture::bind(texture, compact ? sf::Texture::Normalized : sf::Texture::Pixels);
+                glGetFloatv(GL_TEXTURE_MATRIX, texture_matrix);
+                gl.UniformMatrix4fv(m_texture_matrix_location, 1, GL_FALSE, texture_matrix);
+                bound_compact = compact;
+            }
+
+            if (compact) {
+                const usize size = chunk.size() * sizeof(CompactVertex);
+                const usize offset = reserve(size);
+                CompactVertex *vertices;
+
+                if (m_persistent) {
+                    vertices = reinterpret_cast<CompactVertex *>(m_mapped + offset);
+                } else {
+                    m_compact.resize(chunk.size());
+                    vertices = m_compact.data();
+                }
+                for (usize i = 0; i < chunk.size(); ++i) {
+                    const sf::Vertex& vertex = chunk[i];
+
+                    vertices[i] = {
+                        (u16)std::lround((vertex.position.x - min.x) * PositionScale),
+                        (u16)std::lround((vertex.position.y - min.y) * PositionScale),
+                        (u16)std::lround(vertex.texCoords.x / texture_size.x * 65535.0f),
+                        (u16)std::lround(vertex.texCoords.y / texture_size.y * 65535.0f),
+                        vertex.color.r, vertex.color.g, vertex.color.b, vertex.color.a
+                    };
+                }
+                if (m_persistent == false)
+                    upload(offset, vertices, size);
+
+                const auto *base = reinterpret_cast<const u8 *>(offset);
+
+                gl.Uniform2f(m_origin_location, min.x, min.y);
+                gl.Uniform1f(m_scale_location, 1.0f / PositionScale);
+                gl.VertexAttribPointer(PositionAttribute, 2, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(CompactVertex),
+                                       base + offsetof(CompactVertex, x));
+                gl.VertexAttribPointer(UvAttribute, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex),
+                                       base + offsetof(CompactVertex, u));
+                gl.VertexAttribPointer(ColorAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactVertex),
+                                       base + offsetof(CompactVertex, r));
+            } else {
+                const usize size = chunk.size() * sizeof(sf::Vertex);
+                const usize offset = reserve(size);
+                const auto *base = reinterpret_cast<const u8 *>(offset);
+
+                upload(offset, chunk.data(), size);
+                gl.Uniform2f(m_origin_location, 0.0f, 0.0f);
+                gl.Uniform1f(m_scale_location, 1.0f);
+                gl.VertexAttribPointer(PositionAttribute, 2, GL_FLOAT, GL_FALSE, sizeof(sf::Vertex),
+                                       base + offsetof(sf::Vertex, position));
+                gl.VertexAttribPointer(UvAttribute, 2, GL_FLOAT, GL_FALSE, sizeof(sf::Vertex),
+                                       base + offsetof(sf::Vertex, texCoords));
+                gl.VertexAttribPointer(ColorAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(sf::Vertex),
+                                       base + offsetof(sf::Vertex, color));
+            }
+            glDrawArrays(GL_TRIANGLES, 0, (GLsizei)chunk.size());
+        }
+
+        gl.BindVertexArray(0);
+        gl.BindBuffer(GlArrayBuffer, 0);
+        gl.UseProgram(0);
+    }
+
+    StreamRenderer::~StreamRenderer()
+    {
+        if (m_available == false)
+            return;
+
+        // The vertex array belongs to the context of the target. The other objects are
+        // shared by every sfml context, they outlive a closed window
+        const bool owner = m_target->setActive(true);
+        std::optional<sf::Context> context;
+
+        if (owner == false)
+            context.emplace();
+        for (auto& fence : m_fences) {
+            if (fence)
+                gl.DeleteSync(fence);
+        }
+        gl.DeleteBuffers(1, &m_buffer);
+        if (owner)
+            gl.DeleteVertexArrays(1, &m_vao);
+        gl.DeleteProgram(m_program);
+    }
+}
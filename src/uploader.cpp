@@ -0,0 +1,199 @@
+#include "Kat/uploader.h"
+#include "Kat/components/texture_release.h"
+
+#include <SFML/OpenGL.hpp>
+#include <SFML/Window/Context.hpp>
+
+#include <chrono>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+namespace kat {
+
+    namespace {
+
+        using GlSync = void *;
+
+        constexpr GLenum GlSyncGpuCommandsComplete = 0x9117;
+        constexpr GLenum GlAlreadySignaled = 0x911A;
+        constexpr GLenum GlConditionSatisfied = 0x911C;
+        constexpr GLenum GlWaitFailed = 0x911D;
+
+        struct GlFences {
+            GlSync (APIENTRY *FenceSync)(GLenum, GLbitfield) = nullptr;
+            GLenum (APIENTRY *ClientWaitSync)(GlSync, GLbitfield, u64) = nullptr;
+            void (APIENTRY *DeleteSync)(GlSync) = nullptr;
+
+            bool load()
+            {
+                FenceSync = reinterpret_cast<decltype(FenceSync)>(sf::Context::getFunction("glFenceSync"));
+                ClientWaitSync = reinterpret_cast<decltype(ClientWaitSync)>(sf::Context::getFunction("glClientWaitSync"));
+                DeleteSync = reinterpret_cast<decltype(DeleteSync)>(sf::Context::getFunction("glDeleteSync"));
+                return FenceSync && ClientWaitSync && DeleteSync;
+            }
+        };
+
+        /**
+         * @brief An upload submitted to the gpu and its fence.
+         */
+        struct InFlight {
+            std::shared_ptr<UploadTask> task;
+            GlSync fence;
+        };
+    }
+
+    UploadHandle::UploadHandle(const std::shared_ptr<UploadTask>& task)
+        : m_task(task)
+    {
+    }
+
+    UploadState UploadHandle::state() const
+    {
+        return m_task->state;
+    }
+
+    bool UploadHandle::isReady() const
+    {
+        return m_task && m_task->state == UploadState::Ready;
+    }
+
+    bool UploadHandle::wait() const
+    {
+        UploadState state = m_task->state;
+
+        while (state != UploadState::Ready && state != UploadState::Failed) {
+            m_task->state.wait(state);
+            state = m_task->state;
+        }
+        return state == UploadState::Ready;
+    }
+
+    const Texture& UploadHandle::texture() const
+    {
+        return m_task->texture;
+    }
+
+    TextureUploader::TextureUploader()
+        : m_thread(&TextureUploader::work, this)
+    {
+    }
+
+    TextureUploader::~TextureUploader()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        m_thread.join();
+    }
+
+    UploadHandle TextureUploader::submit(const std::shared_ptr<UploadTask>& task)
+    {
+        {
+            std::lock_guard lock(m_mutex);
+
+            m_queue.push_back(task);
+            ++m_pending;
+        }
+        m_wake.notify_one();
+        return UploadHandle(task);
+    }
+
+    UploadHandle TextureUploader::create(sf::Image image, bool smooth)
+    {
+        auto task = std::make_shared<UploadTask>();
+
+        task->upload = [image = std::move(image), smooth](Texture& texture) {
+            auto handle = makeSharedTexture();
+
+            if (handle->loadFromImage(image) == false)
+                return false;
+            handle->setSmooth(smooth);
+            texture = Texture(handle);
+            return true;
+        };
+        return submit(task);
+    }
+
+    UploadHandle TextureUploader::update(const Texture& texture, std::vector<u8> pixels, const Frame& area)
+    {
+        auto task = std::make_shared<UploadTask>();
+
+        task->texture = texture;
+        task->upload = [pixels = std::move(pixels), area](Texture& texture) mutable {
+            texture.update(pixels.data(), area);
+            return true;
+        };
+        return submit(task);
+    }
+
+    usize TextureUploader::pending() const
+    {
+        return m_pending;
+    }
+
+    void TextureUploader::work()
+    {
+        // Shared with every other context of sfml, textures created here are visible everywhere
+        sf::Context context;
+        GlFences gl;
+        const bool fences = gl.load();
+        std::vector<InFlight> in_flight;
+
+        const auto publish = [this](UploadTask& task, UploadState state) {
+            task.state = state;
+            task.state.notify_all();
+            --m_pending;
+        };
+
+        while (true) {
+            std::shared_ptr<UploadTask> task;
+            {
+                std::unique_lock lock(m_mutex);
+
+                // Fences are polled while uploads are in flight
+                if (in_flight.empty()) {
+                    m_wake.wait(lock, [this] { return m_stop || m_queue.empty() == false; });
+                } else {
+                    m_wake.wait_for(lock, std::chrono::milliseconds(1),
+                                    [this] { return m_stop || m_queue.empty() == false; });
+                }
+                if (m_stop && m_queue.empty() && in_flight.empty())
+                    break;
+                if (m_queue.empty() == false) {
+                    task = m_queue.front();
+                    m_queue.pop_front();
+                }
+            }
+
+            if (task) {
+                task->state = UploadState::Uploading;
+                if (task->upload(task->texture) == false) {
+                    publish(*task, UploadState::Failed);
+                } else if (fences) {
+                    in_flight.push_back({ task, gl.FenceSync(GlSyncGpuCommandsComplete, 0) });
+                    glFlush();
+                } else {
+                    glFinish();
+                    publish(*task, UploadState::Ready);
+                }
+            }
+
+            for (auto it = in_flight.begin(); it != in_flight.end();) {
+                const GLenum result = gl.ClientWaitSync(it->fence, 0, 0);
+
+                if (result == GlAlreadySignaled || result == GlConditionSatisfied || result == GlWaitFailed) {
+                    gl.DeleteSync(it->fence);
+                    publish(*it->task, result == GlWaitFailed ? UploadState::Failed : UploadState::Ready);
+                    it = in_flight.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,696 @@
+#include "Kat/vfs.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#if defined(KAT_IO_URING)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace kat {
+
+#if defined(KAT_IO_URING)
+
+    /**
+     * @brief An io_uring driven with raw syscalls: a submission ring of reads and
+     *        a completion ring of their results, both shared with the kernel.
+     *        Only used by the io_uring thread.
+     */
+    struct VfsRing {
+        int fd = -1;
+        void *rings = nullptr;
+        usize rings_size = 0;
+        void *completions = nullptr;       ///< The completion ring, when mapped apart.
+        usize completions_size = 0;
+        io_uring_sqe *sqes = nullptr;
+        usize sqes_size = 0;
+
+        unsigned *sq_head = nullptr;
+        unsigned *sq_tail = nullptr;
+        unsigned sq_mask = 0;
+        unsigned sq_entries = 0;
+        unsigned *sq_array = nullptr;
+        unsigned *cq_head = nullptr;
+        unsigned *cq_tail = nullptr;
+        unsigned cq_mask = 0;
+        io_uring_cqe *cqes = nullptr;
+
+        unsigned unsubmitted = 0;          ///< Reads queued since the last enter().
+
+        bool create(unsigned entries)
+        {
+            io_uring_params params;
+
+            std::memset(&params, 0, sizeof(params));
+            fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+            if (fd < 0)
+                return false;
+
+            const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+            const usize sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            const usize cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+            rings_size = single ? std::max(sq_size, cq_size) : sq_size;
+            rings = mmap(nullptr, rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_SQ_RING);
+            if (rings == MAP_FAILED) {
+                rings = nullptr;
+                return false;
+            }
+
+            void *cq = rings;
+
+            if (single == false) {
+                completions_size = cq_size;
+                completions = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                   fd, IORING_OFF_CQ_RING);
+                if (completions == MAP_FAILED) {
+                    completions = nullptr;
+                    return false;
+                }
+                cq = completions;
+            }
+
+            sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = static_cast<io_uring_sqe *>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                                                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+            if (sqes == MAP_FAILED) {
+                sqes = nullptr;
+                return false;
+            }
+
+            u8 *sq = static_cast<u8 *>(rings);
+            u8 *cqb = static_cast<u8 *>(cq);
+
+            sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+            sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+            sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+            sq_entries = params.sq_entries;
+            sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+            cq_head = reinterpret_cast<unsigned *>(cqb + params.cq_off.head);
+            cq_tail = reinterpret_cast<unsigned *>(cqb + params.cq_off.tail);
+            cq_mask = *reinterpret_cast<unsigned *>(cqb + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe *>(cqb + params.cq_off.cqes);
+            return true;
+        }
+
+        ~VfsRing()
+        {
+            if (sqes)
+                munmap(sqes, sqes_size);
+            if (completions)
+                munmap(completions, completions_size);
+            if (rings)
+                munmap(rings, rings_size);
+            if (fd >= 0)
+                ::close(fd);
+        }
+
+        /**
+         * @brief Queues a read, submitted by the next enter().
+         * @return bool Whether the submission ring had room.
+         */
+        bool read(int file, void *buffer, unsigned size, u64 offset, u64 user_data)
+        {
+            const unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+            const unsigned tail = *sq_tail;
+
+            if (tail - head >= sq_entries)
+                return false;
+
+            const unsigned index = tail & sq_mask;
+            io_uring_sqe& sqe = sqes[index];
+
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = file;
+            sqe.addr = (u64)(uintptr_t)buffer;
+            sqe.len = size;
+            sqe.off = offset;
+            sqe.user_data = user_data;
+            sq_array[index] = index;
+            // The kernel sees the entry once the tail moves past it
+            __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+            ++unsubmitted;
+            return true;
+        }
+
+        /**
+         * @brief Submits the queued reads and waits for a completion.
+         * @return bool Whether the call succeeded, it is retried otherwise.
+         */
+        bool enter(unsigned wait)
+        {
+            const int submitted = (int)syscall(__NR_io_uring_enter, fd, unsubmitted, wait,
+                                               wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+
+            if (submitted < 0)
+                return false;
+            unsubmitted -= std::min<unsigned>(unsubmitted, (unsigned)submitted);
+            return true;
+        }
+
+        /**
+         * @brief Calls a function with every completion.
+         */
+        template<typename Function>
+        void reap(const Function& function)
+        {
+            unsigned head = *cq_head;
+            const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+            while (head != tail) {
+                const io_uring_cqe& cqe = cqes[head & cq_mask];
+
+                function(cqe.user_data, cqe.res);
+                ++head;
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        }
+    };
+
+#else
+
+    struct VfsRing {
+        bool create(unsigned)
+        {
+            return false;
+        }
+    };
+
+#endif
+
+    VirtualFileSystem *VirtualFileSystem::m_Instance = nullptr;
+
+    VfsBuffer::VfsBuffer(std::shared_ptr<const void> owner, std::span<const u8> bytes)
+        : m_owner(std::move(owner)), m_bytes(bytes)
+    {
+    }
+
+    std::span<const u8> VfsBuffer::bytes() const
+    {
+        return m_bytes;
+    }
+
+    std::string_view VfsBuffer::view() const
+    {
+        return std::string_view(reinterpret_cast<const char *>(m_bytes.data()), m_bytes.size());
+    }
+
+    const u8 *VfsBuffer::data() const
+    {
+        return m_bytes.data();
+    }
+
+    usize VfsBuffer::size() const
+    {
+        return m_bytes.size();
+    }
+
+    bool VfsBuffer::empty() const
+    {
+        return m_bytes.empty();
+    }
+
+    Texture VfsBuffer::texture(const Frame& area) const
+    {
+        Texture texture;
+
+        // Decoded (or uploaded for raw images) straight from the buffer
+        texture.load(const_cast<u8 *>(m_bytes.data()), m_bytes.size(), area);
+        return texture;
+    }
+
+    VfsRead::VfsRead(const std::shared_ptr<VfsTask>& task)
+        : m_task(task)
+    {
+    }
+
+    VfsState VfsRead::state() const
+    {
+        return m_task->state;
+    }
+
+    bool VfsRead::isReady() const
+    {
+        return m_task && m_task->state == VfsState::Ready;
+    }
+
+    bool VfsRead::wait() const
+    {
+        VfsState state = m_task->state;
+
+        while (state == VfsState::Pending) {
+            m_task->state.wait(state);
+            state = m_task->state;
+        }
+        return state == VfsState::Ready;
+    }
+
+    const VfsBuffer& VfsRead::buffer() const
+    {
+        return m_task->buffer;
+    }
+
+    const std::string& VfsRead::path() const
+    {
+        return m_task->path;
+    }
+
+    const std::string& VfsRead::error() const
+    {
+        return m_task->error;
+    }
+
+    VirtualFileSystem::VirtualFileSystem(VfsBackend backend, usize threads)
+        : m_mounts(std::make_shared<const Mounts>())
+    {
+        if (backend != VfsBackend::ThreadPool) {
+            m_ring = std::make_unique<VfsRing>();
+            if (m_ring->create(RingSize)) {
+                m_backend = VfsBackend::IoUring;
+                m_reactor = std::thread(&VirtualFileSystem::react, this);
+            } else {
+                m_ring = nullptr;
+            }
+        }
+        for (usize i = 0; i < std::max<usize>(threads, 1); ++i)
+            m_workers.emplace_back(&VirtualFileSystem::work, this);
+    }
+
+    VirtualFileSystem::~VirtualFileSystem()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+
+            m_stop = true;
+        }
+        m_react.notify_all();
+        if (m_reactor.joinable())
+            m_reactor.join();
+
+        // The io_uring thread may have left decompressions to the workers
+        {
+            std::lock_guard lock(m_mutex);
+
+            m_stop_workers = true;
+        }
+        m_wake.notify_all();
+        for (auto& worker : m_workers)
+            worker.join();
+    }
+
+    VirtualFileSystem& VirtualFileSystem::mountDirectory(const std::string& point, const std::string& directory)
+    {
+        std::lock_guard lock(m_mounts_mutex);
+        auto mounts = std::make_shared<Mounts>(*m_mounts);
+
+        mounts->push_back({ point.empty() || point.back() == '/' ? point : point + '/', directory, nullptr });
+        m_mounts = std::move(mounts);
+        return *this;
+    }
+
+    bool VirtualFileSystem::mountPak(const std::string& point, const std::string& filename)
+    {
+        auto pak = std::make_shared<Pak>();
+
+        if (pak->open(filename) == false)
+            return false;
+
+        std::lock_guard lock(m_mounts_mutex);
+        auto mounts = std::make_shared<Mounts>(*m_mounts);
+
+        mounts->push_back({ point.empty() || point.back() == '/' ? point : point + '/', {}, std::move(pak) });
+        m_mounts = std::move(mounts);
+        return true;
+    }
+
+    VirtualFileSystem& VirtualFileSystem::unmount(const std::string& point)
+    {
+        const std::string normalized = point.empty() || point.back() == '/' ? point : point + '/';
+        std::lock_guard lock(m_mounts_mutex);
+        auto mounts = std::make_shared<Mounts>(*m_mounts);
+
+        std::erase_if(*mounts, [&normalized](const Mount& mount) { return mount.point == normalized; });
+        m_mounts = std::move(mounts);
+        return *this;
+    }
+
+    std::shared_ptr<const VirtualFileSystem::Mounts> VirtualFileSystem::mounts() const
+    {
+        std::lock_guard lock(m_mounts_mutex);
+
+        return m_mounts;
+    }
+
+    std::vector<VirtualFileSystem::Source> VirtualFileSystem::sources(const std::string& path, const Mounts& mounts)
+    {
+        std::vector<Source> found;
+
+        for (auto it = mounts.rbegin(); it != mounts.rend(); ++it) {
+            if (path.starts_with(it->point) == false)
+                continue;
+
+            const std::string_view relative = std::string_view(path).substr(it->point.size());
+
+            if (it->pak == nullptr) {
+                found.push_back({ (std::filesystem::path(it->directory) / relative).string(), nullptr, {} });
+            } else if (it->pak->contains(relative)) {
+                // Mounts under the pak are hidden by it
+                found.push_back({ {}, it->pak, relative });
+                break;
+            }
+        }
+        return found;
+    }
+
+    bool VirtualFileSystem::exists(const std::string& path) const
+    {
+        const auto snapshot = mounts();
+        std::error_code error;
+
+        for (const auto& source : sources(path, *snapshot)) {
+            if (source.pak || std::filesystem::is_regular_file(source.file, error))
+                return true;
+        }
+        return false;
+    }
+
+    VfsRead VirtualFileSystem::read(const std::string& path)
+    {
+        auto task = std::make_shared<VfsTask>();
+
+        task->path = path;
+        submit({ task });
+        return VfsRead(task);
+    }
+
+    std::vector<VfsRead> VirtualFileSystem::read(const std::vector<std::string>& paths)
+    {
+        std::vector<std::shared_ptr<VfsTask>> tasks;
+        std::vector<VfsRead> reads;
+
+        for (const auto& path : paths) {
+            auto task = std::make_shared<VfsTask>();
+
+            task->path = path;
+            tasks.push_back(task);
+            reads.emplace_back(task);
+        }
+        submit(tasks);
+        return reads;
+    }
+
+    VfsBuffer VirtualFileSystem::readNow(const std::string& path)
+    {
+        const VfsRead pending = read(path);
+
+        return pending.wait() ? pending.buffer() : VfsBuffer();
+    }
+
+    VfsBackend VirtualFileSystem::backend() const
+    {
+        return m_backend;
+    }
+
+    void VirtualFileSystem::submit(const std::vector<std::shared_ptr<VfsTask>>& tasks)
+    {
+        {
+            std::lock_guard lock(m_mutex);
+
+            for (const auto& task : tasks) {
+                if (m_backend == VfsBackend::IoUring)
+                    m_pending.push_back(task);
+                else
+                    m_queue.push_back([this, task]() { readBlocking(*task, *mounts()); });
+            }
+        }
+        // The whole batch is taken by a single wake up of the io_uring thread
+        if (m_backend == VfsBackend::IoUring)
+            m_react.notify_one();
+        else
+            m_wake.notify_all();
+    }
+
+    void VirtualFileSystem::complete(VfsTask& task, VfsBuffer buffer)
+    {
+        task.buffer = std::move(buffer);
+        task.state = VfsState::Ready;
+        task.state.notify_all();
+    }
+
+    void VirtualFileSystem::fail(VfsTask& task, const std::string& error)
+    {
+        task.error = error;
+        task.state = VfsState::Failed;
+        task.state.notify_all();
+    }
+
+    void VirtualFileSystem::readPak(VfsTask& task, const std::shared_ptr<Pak>& pak, std::string_view entry)
+    {
+        try {
+            auto scratch = std::make_shared<std::vector<u8>>();
+            const std::span<const u8> bytes = pak->data(entry, *scratch);
+
+            // Stored entries are views of the mapping, the buffer keeps the pak mapped
+            if (scratch->empty())
+                complete(task, VfsBuffer(pak, bytes));
+            else
+                complete(task, VfsBuffer(scratch, bytes));
+        } catch (const std::exception& error) {
+            fail(task, error.what());
+        }
+    }
+
+    void VirtualFileSystem::readBlocking(VfsTask& task, const Mounts& mounts)
+    {
+        for (const auto& source : sources(task.path, mounts)) {
+            if (source.pak) {
+                readPak(task, source.pak, source.entry);
+                return;
+            }
+
+            std::ifstream file(source.file, std::ios::binary | std::ios::ate);
+
+            if (!file)
+                continue;
+
+            const usize size = (usize)file.tellg();
+            std::shared_ptr<u8[]> data(new u8[std::max<usize>(size, 1)]);
+
+            file.seekg(0);
+            if (!file.read(reinterpret_cast<char *>(data.get()), (std::streamsize)size)) {
+                fail(task, "Failed to read file: " + source.file);
+                return;
+            }
+            complete(task, VfsBuffer(data, std::span<const u8>(data.get(), size)));
+            return;
+        }
+        fail(task, "File not found: " + task.path);
+    }
+
+    void VirtualFileSystem::work()
+    {
+        std::unique_lock lock(m_mutex);
+
+        while (true) {
+            m_wake.wait(lock, [this] { return m_stop_workers || m_queue.empty() == false; });
+            if (m_queue.empty())
+                return;
+
+            auto job = std::move(m_queue.front());
+
+            m_queue.pop_front();
+            lock.unlock();
+            job();
+            lock.lock();
+        }
+    }
+
+#if defined(KAT_IO_URING)
+
+    int VirtualFileSystem::open(const std::shared_ptr<VfsTask>& task, const Mounts& mounts)
+    {
+        for (const auto& source : sources(task->path, mounts)) {
+            if (source.pak) {
+                const PakIndexEntry *entry = source.pak->find(source.entry);
+
+                if (entry && entry->blocks) {
+                    std::lock_guard lock(m_mutex);
+
+                    m_queue.push_back([task, pak = source.pak, name = std::string(source.entry)]() {
+                        readPak(*task, pak, name);
+                    });
+                    m_wake.notify_one();
+                } else {
+                    readPak(*task, source.pak, source.entry);
+                }
+                return -1;
+            }
+
+            const int file = ::open(source.file.c_str(), O_RDONLY | O_CLOEXEC);
+
+            if (file >= 0)
+                return file;
+            if (errno != ENOENT && errno != ENOTDIR) {
+                fail(*task, "Failed to open file: " + source.file + ": " + std::strerror(errno));
+                return -1;
+            }
+        }
+        fail(*task, "File not found: " + task->path);
+        return -1;
+    }
+
+    void VirtualFileSystem::react()
+    {
+        struct InFlight {
+            std::shared_ptr<VfsTask> task;
+            int file = -1;
+            std::shared_ptr<u8[]> data;
+            usize size = 0;
+            usize done = 0;
+        };
+
+        // A single read covers at most 1 GiB, larger files take several
+        constexpr usize MaxRead = 1u << 30;
+        VfsRing& ring = *m_ring;
+        std::vector<InFlight> reads(RingSize);
+        std::vector<u32> free_slots;
+        std::deque<std::shared_ptr<VfsTask>> waiting;
+        usize in_flight = 0;
+        bool stop = false;
+
+        for (u32 i = 0; i < RingSize; ++i)
+            free_slots.push_back(RingSize - 1 - i);
+
+        const auto queue = [&](u32 slot) {
+            InFlight& read = reads[slot];
+            const usize size = std::min(read.size - read.done, MaxRead);
+
+            ring.read(read.file, read.data.get() + read.done, (unsigned)size, read.done, slot);
+        };
+        const auto release = [&](u32 slot) {
+            InFlight& read = reads[slot];
+
+            ::close(read.file);
+            read = InFlight();
+            free_slots.push_back(slot);
+            --in_flight;
+        };
+
+        while (stop == false || in_flight) {
+            {
+                std::unique_lock lock(m_mutex);
+
+                // While reads are in flight, new reads wait for the next completion
+                if (in_flight == 0 && waiting.empty())
+                    m_react.wait(lock, [this] { return m_stop || m_pending.empty() == false; });
+                stop = m_stop;
+                for (auto& task : m_pending)
+                    waiting.push_back(std::move(task));
+                m_pending.clear();
+            }
+            if (stop) {
+                for (auto& task : waiting)
+                    fail(*task, "File system destroyed.");
+                waiting.clear();
+            }
+
+            const auto snapshot = mounts();
+
+            // Every file that fits in the ring is opened, their reads go out with one syscall
+            while (waiting.empty() == false && free_slots.empty() == false) {
+                auto task = std::move(waiting.front());
+
+                waiting.pop_front();
+
+                const int file = open(task, *snapshot);
+                struct stat status;
+
+                if (file < 0)
+                    continue;
+                if (fstat(file, &status) != 0) {
+                    ::close(file);
+                    fail(*task, "Failed to read file: " + task->path);
+                    continue;
+                }
+                if (status.st_size == 0) {
+                    ::close(file);
+                    complete(*task, VfsBuffer());
+                    continue;
+                }
+
+                const u32 slot = free_slots.back();
+
+                free_slots.pop_back();
+                reads[slot] = { task, file, std::shared_ptr<u8[]>(new u8[status.st_size]), (usize)status.st_size, 0 };
+                ++in_flight;
+                queue(slot);
+            }
+            if (in_flight == 0)
+                continue;
+
+            // Interrupted or out of resources, the kernel may still write into the buffers
+            // in flight so they are kept until their completion
+            if (ring.enter(1) == false) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            ring.reap([&](u64 slot, i32 result) {
+                InFlight& read = reads[slot];
+
+                if (result == -EINTR || result == -EAGAIN) {
+                    queue((u32)slot);
+                } else if (result < 0) {
+                    fail(*read.task, "Failed to read file: " + read.task->path + ": " + std::strerror(-result));
+                    release((u32)slot);
+                } else if (result == 0) {
+                    fail(*read.task, "File truncated while read: " + read.task->path);
+                    release((u32)slot);
+                } else if ((read.done += (usize)result) < read.size) {
+                    queue((u32)slot);
+                } else {
+                    complete(*read.task, VfsBuffer(read.data, std::span<const u8>(read.data.get(), read.size)));
+                    release((u32)slot);
+                }
+            });
+        }
+    }
+
+#else
+
+    int VirtualFileSystem::open(const std::shared_ptr<VfsTask>&, const Mounts&)
+    {
+        return -1;
+    }
+
+    void VirtualFileSystem::react()
+    {
+    }
+
+#endif
+
+    VirtualFileSystem& VirtualFileSystem::instance()
+    {
+        if (!m_Instance)
+            m_Instance = new VirtualFileSystem();
+        return *m_Instance;
+    }
+
+    void VirtualFileSystem::destroy()
+    {
+        if (m_Instance)
+            delete m_Instance;
+        m_Instance = nullptr;
+    }
+}
@@ -1,4 +1,6 @@
 #include "Kat/window.h"
+#include "Kat/components/texture_release.h"
+
 #include <SFML/System/String.hpp>
 
 namespace kat {
@@ -25,6 +27,12 @@ namespace kat {
         create(handle, settings);
     }
 
+    Window::~Window()
+    {
+        if (m_window.setActive(true))
+            TextureReleaseQueue::instance().flush();
+    }
+
     Window& Window::close()
     {
         m_window.close();
@@ -43,10 +51,58 @@ namespace kat {
 
     Window& Window::setFps(const FpsLimit& limit)
     {
-        m_window.setFramerateLimit(limit);
+        // sfml keeps limiting the framerate until the latched loop is in use
+        m_window.setFramerateLimit(m_latching ? 0 : limit);
+        m_scheduler.setFps(limit);
+        return *this;
+    }
+
+    Window& Window::latch()
+    {
+        if (m_latching == false) {
+            m_latching = true;
+            m_window.setFramerateLimit(0);
+        }
+        m_scheduler.latch();
+        return *this;
+    }
+
+    Window& Window::clear(const sf::Color& color)
+    {
+        m_window.clear(color);
+        return *this;
+    }
+
+    Window& Window::display()
+    {
+        m_window.display();
+        endFrame();
+        if (m_latching)
+            m_scheduler.present();
+        return *this;
+    }
+
+    Window& Window::endFrame()
+    {
+        // Textures released during the frame are destroyed while the context is current
+        TextureReleaseQueue::instance().flush();
         return *this;
     }
 
+    FrameScheduler& Window::scheduler()
+    {
+        return m_scheduler;
+    }
+
+    StreamRenderer* Window::stream()
+    {
+        if (!m_stream) {
+            m_stream = std::make_unique<StreamRenderer>();
+            m_stream->create(m_window);
+        }
+        return m_stream->isAvailable() ? m_stream.get() : nullptr;
+    }
+
     bool Window::hasFocus() const
     {
         return m_window.hasFocus();
@@ -0,0 +1,204 @@
+#include "Kat/image_format.h"
+#include "Kat/pak.h"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Bakes a directory into a pak:
+//   kat_pak [-c] [-f raw|qoi|bands|source] [-a <page size>] <directory> <output.pak>
+//
+// Images are baked in the given format (raw by default): raw rgba uploaded as is,
+// qoi, bands of qoi rows decoded across threads, or the source file decoded by sfml.
+// With -a, images that fit are packed into square atlas pages of the given size, baked
+// as images (raw with -f source) next to an atlas table, see kat::Pak::texture().
+// Lua scripts are compiled to bytecode,
+// .anim files are turned into animation tables, other files are stored as is.
+// An .anim file lists one animation per line:
+//   <name> <speed> <loop> <left> <top> <width> <height> [<left> <top> <width> <height>...]
+
+namespace fs = std::filesystem;
+
+static std::vector<kat::u8> readFile(const fs::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    return std::vector<kat::u8>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static bool isImage(const std::string& extension)
+{
+    return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".bmp"
+        || extension == ".tga" || extension == ".gif" || extension == ".psd" || extension == ".hdr"
+        || extension == ".pic";
+}
+
+static bool parseImageFormat(const std::string& name, kat::ImageFormat& format)
+{
+    if (name == "raw")
+        format = kat::ImageFormat::Raw;
+    else if (name == "qoi")
+        format = kat::ImageFormat::Qoi;
+    else if (name == "bands")
+        format = kat::ImageFormat::QoiBands;
+    else if (name == "source")
+        format = kat::ImageFormat::Encoded;
+    else
+        return false;
+    return true;
+}
+
+static int writeChunk(lua_State *, const void *data, size_t size, void *output)
+{
+    auto *bytes = static_cast<const kat::u8 *>(data);
+    auto *chunk = static_cast<std::vector<kat::u8> *>(output);
+
+    chunk->insert(chunk->end(), bytes, bytes + size);
+    return 0;
+}
+
+static std::vector<kat::u8> compileScript(const std::vector<kat::u8>& source, const std::string& name)
+{
+    lua_State *state = luaL_newstate();
+    std::vector<kat::u8> chunk;
+
+    if (luaL_loadbufferx(state, reinterpret_cast<const char *>(source.data()), source.size(),
+                         ("@" + name).c_str(), "t") != LUA_OK) {
+        const std::string error = lua_tostring(state, -1);
+
+        lua_close(state);
+        throw std::runtime_error(error);
+    }
+    lua_dump(state, writeChunk, &chunk, 0);
+    lua_close(state);
+    return chunk;
+}
+
+static kat::AnimationRegistry parseAnimations(const fs::path& path)
+{
+    std::ifstream file(path);
+    kat::AnimationRegistry animations;
+    std::string line;
+
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        kat::AnimationName name;
+        kat::Animation animation;
+        int loop;
+        kat::i32 left, top, width, height;
+
+        if (!(stream >> name) || name[0] == '#')
+            continue;
+        if (!(stream >> animation.speed >> loop))
+            throw std::runtime_error("Invalid animation: " + name);
+        animation.loop = loop != 0;
+        while (stream >> left >> top >> width >> height)
+            animation.addFrame(kat::Frame(left, top, width, height));
+        animations[name] = std::move(animation);
+    }
+    return animations;
+}
+
+static bool parsePageSize(const std::string& value, kat::u32& size)
+{
+    try {
+        const unsigned long parsed = std::stoul(value);
+
+        if (parsed == 0 || parsed > 16384)
+            return false;
+        size = (kat::u32)parsed;
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool compress = false;
+    kat::ImageFormat format = kat::ImageFormat::Raw;
+    kat::u32 page_size = 0;
+    int arg = 1;
+
+    for (; arg < argc; ++arg) {
+        const std::string option = argv[arg];
+
+        if (option == "-c")
+            compress = true;
+        else if (option == "-f" && arg + 1 < argc && parseImageFormat(argv[arg + 1], format))
+            ++arg;
+        else if (option == "-a" && arg + 1 < argc && parsePageSize(argv[arg + 1], page_size))
+            ++arg;
+        else
+            break;
+    }
+    if (argc - arg != 2) {
+        std::cerr << "usage: " << argv[0] << " [-c] [-f raw|qoi|bands|source] [-a <page size>] <directory> <output.pak>" << std::endl;
+        return 1;
+    }
+
+    const fs::path root(argv[arg]);
+    kat::PakWriter writer;
+    kat::ImageAtlas atlas(kat::TextureSize(page_size, page_size));
+    kat::AtlasTable table;
+
+    try {
+        for (const auto& file : fs::recursive_directory_iterator(root)) {
+            if (file.is_regular_file() == false)
+                continue;
+
+            const std::string name = fs::relative(file.path(), root).generic_string();
+            const std::string extension = file.path().extension().string();
+
+            if (isImage(extension)) {
+                sf::Image image;
+
+                if (image.loadFromFile(file.path().string()) == false)
+                    throw std::runtime_error("Failed to load image: " + name);
+                if (page_size) {
+                    if (const auto region = atlas.add(image)) {
+                        table.regions[name] = *region;
+                        continue;
+                    }
+                }
+                if (format == kat::ImageFormat::Encoded)
+                    writer.add(name, kat::PakEntryType::Image, readFile(file.path()));
+                else
+                    writer.add(name, kat::PakEntryType::Image, kat::encodeImage(image, format));
+            } else if (extension == ".lua") {
+                writer.add(name, kat::PakEntryType::Script, compileScript(readFile(file.path()), name));
+            } else if (extension == ".anim") {
+                writer.add(name, kat::PakEntryType::Animations,
+                           kat::encodeAnimations(parseAnimations(file.path())));
+            } else {
+                writer.add(name, kat::PakEntryType::Raw, readFile(file.path()));
+            }
+        }
+        // Sources of pages do not exist, they are baked raw
+        for (kat::usize i = 0; i < atlas.pages(); ++i) {
+            const std::string name = ".atlas/page" + std::to_string(i);
+
+            writer.add(name, kat::PakEntryType::Image,
+                       kat::encodeImage(atlas.page(i), format == kat::ImageFormat::Encoded ? kat::ImageFormat::Raw
+                                                                                            : format));
+            table.pages.push_back(name);
+        }
+        if (table.pages.empty() == false)
+            writer.add(".atlas/regions", kat::PakEntryType::Atlas, kat::encodeAtlas(table));
+    } catch (const std::exception& error) {
+        std::cerr << argv[0] << ": " << error.what() << std::endl;
+        return 1;
+    }
+    if (writer.save(argv[arg + 1], compress) == false) {
+        std::cerr << argv[0] << ": failed to write " << argv[arg + 1] << std::endl;
+        return 1;
+    }
+    std::cout << "Baked " << writer.size() << " files into " << argv[arg + 1] << std::endl;
+    return 0;
+}